@@ -27,6 +27,7 @@
 #include <assert.h>
 #include <string.h>
 #include <ctype.h>
+#include <time.h>
 #include "error.h"
 #include "mprintf.h"
 #include "strlist.h"
@@ -728,8 +729,21 @@ static inline retvalue goturidone(struct aptmethod *method, const char *chunk) {
 		free(uri);
 		return r;
 	}
-	if (verbose >= 1)
-		fprintf(stderr, "aptmethod got '%s'\n", uri);
+	if (verbose >= 1) {
+		char *resumepoint = NULL;
+
+		r = chunk_gettruth(chunk, "IMS-Hit");
+		if (RET_IS_OK(r))
+			fprintf(stderr, "aptmethod got '%s' (unchanged)\n",
+					uri);
+		else if (RET_IS_OK(chunk_getvalue(chunk, "Resume-Point",
+						&resumepoint)))
+			fprintf(stderr,
+"aptmethod got '%s' (continued at byte %s)\n", uri, resumepoint);
+		else
+			fprintf(stderr, "aptmethod got '%s'\n", uri);
+		free(resumepoint);
+	}
 
 	result = RET_NOTHING;
 	for (type = cs_md5sum ; type < cs_COUNT ; type++) {
@@ -999,6 +1013,9 @@ static retvalue senddata(struct aptmethod *method) {
 
 	if (method->command == NULL) {
 		const struct tobedone *todo;
+		struct stat s;
+		struct tm tm;
+		char lastmodified[64];
 
 		/* nothing queued to send, nothing to be queued...*/
 		todo = method->nexttosend;
@@ -1012,15 +1029,26 @@ static retvalue senddata(struct aptmethod *method) {
 		// TODO: make sure this is already checked for earlier...
 		assert (strchr(todo->uri, '\n') == NULL &&
 		        strchr(todo->filename, '\n') == NULL);
-		/* http-aptmethod seems to loose the last byte,
-		 * if the file is already in place,
-		 * so we better unlink the target first...
-		 * but this is done elsewhere already
-		unlink(todo->filename);
-		*/
-		method->command = mprintf(
-			 "600 URI Acquire\nURI: %s\nFilename: %s\n\n",
-			 todo->uri, todo->filename);
+		/* If the target is already there (from an earlier run
+		 * or an interrupted download), tell the method when we
+		 * got it, so it can either skip the download if it did
+		 * not change (IMS-Hit) or continue a partial file.
+		 * (The apt methods set the file's mtime to the
+		 * server's Last-Modified, so this is the best
+		 * information to have about it) */
+		if (stat(todo->filename, &s) == 0 && S_ISREG(s.st_mode)
+				&& s.st_size > 0
+				&& gmtime_r(&s.st_mtime, &tm) != NULL
+				&& strftime(lastmodified, sizeof(lastmodified),
+					"%a, %d %b %Y %H:%M:%S GMT", &tm) > 0)
+			method->command = mprintf(
+"600 URI Acquire\nURI: %s\nFilename: %s\nLast-Modified: %s\n\n",
+				todo->uri, todo->filename,
+				lastmodified);
+		else
+			method->command = mprintf(
+"600 URI Acquire\nURI: %s\nFilename: %s\n\n",
+				todo->uri, todo->filename);
 		if (FAILEDTOALLOC(method->command)) {
 			return RET_ERROR_OOM;
 		}
@@ -53,6 +53,9 @@ struct ar_archive {
 	void *readbuffer;
 	/*@null@*/struct compressedfile *member;
 	enum compression compression;
+	/* if set, everything is read instead of seeking over it: */
+	/*@null@*/uncompress_observer *observer;
+	void *observerdata;
 };
 
 static ssize_t readwait(int fd, /*@out@*/void *buf, size_t count) {
@@ -83,7 +86,47 @@ static ssize_t readwait(int fd, /*@out@*/void *buf, size_t count) {
 	return totalread;
 }
 
+/* read until the given position, telling the observer about it */
+static retvalue ar_readuntil(struct ar_archive *ar, off_t position) {
+	char buffer[BLOCKSIZE];
+	off_t current;
+	ssize_t bytesread;
+
+	current = lseek(ar->fd, 0, SEEK_CUR);
+	if (current == (off_t)-1) {
+		int e = errno;
+		fprintf(stderr,
+"Error %d getting position in ar file %s: %s\n",
+				e, ar->filename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	while (current < position) {
+		size_t toread = BLOCKSIZE;
+
+		if (position - current < (off_t)toread)
+			toread = position - current;
+		bytesread = readwait(ar->fd, buffer, toread);
+		if (bytesread < 0) {
+			int e = errno;
+			fprintf(stderr,
+"Error %d reading from ar file %s: %s\n",
+				e, ar->filename, strerror(e));
+			return RET_ERRNO(e);
+		}
+		if (bytesread == 0)
+			/* let the reading of the next header complain */
+			break;
+		ar->observer(ar->observerdata, buffer, bytesread);
+		current += bytesread;
+	}
+	return RET_OK;
+}
+
 retvalue ar_open(/*@out@*/struct ar_archive **n, const char *filename) {
+	return ar_openobserved(n, filename, NULL, NULL);
+}
+
+retvalue ar_openobserved(/*@out@*/struct ar_archive **n, const char *filename, uncompress_observer *observer, void *observerdata) {
 	struct ar_archive *ar;
 	char buffer[sizeof(AR_MAGIC)];
 	ssize_t bytesread;
@@ -125,6 +168,10 @@ retvalue ar_open(/*@out@*/struct ar_archive **n, const char *filename) {
 				filename);
 		return RET_ERROR;
 	}
+	ar->observer = observer;
+	ar->observerdata = observerdata;
+	if (observer != NULL)
+		observer(observerdata, buffer, bytesread);
 	ar->filename = strdup(filename);
 	if (FAILEDTOALLOC(ar->filename)) {
 		close(ar->fd);
@@ -156,7 +203,15 @@ retvalue ar_nextmember(struct ar_archive *ar, /*@out@*/char **filename) {
 	assert(ar->fd >= 0);
 
 	/* seek over what is left from the last part: */
-	s = lseek(ar->fd, ar->next_position, SEEK_SET);
+	if (ar->observer != NULL) {
+		retvalue r;
+
+		r = ar_readuntil(ar, ar->next_position);
+		if (RET_WAS_ERROR(r))
+			return r;
+		s = 0;
+	} else
+		s = lseek(ar->fd, ar->next_position, SEEK_SET);
 	if (s == (off_t)-1) {
 		int e = errno;
 		fprintf(stderr,
@@ -172,6 +227,8 @@ retvalue ar_nextmember(struct ar_archive *ar, /*@out@*/char **filename) {
 	bytesread = readwait(ar->fd, &ar->currentheader,
 			sizeof(ar->currentheader));
 	ar->next_position += sizeof(ar->currentheader);
+	if (bytesread > 0 && ar->observer != NULL)
+		ar->observer(ar->observerdata, &ar->currentheader, bytesread);
 	if (bytesread == 0)
 		return RET_NOTHING;
 	if (bytesread != sizeof(ar->currentheader)){
@@ -256,6 +313,14 @@ ssize_t ar_archivemember_read(struct archive *a, void *d, const void **p) {
 	return bytesread;
 }
 
+int64_t ar_archivemember_skip(UNUSED(struct archive *a), void *d, int64_t request) {
+	struct ar_archive *ar = d;
+
+	if (ar->member == NULL || request <= 0)
+		return 0;
+	return uncompress_skip(ar->member, request);
+}
+
 int ar_archivemember_open(struct archive *a, void *d) {
 	struct ar_archive *ar = d;
 	retvalue r;
@@ -271,7 +336,8 @@ int ar_archivemember_open(struct archive *a, void *d) {
 		return ARCHIVE_FATAL;
 	}
 	r = uncompress_fdopen(&ar->member, ar->fd, ar->member_size,
-			ar->compression, &e, &msg);
+			ar->compression, ar->observer, ar->observerdata,
+			&e, &msg);
 	if (RET_IS_OK(r))
 		return ARCHIVE_OK;
 	archive_set_error(a, e, "%s", msg);
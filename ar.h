@@ -4,6 +4,10 @@
 struct ar_archive;
 
 retvalue ar_open(/*@out@*/struct ar_archive **, const char *);
+/* the same, but read the whole file (instead of seeking over unused parts)
+ * and give everything read to the observer. (Only when ar_nextmember
+ * returned RET_NOTHING everything was read). */
+retvalue ar_openobserved(/*@out@*/struct ar_archive **, const char *, uncompress_observer *, void *);
 void ar_close(/*@only@*/struct ar_archive *);
 
 /* RET_OK = next is there, RET_NOTHING = eof, < 0 = error */
@@ -18,5 +22,8 @@ void ar_archivemember_setcompression(struct ar_archive *, enum compression);
 int ar_archivemember_close(struct archive *, void *);
 int ar_archivemember_open(struct archive *, void *);
 ssize_t ar_archivemember_read(struct archive *, void *, const void **);
+/* only seeks over uncompressed data (and if not observed),
+ * returns 0 otherwise, so libarchive reads the data instead */
+int64_t ar_archivemember_skip(struct archive *, void *, int64_t);
 
 #endif
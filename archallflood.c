@@ -23,6 +23,7 @@
 
 #include "error.h"
 #include "strlist.h"
+#include "chunks.h"
 #include "indexfile.h"
 #include "dpkgversions.h"
 #include "target.h"
@@ -606,19 +607,25 @@ static retvalue floodlist_install(struct floodlist *list, struct logger *logger,
 						pkg->new_source->name->name,
 						pkg->new_source->version);
 				} else {
+					struct chunkvalue sv, vv;
 					char *source, *sourceversion;
 
 					r = list->target->getsourceandversion(
 							pkg->new_control,
 							pkg->name,
-							&source,
-							&sourceversion);
+							&sv, &vv);
 					assert (r != RET_NOTHING);
 					if (RET_WAS_ERROR(r)) {
 						RET_UPDATE(result, r);
 						break;
 					}
-					r = trackingdata_switch(td,
+					source = strndup(sv.value, sv.len);
+					sourceversion = strndup(vv.value, vv.len);
+					if (FAILEDTOALLOC(source) ||
+					    FAILEDTOALLOC(sourceversion))
+						r = RET_ERROR_OOM;
+					else
+						r = trackingdata_switch(td,
 							source, sourceversion);
 					free(source);
 					free(sourceversion);
@@ -35,34 +35,119 @@ static const char * const types[4] = {
 };
 const char **atomtypes = (const char **)types;
 
-/* trivial implementation for now, perhaps make it more complicated later */
-static struct strlist architectures, components;
+/* the names are kept in a strlist (atom is the index), and an open
+ * addressing hash table (at most half full) of the indices to find
+ * them, as that is done for every package read */
+struct atomtable {
+	struct strlist names;
+	unsigned int mask;
+	/* atom_unknown means empty */
+	atom_t *slots;
+};
+static struct atomtable architectures, components;
+
+static inline unsigned int atomhash(const char *value, size_t len) {
+	unsigned int h = 2166136261U;
+
+	while (len-- > 0) {
+		h ^= (unsigned char)*(value++);
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static inline atom_t atomtable_find(const struct atomtable *table, const char *value, size_t len) {
+	unsigned int i;
+	atom_t a;
+
+	if (table->slots == NULL)
+		return atom_unknown;
+	for (i = atomhash(value, len) & table->mask ;
+	     (a = table->slots[i]) != atom_unknown ;
+	     i = (i + 1) & table->mask) {
+		const char *name = table->names.values[a];
+
+		if (strlen(name) == len && memcmp(name, value, len) == 0)
+			return a;
+	}
+	return atom_unknown;
+}
+
+static void atomtable_insert(struct atomtable *table, atom_t a) {
+	const char *name = table->names.values[a];
+	unsigned int i;
+
+	for (i = atomhash(name, strlen(name)) & table->mask ;
+	     table->slots[i] != atom_unknown ;
+	     i = (i + 1) & table->mask)
+		;
+	table->slots[i] = a;
+}
+
+/* add a new name (not yet in there), the 0th entry is never hashed */
+static retvalue atomtable_add(struct atomtable *table, const char *value, /*@out@*/atom_t *atom_p) {
+	atom_t a = table->names.count;
+	retvalue r;
+
+	r = strlist_add_dup(&table->names, value);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (a == atom_unknown) {
+		*atom_p = a;
+		return RET_OK;
+	}
+	if (table->slots == NULL ||
+			(unsigned int)table->names.count * 2 > table->mask + 1) {
+		unsigned int size = 16;
+		atom_t *n;
+
+		while (size < (unsigned int)table->names.count * 4)
+			size *= 2;
+		n = nzNEW(size, atom_t);
+		if (FAILEDTOALLOC(n))
+			return RET_ERROR_OOM;
+		free(table->slots);
+		table->slots = n;
+		table->mask = size - 1;
+		for (a = 1 ; a < table->names.count ; a++)
+			atomtable_insert(table, a);
+		a = table->names.count - 1;
+	} else
+		atomtable_insert(table, a);
+	*atom_p = a;
+	return RET_OK;
+}
 
 retvalue atoms_init(int count) {
 	retvalue r;
-	strlist_init(&architectures);
-	strlist_init(&components);
+	atom_t dummy;
+
+	strlist_init(&architectures.names);
+	strlist_init(&components.names);
 
 	/* add a 0th entry to all, so 0 means uninitialized */
 
-	r = strlist_add_dup(&architectures, "!!NONE!!");
+	r = atomtable_add(&architectures, "!!NONE!!", &dummy);
 	if (RET_WAS_ERROR(r))
 		return r;
-	r = strlist_add_dup(&architectures, "source");
+	r = atomtable_add(&architectures, "source", &dummy);
 	if (RET_WAS_ERROR(r))
 		return r;
-	r = strlist_add_dup(&architectures, "all");
+	assert (dummy == architecture_source);
+	r = atomtable_add(&architectures, "all", &dummy);
 	if (RET_WAS_ERROR(r))
 		return r;
-	r = strlist_add_dup(&components, "!!NONE!!");
+	assert (dummy == architecture_all);
+	r = atomtable_add(&components, "!!NONE!!", &dummy);
 	if (RET_WAS_ERROR(r))
 		return r;
 	/* a fallback component to put things without a component in */
-	r = strlist_add_dup(&components, "strange");
+	r = atomtable_add(&components, "strange", &dummy);
 	if (RET_WAS_ERROR(r))
 		return r;
-	atoms_components = (const char**)components.values;
-	atoms_architectures = (const char**)architectures.values;
+	assert (dummy == component_strange);
+	atoms_components = (const char**)components.names.values;
+	atoms_architectures = (const char**)architectures.names.values;
 	command_count = count;
 	if (command_count > 0) {
 		atoms_commands = nzNEW(command_count + 1, const char*);
@@ -74,82 +159,45 @@ retvalue atoms_init(int count) {
 
 retvalue architecture_intern(const char *value, architecture_t *atom_p) {
 	retvalue r;
-	int i;
+	architecture_t a;
 
-	i = strlist_ofs(&architectures, value);
-	if (i >= 0) {
-		*atom_p = (architecture_t)i;
+	a = atomtable_find(&architectures, value, strlen(value));
+	if (atom_defined(a)) {
+		*atom_p = a;
 		return RET_OK;
 	}
-	i = architectures.count;
-	r = strlist_add_dup(&architectures, value);
-	atoms_architectures = (const char**)architectures.values;
-	if (RET_IS_OK(r)) {
-		*atom_p = (architecture_t)i;
-		return RET_OK;
-	} else
-		return r;
+	r = atomtable_add(&architectures, value, atom_p);
+	atoms_architectures = (const char**)architectures.names.values;
+	return r;
 }
 retvalue component_intern(const char *value, component_t *atom_p) {
 	retvalue r;
-	int i;
+	component_t a;
 
-	i = strlist_ofs(&components, value);
-	if (i >= 0) {
-		*atom_p = (component_t)i;
+	a = atomtable_find(&components, value, strlen(value));
+	if (atom_defined(a)) {
+		*atom_p = a;
 		return RET_OK;
 	}
-	i = components.count;
-	r = strlist_add_dup(&components, value);
-	atoms_components = (const char**)components.values;
-	if (RET_IS_OK(r)) {
-		*atom_p = (component_t)i;
-		return RET_OK;
-	} else
-		return r;
+	r = atomtable_add(&components, value, atom_p);
+	atoms_components = (const char**)components.names.values;
+	return r;
 }
 
 architecture_t architecture_find(const char *value) {
-	int i = strlist_ofs(&architectures, value);
-	if (i < 0)
-		return atom_unknown;
-	else
-		return (architecture_t)i;
+	return atomtable_find(&architectures, value, strlen(value));
 }
 
 architecture_t architecture_find_l(const char *value, size_t l) {
-	architecture_t a;
-
-	for (a = architectures.count - 1 ; a > 0 ; a--) {
-		const char *name = atoms_architectures[a];
-		size_t len = strlen(name);
-
-		if (len == l && memcmp(name, value, len) == 0)
-			return a;
-	}
-	return atom_unknown;
+	return atomtable_find(&architectures, value, l);
 }
 
-// TODO: this might be called a lot, perhaps optimize it...
 component_t component_find_l(const char *value, size_t l) {
-	component_t a;
-
-	for (a = components.count - 1 ; a > 0 ; a--) {
-		const char *name = atoms_components[a];
-		size_t len = strlen(name);
-
-		if (len == l && memcmp(name, value, len) == 0)
-			return a;
-	}
-	return atom_unknown;
+	return atomtable_find(&components, value, l);
 }
 
 component_t component_find(const char *value) {
-	int i = strlist_ofs(&components, value);
-	if (i < 0)
-		return atom_unknown;
-	else
-		return (architecture_t)i;
+	return atomtable_find(&components, value, strlen(value));
 }
 
 packagetype_t packagetype_find(const char *value) {
@@ -364,7 +412,7 @@ retvalue atomlist_fprint(FILE *file, enum atom_type type, const struct atomlist
 }
 
 component_t components_count(void) {
-	return components.count;
+	return components.names.count;
 }
 
 retvalue atomlist_filllist(enum atom_type type, struct atomlist *list, char *string, const char **missing) {
@@ -396,3 +444,122 @@ retvalue atomlist_filllist(enum atom_type type, struct atomlist *list, char *str
 	atomlist_move(list, &l);
 	return RET_OK;
 }
+
+void atomset_init(struct atomset *set) {
+	set->words = ATOMSET_INLINEWORDS;
+	set->bits = NULL;
+	memset(set->inlinebits, 0, sizeof(set->inlinebits));
+}
+
+void atomset_done(struct atomset *set) {
+	free(set->bits);
+	set->bits = NULL;
+	set->words = 0;
+}
+
+static retvalue atomset_grow(struct atomset *set, unsigned int words) {
+	unsigned long *n;
+
+	if (words <= set->words)
+		return RET_OK;
+	n = nzNEW(words, unsigned long);
+	if (FAILEDTOALLOC(n))
+		return RET_ERROR_OOM;
+	memcpy(n, atomset_bits(set), set->words * sizeof(unsigned long));
+	free(set->bits);
+	set->bits = n;
+	set->words = words;
+	return RET_OK;
+}
+
+retvalue atomset_add(struct atomset *set, atom_t atom) {
+	unsigned int w = (unsigned int)atom / ATOMSET_WORDBITS;
+	unsigned long *bits;
+	retvalue r;
+
+	assert (atom_defined(atom));
+
+	r = atomset_grow(set, w + 1);
+	if (RET_WAS_ERROR(r))
+		return r;
+	bits = (set->bits != NULL) ? set->bits : set->inlinebits;
+	bits[w] |= 1UL << ((unsigned int)atom % ATOMSET_WORDBITS);
+	return RET_OK;
+}
+
+retvalue atomset_fromlist(struct atomset *set, const struct atomlist *list) {
+	retvalue r;
+	int i;
+
+	atomset_init(set);
+	for (i = 0 ; i < list->count ; i++) {
+		r = atomset_add(set, list->atoms[i]);
+		if (RET_WAS_ERROR(r)) {
+			atomset_done(set);
+			return r;
+		}
+	}
+	return RET_OK;
+}
+
+retvalue atomset_union(struct atomset *dest, const struct atomset *set) {
+	const unsigned long *from = atomset_bits(set);
+	unsigned long *to;
+	unsigned int w;
+	retvalue r;
+
+	r = atomset_grow(dest, set->words);
+	if (RET_WAS_ERROR(r))
+		return r;
+	to = (dest->bits != NULL) ? dest->bits : dest->inlinebits;
+	for (w = 0 ; w < set->words ; w++)
+		to[w] |= from[w];
+	return RET_OK;
+}
+
+void atomset_intersect(struct atomset *dest, const struct atomset *set) {
+	const unsigned long *from = atomset_bits(set);
+	unsigned long *to = (dest->bits != NULL) ? dest->bits : dest->inlinebits;
+	unsigned int w;
+
+	for (w = 0 ; w < dest->words ; w++)
+		to[w] &= (w < set->words) ? from[w] : 0;
+}
+
+bool atomset_subset(const struct atomset *set, const struct atomset *subset, atom_t *missing) {
+	const unsigned long *have = atomset_bits(set);
+	const unsigned long *need = atomset_bits(subset);
+	unsigned int w;
+
+	for (w = 0 ; w < subset->words ; w++) {
+		unsigned long m = need[w];
+		unsigned int b;
+
+		if (w < set->words)
+			m &= ~have[w];
+		if (m == 0)
+			continue;
+		if (missing != NULL) {
+			for (b = 0 ; (m & (1UL << b)) == 0 ; b++)
+				;
+			*missing = (atom_t)(w * ATOMSET_WORDBITS + b);
+		}
+		return false;
+	}
+	return true;
+}
+
+bool atomset_hasexcept(const struct atomset *set, atom_t atom) {
+	const unsigned long *bits = atomset_bits(set);
+	unsigned int w;
+
+	for (w = 0 ; w < set->words ; w++) {
+		unsigned long m = bits[w];
+
+		if (w == (unsigned int)atom / ATOMSET_WORDBITS)
+			m &= ~(1UL << ((unsigned int)atom % ATOMSET_WORDBITS));
+		if (m != 0)
+			return true;
+	}
+	return false;
+}
@@ -72,4 +72,39 @@ bool atomlist_subset(const struct atomlist *, const struct atomlist * /*subset*/
 retvalue atomlist_fprint(FILE *, enum atom_type, const struct atomlist *);
 
 retvalue atomlist_filllist(enum atom_type, /*@out@*/struct atomlist *, char * /*string*/, /*@out@*/const char ** /*missing*/);
+
+/* The same as bitset (without order or duplicates), for where many
+ * checks would otherwise need nested loops over atomlists.
+ * As atoms are small numbers, the inline bits are usually enough. */
+#define ATOMSET_WORDBITS (8 * sizeof(unsigned long))
+#define ATOMSET_INLINEWORDS 4
+struct atomset {
+	unsigned int words;
+	/* NULL while inlinebits are used */
+	/*@null@*/unsigned long *bits;
+	unsigned long inlinebits[ATOMSET_INLINEWORDS];
+};
+
+static inline const unsigned long *atomset_bits(const struct atomset *set) {
+	return (set->bits != NULL) ? set->bits : set->inlinebits;
+}
+static inline bool atomset_in(const struct atomset *set, atom_t atom) {
+	unsigned int w = (unsigned int)atom / ATOMSET_WORDBITS;
+
+	if (w >= set->words)
+		return false;
+	return (atomset_bits(set)[w] >> ((unsigned int)atom % ATOMSET_WORDBITS)) & 1;
+}
+
+void atomset_init(/*@out@*/struct atomset *);
+void atomset_done(/*@special@*/struct atomset *);
+retvalue atomset_add(struct atomset *, atom_t);
+retvalue atomset_fromlist(/*@out@*/struct atomset *, const struct atomlist *);
+/* add all of the second to the first */
+retvalue atomset_union(struct atomset *, const struct atomset *);
+/* remove all from the first not in the second */
+void atomset_intersect(struct atomset *, const struct atomset *);
+/* if missing != NULL And subset no subset of set, set *missing to the lowest missing one */
+bool atomset_subset(const struct atomset *, const struct atomset * /*subset*/, /*@null@*/atom_t * /*missing*/);
+bool atomset_hasexcept(const struct atomset *, atom_t);
 #endif
@@ -63,17 +63,22 @@ static retvalue binaries_parse_checksums(const char *chunk, /*@out@*/struct chec
 	char *checksums[cs_COUNT];
 	enum checksumtype type;
 	bool gothash = false;
+	struct chunkindex ci;
 
+	r = chunkindex_init(&ci, chunk);
+	if (RET_WAS_ERROR(r))
+		return r;
 	result = RET_NOTHING;
 
 	for (type = 0 ; type < cs_COUNT ; type++) {
 		checksums[type] = NULL;
-		r = chunk_getvalue(chunk, deb_checksum_headers[type],
+		r = chunkindex_getvalue(&ci, deb_checksum_headers[type],
 				&checksums[type]);
 		if (type != cs_length && RET_IS_OK(r))
 			gothash = true;
 		RET_UPDATE(result, r);
 	}
+	chunkindex_done(&ci);
 	if (!gothash) {
 		fprintf(stderr,
 "No checksums found in binary control chunk:\n '%s'\n",
@@ -95,20 +100,17 @@ static retvalue binaries_parse_checksums(const char *chunk, /*@out@*/struct chec
 }
 
 retvalue binaries_getarchitecture(const char *chunk, architecture_t *architecture_p) {
-	char *parch;
-	retvalue r;
+	static const char * const architecturefield[1] = { "Architecture" };
+	struct chunkvalue parch;
 
-	r = chunk_getvalue(chunk, "Architecture", &parch);
-	if (r == RET_NOTHING) {
+	chunk_getvalues(chunk, 1, architecturefield, &parch);
+	if (parch.value == NULL) {
 		fprintf(stderr,
 "Internal Error: Missing Architecture: header in '%s'!\n",
 				chunk);
 		return RET_ERROR;
 	}
-	if (RET_WAS_ERROR(r))
-		return r;
-	*architecture_p = architecture_find(parch);
-	free(parch);
+	*architecture_p = architecture_find_l(parch.value, parch.len);
 
 	if (!atom_defined(*architecture_p)) {
 		fprintf(stderr,
@@ -206,19 +208,17 @@ static inline retvalue calcnewcontrol(const char *chunk, const char *packagename
 	return RET_OK;
 }
 
-retvalue binaries_getversion(const char *control, char **version) {
-	retvalue r;
+retvalue binaries_getversion(const char *control, struct chunkvalue *version) {
+	static const char * const versionfield[1] = { "Version" };
 
-	r = chunk_getvalue(control, "Version", version);
-	if (RET_WAS_ERROR(r))
-		return r;
-	if (r == RET_NOTHING) {
+	chunk_getvalues(control, 1, versionfield, version);
+	if (version->value == NULL) {
 		fprintf(stderr,
 "Missing 'Version' field in chunk:'%s'\n",
 				control);
 		return RET_ERROR;
 	}
-	return r;
+	return RET_OK;
 }
 
 retvalue binaries_getinstalldata(const struct target *t, struct package *package, char **control, struct strlist *filekeys, struct checksumsarray *origfiles) {
@@ -397,6 +397,16 @@ retvalue binaries_retrack(const char *packagename, const char *chunk, trackingdb
 		free(fsourcename);
 		return r;
 	}
+	/* when retracking the file is usually already known,
+	 * then there is no need to parse and rewrite the data */
+	r = tracking_usefilekey(tracks, sourcename, sourceversion,
+			filetype, filekey);
+	if (r != RET_NOTHING) {
+		free(fsourcename);
+		free(sourceversion);
+		free(filekey);
+		return r;
+	}
 	r = tracking_getornew(tracks, sourcename, sourceversion, &pkg);
 	free(fsourcename);
 	free(sourceversion);
@@ -413,39 +423,26 @@ retvalue binaries_retrack(const char *packagename, const char *chunk, trackingdb
 	return tracking_save(tracks, pkg);
 }
 
-retvalue binaries_getsourceandversion(const char *chunk, const char *packagename, char **source, char **version) {
+retvalue binaries_getsourceandversion(const char *chunk, const char *packagename, struct chunkvalue *source, struct chunkvalue *version) {
 	retvalue r;
-	char *sourcename, *sourceversion;
 
 	//TODO: eliminate duplicate code!
 	assert(packagename!=NULL);
 
 	/* is there a sourcename */
-	r = chunk_getnameandversion(chunk, "Source",
-			&sourcename, &sourceversion);
+	r = chunk_getnameandversionvalues(chunk, "Source", source, version);
 	if (RET_WAS_ERROR(r))
 		return r;
 	if (r == RET_NOTHING) {
-		sourceversion = NULL;
-		sourcename = strdup(packagename);
-		if (FAILEDTOALLOC(sourcename))
-			return RET_ERROR_OOM;
+		version->value = NULL;
+		source->value = packagename;
+		source->len = strlen(packagename);
 	}
-	if (sourceversion == NULL) {
-		r = chunk_getvalue(chunk, "Version", &sourceversion);
-		if (RET_WAS_ERROR(r)) {
-			free(sourcename);
+	if (version->value == NULL) {
+		r = binaries_getversion(chunk, version);
+		if (RET_WAS_ERROR(r))
 			return r;
-		}
-		if (r == RET_NOTHING) {
-			free(sourcename);
-			fprintf(stderr, "No Version field in chunk:'%s'\n",
-					chunk);
-			return RET_ERROR;
-		}
 	}
-	*source = sourcename;
-	*version = sourceversion;
 	return RET_OK;
 }
 
@@ -491,13 +488,20 @@ void binaries_debdone(struct deb_headers *pkg) {
 	free(pkg->priority);
 }
 
+retvalue binaries_extractdeb(struct deb_headers *deb, const char *filename) {
+	assert (deb->control == NULL);
+	return extractcontrol(&deb->control, filename);
+}
+
 retvalue binaries_readdeb(struct deb_headers *deb, const char *filename) {
 	retvalue r;
 	char *architecture;
 
-	r = extractcontrol(&deb->control, filename);
-	if (RET_WAS_ERROR(r))
-		return r;
+	if (deb->control == NULL) {
+		r = binaries_extractdeb(deb, filename);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
 	/* first look for fields that should be there */
 
 	r = chunk_getname(deb->control, "Package", &deb->name, false);
@@ -45,6 +45,10 @@ struct deb_headers {
  * - no checks for sanity of values, left to the caller */
 
 retvalue binaries_readdeb(struct deb_headers *, const char *filename);
+/* only extract the control information into ->control, touching nothing
+ * but the struct and the file, so it can be called from jobs.
+ * binaries_readdeb will then only parse it */
+retvalue binaries_extractdeb(struct deb_headers *, const char *filename);
 void binaries_debdone(struct deb_headers *);
 
 retvalue binaries_calcfilekeys(component_t, const struct deb_headers *, packagetype_t, /*@out@*/struct strlist *);
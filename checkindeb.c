@@ -39,6 +39,10 @@
 #include "tracking.h"
 #include "override.h"
 #include "hooks.h"
+#include "debfile.h"
+#include "filelist.h"
+#include "contents.h"
+#include "jobs.h"
 
 /* This file includes the code to include binaries, i.e.
    to create the chunk for the Packages.gz-file and
@@ -72,14 +76,10 @@ void deb_free(/*@only@*/struct debpackage *pkg) {
 	free(pkg);
 }
 
-/* read the data from a .deb, make some checks and extract some data */
-static retvalue deb_read(/*@out@*/struct debpackage **pkg, const char *filename) {
+/* parse the data from a .deb and make some checks
+ * (the control data may already be extracted by deb_fetch) */
+static retvalue deb_parse(struct debpackage *deb, const char *filename) {
 	retvalue r;
-	struct debpackage *deb;
-
-	deb = zNEW(struct debpackage);
-	if (FAILEDTOALLOC(deb))
-		return RET_ERROR_OOM;
 
 	r = binaries_readdeb(&deb->deb, filename);
 	if (RET_IS_OK(r))
@@ -90,6 +90,19 @@ static retvalue deb_read(/*@out@*/struct debpackage **pkg, const char *filename)
 		r = properversion(deb->deb.sourceversion);
 	if (RET_IS_OK(r))
 		r = properversion(deb->deb.version);
+	return r;
+}
+
+/* read the data from a .deb, make some checks and extract some data */
+static retvalue deb_read(/*@out@*/struct debpackage **pkg, const char *filename) {
+	retvalue r;
+	struct debpackage *deb;
+
+	deb = zNEW(struct debpackage);
+	if (FAILEDTOALLOC(deb))
+		return RET_ERROR_OOM;
+
+	r = deb_parse(deb, filename);
 	if (RET_WAS_ERROR(r)) {
 		deb_free(deb);
 		return r;
@@ -370,12 +383,57 @@ retvalue deb_addprepared(const struct debpackage *pkg, const struct atomlist *fo
 			pkg->deb.control);
 }
 
+/* A .deb file is read only once (see debfile_read) before adding it,
+ * when adding many files this is done by jobs for the next files,
+ * while the read ones are added (in the order they were given). */
+
+struct debfetch {
+	const char *filename;
+	bool wantfilelist;
+	struct debpackage *pkg;
+	struct checksums *checksums;
+	char *filelist;
+	size_t filelistsize;
+	retvalue result;
+};
+
+static void deb_fetchinit(struct debfetch *f, const char *filename, const struct distribution *distribution, packagetype_t packagetype) {
+	f->filename = filename;
+	/* if Contents files are generated with those packages, get the list
+	 * of files while reading the file anyway */
+	f->wantfilelist = contents_wanted(distribution, packagetype);
+	f->pkg = NULL;
+	f->checksums = NULL;
+	f->filelist = NULL;
+	f->filelistsize = 0;
+	/* what is left when a job was not started: */
+	f->result = RET_ERROR_INTERRUPTED;
+}
+
+static retvalue deb_fetch(void *privdata, size_t n) {
+	struct debfetch *f = (struct debfetch *)privdata + n;
+	retvalue r;
+
+	f->pkg = zNEW(struct debpackage);
+	if (FAILEDTOALLOC(f->pkg))
+		r = RET_ERROR_OOM;
+	else
+		r = debfile_read(f->filename, &f->checksums,
+				&f->pkg->deb.control,
+				f->wantfilelist?&f->filelist:NULL,
+				&f->filelistsize);
+	f->result = r;
+	/* other files are still to be read */
+	return RET_OK;
+}
+
 /* insert the given .deb into the mirror in <component> in the <distribution>
  * putting things with architecture of "all" into <d->architectures> (and also
  * causing error, if it is not one of them otherwise)
  * if component is NULL, guessing it from the section. */
-retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, const char *debfilename, int delete, /*@null@*/trackingdb tracks) {
-	struct debpackage *pkg;
+static retvalue deb_addfetched(struct debfetch *f, component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, int delete, /*@null@*/trackingdb tracks) {
+	const char *debfilename = f->filename;
+	struct debpackage *pkg = f->pkg;
 	retvalue r;
 	struct trackingdata trackingdata;
 	const struct overridedata *oinfo;
@@ -384,18 +442,21 @@ retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchite
 
 	causingfile = debfilename;
 
-	r = deb_read(&pkg, debfilename);
-	if (RET_WAS_ERROR(r)) {
-		return r;
-	}
-	r = deb_preparelocation(pkg, forcecomponent, forcearchitectures,
-			forcesection, forcepriority, packagetype, distribution,
-			&oinfo, debfilename);
-	if (RET_WAS_ERROR(r)) {
-		deb_free(pkg);
-		return r;
-	}
-	r = files_preinclude(debfilename, pkg->filekey, &checksums);
+	r = f->result;
+	if (RET_IS_OK(r))
+		r = deb_parse(pkg, debfilename);
+	if (RET_IS_OK(r))
+		r = deb_preparelocation(pkg, forcecomponent,
+				forcearchitectures, forcesection,
+				forcepriority, packagetype, distribution,
+				&oinfo, debfilename);
+	if (RET_IS_OK(r))
+		r = files_preincludeknown(debfilename, pkg->filekey,
+				f->checksums, &checksums);
+	if (!RET_WAS_ERROR(r) && f->filelist != NULL)
+		r = cachefilelist(pkg->filekey, f->filelist, f->filelistsize);
+	free(f->filelist);
+	checksums_free(f->checksums);
 	if (RET_WAS_ERROR(r)) {
 		deb_free(pkg);
 		return r;
@@ -442,3 +503,58 @@ retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchite
 
 	return r;
 }
+
+retvalue deb_add(component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, const char *debfilename, int delete, /*@null@*/trackingdb tracks) {
+	struct debfetch f;
+
+	deb_fetchinit(&f, debfilename, distribution, packagetype);
+	(void)deb_fetch(&f, 0);
+	return deb_addfetched(&f, forcecomponent, forcearchitectures,
+			forcesection, forcepriority, packagetype,
+			distribution, delete, tracks);
+}
+
+retvalue deb_addmany(component_t forcecomponent, const struct atomlist *forcearchitectures, const char *forcesection, const char *forcepriority, packagetype_t packagetype, struct distribution *distribution, int count, const char * const *debfilenames, int delete, /*@null@*/trackingdb tracks) {
+	struct debfetch *fetched;
+	size_t batchsize, todo, n;
+	retvalue result, r;
+
+	if (global.jobs <= 1 || count <= 1) {
+		result = RET_NOTHING;
+		for (n = 0 ; n < (size_t)count ; n++) {
+			r = deb_add(forcecomponent, forcearchitectures,
+					forcesection, forcepriority,
+					packagetype, distribution,
+					debfilenames[n], delete, tracks);
+			RET_UPDATE(result, r);
+		}
+		return result;
+	}
+
+	batchsize = 4 * global.jobs;
+	fetched = nzNEW(batchsize, struct debfetch);
+	if (FAILEDTOALLOC(fetched))
+		return RET_ERROR_OOM;
+	result = RET_NOTHING;
+	while (count > 0 && !interrupted()) {
+		todo = ((size_t)count < batchsize)?(size_t)count:batchsize;
+		for (n = 0 ; n < todo ; n++)
+			deb_fetchinit(&fetched[n], debfilenames[n],
+					distribution, packagetype);
+		(void)jobs_run(todo, deb_fetch, fetched);
+		for (n = 0 ; n < todo ; n++) {
+			r = deb_addfetched(&fetched[n], forcecomponent,
+					forcearchitectures,
+					forcesection, forcepriority,
+					packagetype, distribution,
+					delete, tracks);
+			RET_UPDATE(result, r);
+		}
+		debfilenames += todo;
+		count -= todo;
+	}
+	free(fetched);
+	if (count > 0)
+		RET_UPDATE(result, RET_ERROR_INTERRUPTED);
+	return result;
+}
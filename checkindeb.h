@@ -19,6 +19,8 @@
  * package. (forcesection and forcepriority have higher priority than the
  * information there), */
 retvalue deb_add(component_t, const struct atomlist * /*forcearchitectures*/, /*@null@*/const char * /*forcesection*/, /*@null@*/const char * /*forcepriority*/, packagetype_t, struct distribution *, const char * /*debfilename*/, int /*delete*/, /*@null@*/trackingdb);
+/* the same for multiple files, reading them in parallel with --jobs */
+retvalue deb_addmany(component_t, const struct atomlist * /*forcearchitectures*/, /*@null@*/const char * /*forcesection*/, /*@null@*/const char * /*forcepriority*/, packagetype_t, struct distribution *, int /*count*/, const char * const * /*debfilenames*/, int /*delete*/, /*@null@*/trackingdb);
 
 /* in two steps */
 struct debpackage;
@@ -1082,6 +1082,18 @@ static retvalue copy(const char *destination, const char *source, const struct c
 	return RET_OK;
 }
 
+retvalue checksums_copyknownfile(const char *destination, const char *source, const struct checksums *checksums) {
+	int e;
+
+	if (unlink(destination) != 0 && errno != ENOENT) {
+		e = errno;
+		fprintf(stderr, "Error %d deleting '%s': %s\n",
+				e, destination, strerror(e));
+		return RET_ERRNO(e);
+	}
+	return copy(destination, source, checksums);
+}
+
 retvalue checksums_hardlink(const char *directory, const char *filekey, const char *sourcefilename, const struct checksums *checksums) {
 	retvalue r;
 	int i, e;
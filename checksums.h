@@ -66,6 +66,10 @@ bool checksums_matches(const struct checksums *, enum checksumtype, const char *
 retvalue checksums_copyfile(const char * /*destination*/, const char * /*origin*/, bool /*deletetarget*/, /*@out@*/struct checksums **);
 retvalue checksums_hardlink(const char * /*directory*/, const char * /*filekey*/, const char * /*sourcefilename*/, const struct checksums *);
 
+/* Copy file <origin> with already known checksums to file <destination>,
+ * only checking the size (like copyfile with deletetarget set) */
+retvalue checksums_copyknownfile(const char * /*destination*/, const char * /*origin*/, const struct checksums *);
+
 retvalue checksums_linkorcopyfile(const char * /*destination*/, const char * /*origin*/, /*@out@*/struct checksums **);
 
 /* calculare checksums of a file: */
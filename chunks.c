@@ -120,6 +120,44 @@ retvalue chunk_getvalue(const char *chunk, const char *name, char **value) {
 	return RET_OK;
 }
 
+void chunk_getvalues(const char *chunk, size_t count, const char * const *names, struct chunkvalue *values) {
+	const char *line, *end, *eol, *colon, *b, *e;
+	size_t i, missing = count;
+
+	for (i = 0 ; i < count ; i++)
+		values[i].value = NULL;
+
+	end = chunk + strlen(chunk);
+	for (line = chunk ; missing > 0 && line < end ; line = eol + 1) {
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+		colon = memchr(line, ':', eol - line);
+		if (colon == NULL)
+			continue;
+		for (i = 0 ; i < count ; i++) {
+			if (values[i].value != NULL)
+				continue;
+			if (strncasecmp(names[i], line, colon - line) != 0
+					|| names[i][colon - line] != '\0')
+				continue;
+			b = colon + 1;
+			while (b < eol && (*b == ' ' || *b == '\t'))
+				b++;
+			e = eol;
+			/* (as chunk_getvalue, only remove trailing
+			 * spaces if this is not the last line) */
+			if (*eol == '\n')
+				while (e > b && xisspace(*(e-1)))
+					e--;
+			values[i].value = b;
+			values[i].len = e - b;
+			missing--;
+			break;
+		}
+	}
+}
+
 retvalue chunk_getextralinelist(const char *chunk, const char *name, struct strlist *strlist) {
 	retvalue r;
 	const char *f, *b, *e;
@@ -367,9 +405,8 @@ retvalue chunk_getname(const char *chunk, const char *name, char **pkgname, bool
 }
 
 /* Parse a package/source-field: ' *value( ?\(version\))? *' */
-retvalue chunk_getnameandversion(const char *chunk, const char *name, char **pkgname, char **version) {
+retvalue chunk_getnameandversionvalues(const char *chunk, const char *name, struct chunkvalue *pkgname, struct chunkvalue *version) {
 	const char *field, *name_end, *p;
-	char *v;
 
 	field = chunk_getfield(name, chunk);
 	if (field == NULL)
@@ -396,22 +433,17 @@ retvalue chunk_getnameandversion(const char *chunk, const char *name, char **pkg
 		return RET_ERROR;
 	}
 	if (*p == '(') {
-		const char *version_begin;
-
 		p++;
 		while (*p != '\0' && *p != '\n' && xisspace(*p))
 			p++;
-		version_begin = p;
+		version->value = p;
 		while (*p != '\0' && *p != '\n' && *p != ')'  && !xisspace(*p))
 			// TODO: perhaps check for wellformed version
 			p++;
-		v = strndup(version_begin, p - version_begin);
-		if (FAILEDTOALLOC(v))
-			return RET_ERROR_OOM;
+		version->len = p - version->value;
 		while (*p != '\0' && *p != '\n' && *p != ')'  && xisspace(*p))
 			p++;
 		if (*p != ')') {
-			free(v);
 			if (*p == '\0' || *p == '\n')
 				fprintf(stderr,
 "Error: Field '%s' misses closing parenthesis!\n",
@@ -424,31 +456,167 @@ retvalue chunk_getnameandversion(const char *chunk, const char *name, char **pkg
 		}
 		p++;
 	} else {
-		v = NULL;
+		version->value = NULL;
+		version->len = 0;
 	}
 	while (*p != '\0' && *p != '\n' && xisspace(*p))
 		p++;
 	if (*p != '\0' && *p != '\n') {
-		free(v);
 		fprintf(stderr,
 "Error: Field '%s' contains trailing junk starting with '%c'!\n",
 				name, *p);
 		return RET_ERROR;
 	}
+	pkgname->value = field;
+	pkgname->len = name_end - field;
+	return RET_OK;
+}
 
-	*pkgname = strndup(field, name_end - field);
+retvalue chunk_getnameandversion(const char *chunk, const char *name, char **pkgname, char **version) {
+	struct chunkvalue n, v;
+	char *vs;
+	retvalue r;
+
+	r = chunk_getnameandversionvalues(chunk, name, &n, &v);
+	if (!RET_IS_OK(r))
+		return r;
+	if (v.value != NULL) {
+		vs = strndup(v.value, v.len);
+		if (FAILEDTOALLOC(vs))
+			return RET_ERROR_OOM;
+	} else
+		vs = NULL;
+	*pkgname = strndup(n.value, n.len);
 	if (FAILEDTOALLOC(*pkgname)) {
-		free(v);
+		free(vs);
+		return RET_ERROR_OOM;
+	}
+	*version = vs;
+	return RET_OK;
+}
+
+/* case-insensitive, as field names are */
+static inline unsigned int fieldname_hash(const char *name, size_t len) {
+	unsigned int h = 5381;
+
+	while (len-- > 0)
+		h = (h * 33) ^ (unsigned char)(*(name++) | 0x20);
+	return h;
+}
+
+static inline bool fieldname_matches(const char *line, const char *name, size_t len) {
+	return strncasecmp(name, line, len) == 0 && line[len] == ':';
+}
+
+/* returns false if the field was already there (only the first counts) */
+static bool chunkindex_insert(struct chunkindex *ci, const char *line, size_t len) {
+	unsigned int i = fieldname_hash(line, len) & ci->mask;
+
+	while (ci->lines[i] != NULL) {
+		if (fieldname_matches(ci->lines[i], line, len))
+			return false;
+		i = (i + 1) & ci->mask;
+	}
+	ci->lines[i] = line;
+	ci->count++;
+	return true;
+}
+
+static retvalue chunkindex_grow(struct chunkindex *ci) {
+	const char **old = ci->lines;
+	unsigned int i, oldsize = ci->mask + 1;
+
+	ci->lines = nzNEW(2 * oldsize, const char *);
+	if (FAILEDTOALLOC(ci->lines)) {
+		ci->lines = old;
 		return RET_ERROR_OOM;
 	}
-	*version = v;
+	ci->mask = 2 * oldsize - 1;
+	ci->count = 0;
+	for (i = 0 ; i < oldsize ; i++) {
+		const char *colon;
+
+		if (old[i] == NULL)
+			continue;
+		colon = strchr(old[i], ':');
+		assert (colon != NULL);
+		(void)chunkindex_insert(ci, old[i], colon - old[i]);
+	}
+	if (old != ci->inlinelines)
+		free(old);
+	return RET_OK;
+}
+
+retvalue chunkindex_init(struct chunkindex *ci, const char *chunk) {
+	const char *line, *end, *eol, *colon;
+	retvalue r;
+
+	ci->lines = ci->inlinelines;
+	ci->mask = CHUNKINDEX_INLINESIZE - 1;
+	ci->count = 0;
+	memset(ci->inlinelines, 0, sizeof(ci->inlinelines));
+
+	end = chunk + strlen(chunk);
+	for (line = chunk ; line < end ; line = eol + 1) {
+		eol = memchr(line, '\n', end - line);
+		if (eol == NULL)
+			eol = end;
+		/* continuation lines never start a field */
+		if (*line == ' ' || *line == '\t')
+			continue;
+		colon = memchr(line, ':', eol - line);
+		if (colon == NULL || colon == line)
+			continue;
+		if (4 * (ci->count + 1) > 3 * (ci->mask + 1)) {
+			r = chunkindex_grow(ci);
+			if (RET_WAS_ERROR(r)) {
+				chunkindex_done(ci);
+				return r;
+			}
+		}
+		(void)chunkindex_insert(ci, line, colon - line);
+	}
 	return RET_OK;
+}
 
+void chunkindex_done(struct chunkindex *ci) {
+	if (ci->lines != ci->inlinelines)
+		free(ci->lines);
+	ci->lines = NULL;
+}
+
+/* returns the line the field starts in, which is a chunk that has
+ * this field first, so the chunk_* functions find it immediately */
+static const char *chunkindex_getfield(const struct chunkindex *ci, const char *name) {
+	size_t l = strlen(name);
+	unsigned int i = fieldname_hash(name, l) & ci->mask;
+
+	while (ci->lines[i] != NULL) {
+		if (fieldname_matches(ci->lines[i], name, l))
+			return ci->lines[i];
+		i = (i + 1) & ci->mask;
+	}
+	return NULL;
+}
+
+retvalue chunkindex_getvalue(const struct chunkindex *ci, const char *name, char **value) {
+	const char *line = chunkindex_getfield(ci, name);
+
+	if (line == NULL)
+		return RET_NOTHING;
+	return chunk_getvalue(line, name, value);
+}
+
+retvalue chunkindex_getextralinelist(const struct chunkindex *ci, const char *name, struct strlist *strlist) {
+	const char *line = chunkindex_getfield(ci, name);
+
+	if (line == NULL)
+		return RET_NOTHING;
+	return chunk_getextralinelist(line, name, strlist);
 }
 
 /* Add this the <fields to add> to <chunk> before <beforethis> field,
  * replacing older fields of this name, if they are already there. */
-
 char *chunk_replacefields(const char *chunk, const struct fieldtoadd *toadd, const char *beforethis, bool maybemissing) {
 	const char *c, *ce;
 	char *newchunk, *n;
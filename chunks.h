@@ -25,6 +25,37 @@ retvalue chunk_gettruth(const char *, const char *);
 /* return RET_OK, if field is found, RET_NOTHING, if not */
 retvalue chunk_checkfield(const char *, const char *);
 
+/* the first line of a field's value, pointing into the chunk: */
+struct chunkvalue {
+	/* NULL if the field is not there */
+	/*@null@*//*@dependent@*/const char *value;
+	size_t len;
+};
+/* look for all the given fields in one pass over the chunk,
+ * (the values are cut like chunk_getvalue does, but not copied) */
+void chunk_getvalues(const char *, size_t /*count*/, const char * const * /*names*/, /*@out@*/struct chunkvalue *);
+
+/* like chunk_getnameandversion, without copying (version.value is
+ * NULL if there is no version) */
+retvalue chunk_getnameandversionvalues(const char *, const char *, /*@out@*/struct chunkvalue * /*pkgname*/, /*@out@*/struct chunkvalue * /*version*/);
+
+/* A chunk with a table where its fields start, so that looking up
+ * many fields of the same chunk does not mean scanning it each time.
+ * (The chunk must stay unchanged while it is used, and this struct
+ * may not be copied, as it may point into itself) */
+#define CHUNKINDEX_INLINESIZE 64
+struct chunkindex {
+	unsigned int mask, count;
+	/* the beginning of the line of each field, NULL if unused: */
+	const char **lines;
+	const char *inlinelines[CHUNKINDEX_INLINESIZE];
+};
+retvalue chunkindex_init(/*@out@*/struct chunkindex *, const char *);
+void chunkindex_done(struct chunkindex *);
+/* the same as the chunk_* functions, but for an indexed chunk: */
+retvalue chunkindex_getvalue(const struct chunkindex *, const char *, /*@out@*/char **);
+retvalue chunkindex_getextralinelist(const struct chunkindex *, const char *, /*@out@*/struct strlist *);
+
 /* modifications of a chunk: */
 struct fieldtoadd {
 	/*@null@*/struct fieldtoadd *next;
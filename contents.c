@@ -365,6 +365,16 @@ static retvalue genarchcontents(struct distribution *distribution, architecture_
 	return result;
 }
 
+bool contents_wanted(const struct distribution *distribution, packagetype_t packagetype) {
+	if (!distribution->contents.flags.enabled)
+		return false;
+	if (packagetype == pt_udeb)
+		return distribution->contents.flags.udebs;
+	if (packagetype == pt_ddeb)
+		return distribution->contents.flags.ddebs;
+	return !distribution->contents.flags.nodebs;
+}
+
 retvalue contents_generate(struct distribution *distribution, struct release *release, bool onlyneeded) {
 	retvalue result, r;
 	int i;
@@ -373,6 +383,12 @@ retvalue contents_generate(struct distribution *distribution, struct release *re
 	if (distribution->contents.compressions == 0)
 		distribution->contents.compressions = IC_FLAG(ic_gzip);
 
+	/* read what is not yet cached with multiple jobs,
+	 * what fails here is tried (and reported) again below */
+	r = filelists_processpending();
+	if (r == RET_ERROR_INTERRUPTED || r == RET_ERROR_OOM)
+		return r;
+
 	result = RET_NOTHING;
 	if (distribution->contents_architectures_set) {
 		architectures = &distribution->contents_architectures;
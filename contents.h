@@ -10,6 +10,9 @@
 #ifndef REPREPRO_RELEASE_H
 #include "release.h"
 #endif
+#ifndef REPREPRO_ATOMS_H
+#include "atoms.h"
+#endif
 
 struct contentsoptions {
 	struct {
@@ -29,5 +32,7 @@ struct configiterator;
 
 retvalue contentsoptions_parse(struct distribution *, struct configiterator *);
 retvalue contents_generate(struct distribution *, struct release *, bool /*onlyneeded*/);
+/* are Contents files generated for packages of this type? */
+bool contents_wanted(const struct distribution *, packagetype_t);
 
 #endif
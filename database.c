@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <pthread.h>
 #include <db.h>
 
 #include "globals.h"
@@ -57,9 +58,14 @@ static int rdb_dircreationdepth;
 static bool rdb_nopackages, rdb_readonly;
 static /*@null@*/ char *rdb_version, *rdb_lastsupportedversion,
 	*rdb_dbversion, *rdb_lastsupporteddbversion;
+/* the first version able to read everything written */
+static const char *rdb_neededversion = "3.3.0";
 static DB_ENV *rdb_env = NULL;
 
 struct table *rdb_checksums, *rdb_contents;
+struct table *rdb_pendingfilelists;
+/* opened when first needed by database_opensignaturecache: */
+static struct table *rdb_signaturecache;
 struct table *rdb_references;
 static struct {
 	bool createnewtables;
@@ -72,6 +78,9 @@ struct opened_tables {
 };
 
 struct opened_tables *opened_tables = NULL;
+/* package tables of different targets may be opened and closed
+ * by multiple threads at the same time (see query.c) */
+static pthread_mutex_t opened_tables_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static void database_free(void) {
 	if (!rdb_initialized)
@@ -101,8 +110,9 @@ static retvalue database_openenv(void) {
 	}
 
 	// DB_INIT_LOCK is needed to open multiple databases in one file (e.g. for move command)
+	// DB_THREAD so different threads can use their own tables
 	dbret = rdb_env->open(rdb_env, global.dbdir,
-	                      DB_CREATE | DB_INIT_MPOOL | DB_PRIVATE | DB_INIT_LOCK, 0664);
+	                      DB_CREATE | DB_INIT_MPOOL | DB_PRIVATE | DB_INIT_LOCK | DB_THREAD, 0664);
 	if (dbret != 0) {
 		rdb_env->err(rdb_env, dbret, "environment open: %s", global.dbdir);
 		return RET_ERROR;
@@ -236,6 +246,16 @@ retvalue database_close(void) {
 		RET_UPDATE(result, r);
 		rdb_contents = NULL;
 	}
+	if (rdb_pendingfilelists != NULL) {
+		r = table_close(rdb_pendingfilelists);
+		RET_UPDATE(result, r);
+		rdb_pendingfilelists = NULL;
+	}
+	if (rdb_signaturecache != NULL) {
+		r = table_close(rdb_signaturecache);
+		RET_UPDATE(result, r);
+		rdb_signaturecache = NULL;
+	}
 	r = writeversionfile();
 	RET_UPDATE(result, r);
 	if (rdb_locked)
@@ -258,16 +278,19 @@ static retvalue database_hasdatabasefile(const char *filename, /*@out@*/bool *ex
 enum database_type {
 	dbt_QUERY,
 	dbt_BTREE, dbt_BTREEDUP, dbt_BTREEPAIRS, dbt_BTREEVERSIONS,
+	dbt_BTREEINDEX,
 	dbt_HASH,
 	dbt_COUNT /* must be last */
 };
 static const uint32_t types[dbt_COUNT] = {
 	DB_UNKNOWN,
 	DB_BTREE, DB_BTREE, DB_BTREE, DB_BTREE,
+	DB_BTREE,
 	DB_HASH
 };
 
 static int debianversioncompare(UNUSED(DB *db), const DBT *a, const DBT *b);
+static int primarykeycompare(DB *db, const DBT *a, const DBT *b);
 #if DB_VERSION_MAJOR >= 6
 static int paireddatacompare(UNUSED(DB *db), const DBT *a, const DBT *b, size_t *locp);
 #else
@@ -283,7 +306,8 @@ static retvalue database_opentable(const char *filename, /*@null@*/const char *s
 		fprintf(stderr, "db_create: %s\n", db_strerror(dbret));
 		return RET_DBERR(dbret);
 	}
-	if (type == dbt_BTREEPAIRS || type == dbt_BTREEVERSIONS) {
+	if (type == dbt_BTREEPAIRS || type == dbt_BTREEVERSIONS
+			|| type == dbt_BTREEINDEX) {
 		dbret = table->set_flags(table, DB_DUPSORT);
 		if (dbret != 0) {
 			table->err(table, dbret, "db_set_flags(DB_DUPSORT):");
@@ -314,6 +338,14 @@ static retvalue database_opentable(const char *filename, /*@null@*/const char *s
 			return RET_DBERR(dbret);
 		}
 	}
+	if (type == dbt_BTREEINDEX) {
+		dbret = table->set_dup_compare(table, primarykeycompare);
+		if (dbret != 0) {
+			table->err(table, dbret, "db_set_dup_compare:");
+			(void)table->close(table, 0);
+			return RET_DBERR(dbret);
+		}
+	}
 
 #if DB_VERSION_MAJOR == 5 || DB_VERSION_MAJOR == 6
 #define DB_OPEN(database, filename, name, type, flags) \
@@ -755,6 +787,17 @@ static retvalue readversionfile(bool nopackagesyet) {
 	return RET_OK;
 }
 
+/* something was written older versions cannot read,
+ * so make them refuse to use this database */
+void database_requireversion(const char *version) {
+	retvalue r;
+	int c;
+
+	r = dpkgversions_cmp(version, rdb_neededversion, &c);
+	if (RET_IS_OK(r) && c > 0)
+		rdb_neededversion = version;
+}
+
 static retvalue writeversionfile(void) {
 	char *versionfilename, *finalversionfilename;
 	FILE *f;
@@ -778,16 +821,18 @@ static retvalue writeversionfile(void) {
 		(void)fputc('\n', f);
 	}
 	if (rdb_lastsupportedversion == NULL) {
-		(void)fputs("3.3.0\n", f);
+		(void)fputs(rdb_neededversion, f);
+		(void)fputc('\n', f);
 	} else {
 		int c;
 		retvalue r;
 
 		r = dpkgversions_cmp(rdb_lastsupportedversion,
-				"3.3.0", &c);
-		if (!RET_IS_OK(r) || c < 0)
-			(void)fputs("3.3.0\n", f);
-		else {
+				rdb_neededversion, &c);
+		if (!RET_IS_OK(r) || c < 0) {
+			(void)fputs(rdb_neededversion, f);
+			(void)fputc('\n', f);
+		} else {
 			(void)fputs(rdb_lastsupportedversion, f);
 			(void)fputc('\n', f);
 		}
@@ -1000,12 +1045,16 @@ struct cursor {
 	DBC *cursor;
 	uint32_t flags;
 	retvalue r;
+	/* for cursors in the source index: the source to look for */
+	/*@null@*/char *sourcename;
 };
 
 struct table {
 	char *name, *subname;
 	DB *berkeleydb;
 	DB *sec_berkeleydb;
+	/* packages.db only: index by source name (might not be there) */
+	/*@null@*/DB *src_berkeleydb;
 	bool readonly, verbose;
 	uint32_t flags;
 };
@@ -1069,6 +1118,15 @@ retvalue table_close(struct table *table) {
 		        table == NULL ? NULL : table->name, table == NULL ? NULL : table->subname);
 	if (table == NULL)
 		return RET_NOTHING;
+	if (table->src_berkeleydb != NULL) {
+		dbret = table->src_berkeleydb->close(table->src_berkeleydb, 0);
+		if (dbret != 0) {
+			fprintf(stderr, "db_src_close(%s, %s): %s\n",
+					table->name, table->subname,
+					db_strerror(dbret));
+			result = RET_DBERR(dbret);
+		}
+	}
 	if (table->sec_berkeleydb != NULL) {
 		dbret = table->sec_berkeleydb->close(table->sec_berkeleydb, 0);
 		if (dbret != 0) {
@@ -1090,6 +1148,7 @@ retvalue table_close(struct table *table) {
 		result = RET_DBERR(dbret);
 	}
 
+	pthread_mutex_lock(&opened_tables_lock);
 	for (struct opened_tables *iter = opened_tables; iter != NULL; iter = iter->next) {
 		if(strcmp2(iter->name, table->name) == 0 && strcmp2(iter->subname, table->subname) == 0) {
 			if (prev == NULL) {
@@ -1105,6 +1164,7 @@ retvalue table_close(struct table *table) {
 
 	if (verbose >= 25)
 		print_opened_tables(stderr);
+	pthread_mutex_unlock(&opened_tables_lock);
 
 	free(table->name);
 	free(table->subname);
@@ -1642,11 +1702,12 @@ retvalue table_newpairedcursor(struct table *table, const char *key, const char
 	SETDBTl(Data, value, valuelen + 1);
 	dbret = cursor->cursor->c_get(cursor->cursor, &Key, &Data, DB_GET_BOTH);
 	if (dbret != 0) {
-		if (dbret == DB_NOTFOUND || dbret == DB_KEYEMPTY) {
+		if (dbret == DB_NOTFOUND || dbret == DB_KEYEMPTY)
+			r = RET_NOTHING;
+		else {
 			table_printerror(table, dbret, "c_get(DB_GET_BOTH)");
 			r = RET_DBERR(dbret);
-		} else
-			r = RET_NOTHING;
+		}
 		(void)cursor->cursor->c_close(cursor->cursor);
 		free(cursor);
 		return r;
@@ -1683,6 +1744,7 @@ retvalue cursor_close(struct table *table, struct cursor *cursor) {
 	r = cursor->r;
 	dbret = cursor->cursor->c_close(cursor->cursor);
 	cursor->cursor = NULL;
+	free(cursor->sourcename);
 	free(cursor);
 	if (dbret != 0) {
 		table_printerror(table, dbret, "c_close");
@@ -1801,6 +1863,84 @@ retvalue cursor_delete(struct table *table, struct cursor *cursor, const char *k
 	return RET_OK;
 }
 
+static retvalue table_opensourceindex(struct table *);
+
+bool table_hassourceindex(const struct table *table) {
+	return table->src_berkeleydb != NULL;
+}
+
+/* a cursor over all packages with the given source name,
+ * returns RET_NOTHING if there is no such index */
+retvalue table_newsourcecursor(struct table *table, const char *sourcename, struct cursor **cursor_p) {
+	struct cursor *cursor;
+	int dbret;
+
+	if (table->src_berkeleydb == NULL) {
+		retvalue r;
+
+		if (!table->readonly || table->berkeleydb == NULL)
+			return RET_NOTHING;
+		r = table_opensourceindex(table);
+		if (!RET_IS_OK(r))
+			return r;
+	}
+
+	cursor = zNEW(struct cursor);
+	if (FAILEDTOALLOC(cursor))
+		return RET_ERROR_OOM;
+	cursor->sourcename = strdup(sourcename);
+	if (FAILEDTOALLOC(cursor->sourcename)) {
+		free(cursor);
+		return RET_ERROR_OOM;
+	}
+	/* the first get must find the key, all later its duplicates */
+	cursor->flags = DB_SET;
+	cursor->r = RET_OK;
+	dbret = table->src_berkeleydb->cursor(table->src_berkeleydb, NULL,
+			&cursor->cursor, 0);
+	if (dbret != 0) {
+		table_printerror(table, dbret, "cursor");
+		free(cursor->sourcename);
+		free(cursor);
+		return RET_DBERR(dbret);
+	}
+	*cursor_p = cursor;
+	return RET_OK;
+}
+
+/* like cursor_nexttempdata, but returns the key in packages.db */
+bool cursor_nextsourcedata(struct table *table, struct cursor *cursor, const char **primarykey_p, const char **data_p, size_t *len_p) {
+	DBT Key, PKey, Data;
+	int dbret;
+	retvalue r;
+
+	assert (cursor->sourcename != NULL);
+	if (cursor->flags == DB_SET) {
+		SETDBT(Key, cursor->sourcename);
+	} else {
+		CLEARDBT(Key);
+	}
+	CLEARDBT(PKey);
+	CLEARDBT(Data);
+	dbret = cursor->cursor->c_pget(cursor->cursor, &Key, &PKey, &Data,
+			cursor->flags);
+	if (dbret == DB_NOTFOUND || dbret == DB_KEYEMPTY)
+		return false;
+	if (dbret != 0) {
+		table_printerror(table, dbret, (cursor->flags == DB_SET)
+				? "c_pget(DB_SET)" : "c_pget(DB_NEXT_DUP)");
+		cursor->r = RET_DBERR(dbret);
+		return false;
+	}
+	cursor->flags = DB_NEXT_DUP;
+	r = parse_data(table, PKey, Data, primarykey_p, data_p, len_p);
+	if (RET_WAS_ERROR(r)) {
+		cursor->r = r;
+		return false;
+	}
+	return true;
+}
+
 static bool table_isempty(struct table *table) {
 	DBC *cursor;
 	DBT Key, Data;
@@ -1857,15 +1997,18 @@ static retvalue database_table_secondary(const char *filename, const char *subta
 		fprintf(stderr, "trace: database_table_secondary(filename=%s, subtable=%s, type=%i, flags=%u, secondary_filename=%s, secondary_type=%i) called.\n",
 		        filename, subtable, type, flags, secondary_filename, secondary_type);
 
+	pthread_mutex_lock(&opened_tables_lock);
 	for (struct opened_tables *iter = opened_tables; iter != NULL; iter = iter->next) {
 		if(strcmp2(iter->name, filename) == 0 && strcmp2(iter->subname, subtable) == 0) {
             fprintf(stderr,
  "Internal Error: Trying to open table '%s' from file '%s' multiple times.\n"
  "This should normally not happen (to avoid triggering bugs in the underlying BerkeleyDB)\n",
                     subtable, filename);
+			pthread_mutex_unlock(&opened_tables_lock);
 			return RET_ERROR;
 		}
 	}
+	pthread_mutex_unlock(&opened_tables_lock);
 
 	table = zNEW(struct table);
 	if (FAILEDTOALLOC(table))
@@ -1945,11 +2088,13 @@ static retvalue database_table_secondary(const char *filename, const char *subta
 	}
 	opened_table->name = table->name;
 	opened_table->subname = table->subname;
+	pthread_mutex_lock(&opened_tables_lock);
 	opened_table->next = opened_tables;
 	opened_tables = opened_table;
 
 	if (verbose >= 25)
 		print_opened_tables(stderr);
+	pthread_mutex_unlock(&opened_tables_lock);
 
 	*table_p = table;
 	return r;
@@ -2013,6 +2158,27 @@ static int debianversioncompare(UNUSED(DB *db), const DBT *a, const DBT *b) {
 	return -versioncmp;
 }
 
+/* sort 'package|version' by package name first and then like
+ * packagenames.db, so iterating over both gives the same order */
+static int primarykeycompare(DB *db, const DBT *a, const DBT *b) {
+	const char *a_end, *b_end;
+	size_t a_len, b_len;
+	int c;
+
+	a_end = memchr(a->data, '|', a->size);
+	b_end = memchr(b->data, '|', b->size);
+	if (a_end == NULL || b_end == NULL)
+		return debianversioncompare(db, a, b);
+	a_len = a_end - (const char*)a->data;
+	b_len = b_end - (const char*)b->data;
+	c = memcmp(a->data, b->data, (a_len < b_len)?a_len:b_len);
+	if (c != 0)
+		return c;
+	if (a_len != b_len)
+		return (a_len < b_len)?-1:1;
+	return debianversioncompare(db, a, b);
+}
+
 /* only compare the first 0-terminated part of the data */
 static int paireddatacompare(UNUSED(DB *db), const DBT *a, const DBT *b
 #if DB_VERSION_MAJOR >= 6
@@ -2067,6 +2233,62 @@ static int get_package_name(DB *secondary, const DBT *pkey, const DBT *pdata, DB
 	return 0;
 }
 
+/* the source name for the index: either the Source field without
+ * version, or the package name if there is none */
+static int get_package_source(UNUSED(DB *secondary), const DBT *pkey, const DBT *pdata, DBT *skey) {
+	const char *separator;
+	char *sourcename;
+	retvalue r;
+
+	if (pdata->size == 0 ||
+	    ((const char*)pdata->data)[pdata->size - 1] != '\0')
+		return DB_DONOTINDEX;
+	r = chunk_getname(pdata->data, "Source", &sourcename, true);
+	if (r == RET_NOTHING) {
+		separator = memchr(pkey->data, '|', pkey->size);
+		if (unlikely(separator == NULL))
+			return DB_MALFORMED_KEY;
+		sourcename = strndup(pkey->data,
+				separator - (const char*)pkey->data);
+		if (FAILEDTOALLOC(sourcename))
+			return ENOMEM;
+	} else if (RET_WAS_ERROR(r))
+		return DB_DONOTINDEX;
+	skey->flags = DB_DBT_APPMALLOC;
+	skey->data = sourcename;
+	skey->size = strlen(sourcename) + 1;
+	return 0;
+}
+
+/* The index by source is optional: if it is not yet there,
+ * it is created (and filled from packages.db) when opening
+ * for writing. Without it searching by source has to look at
+ * all packages */
+static retvalue table_opensourceindex(struct table *table) {
+	retvalue r;
+	int dbret;
+
+	assert (table->src_berkeleydb == NULL);
+	r = database_opentable("packagesources.db", table->subname,
+			dbt_BTREEINDEX,
+			table->readonly?DB_RDONLY:DB_CREATE,
+			&table->src_berkeleydb);
+	if (!RET_IS_OK(r)) {
+		table->src_berkeleydb = NULL;
+		return r;
+	}
+	dbret = table->berkeleydb->associate(table->berkeleydb, NULL,
+			table->src_berkeleydb, get_package_source,
+			table->readonly?0:DB_CREATE);
+	if (dbret != 0) {
+		table_printerror(table, dbret, "associate");
+		(void)table->src_berkeleydb->close(table->src_berkeleydb, 0);
+		table->src_berkeleydb = NULL;
+		return RET_DBERR(dbret);
+	}
+	return RET_OK;
+}
+
 static retvalue database_translate_legacy_packages(void) {
 	struct cursor *databases_cursor, *cursor;
 	struct table *legacy_databases, *legacy_table, *packages;
@@ -2191,6 +2413,34 @@ static retvalue database_translate_legacy_packages(void) {
 	return result;
 }
 
+/* packages.db without packagenames.db is from before the secondary index */
+static bool database_legacypackages(void) {
+	char *packages_filename, *names_filename;
+	bool legacy;
+
+	packages_filename = dbfilename("packages.db");
+	names_filename = dbfilename("packagenames.db");
+	if (FAILEDTOALLOC(packages_filename) || FAILEDTOALLOC(names_filename)) {
+		free(packages_filename);
+		free(names_filename);
+		/* cannot be checked, so let opening it tell */
+		return false;
+	}
+	legacy = isregularfile(packages_filename) &&
+		!isregularfile(names_filename);
+	free(packages_filename);
+	free(names_filename);
+	return legacy;
+}
+
+/* translate a legacy packages database now, so that opening the packages
+ * of the targets later (possibly in parallel jobs) never has to do it */
+retvalue database_preparepackages(void) {
+	if (rdb_nopackages || !database_legacypackages())
+		return RET_NOTHING;
+	return database_translate_legacy_packages();
+}
+
 retvalue database_openpackages(const char *identifier, bool readonly, struct table **table_p) {
 	struct table *table;
 	retvalue r;
@@ -2209,7 +2459,9 @@ retvalue database_openpackages(const char *identifier, bool readonly, struct tab
 	if (RET_WAS_ERROR(r))
 		return r;
 
-	if ((table->berkeleydb != NULL && table->sec_berkeleydb == NULL) || (table->berkeleydb == NULL && table->sec_berkeleydb == NULL)) {
+	/* (when reading, a missing table is just empty, unless the
+	 * whole database is still in the legacy format) */
+	if ((table->berkeleydb != NULL && table->sec_berkeleydb == NULL) || (table->berkeleydb == NULL && table->sec_berkeleydb == NULL && database_legacypackages())) {
 		r = table_close(table);
 		if (RET_WAS_ERROR(r)) {
 			return r;
@@ -2229,6 +2481,15 @@ retvalue database_openpackages(const char *identifier, bool readonly, struct tab
 		}
 	}
 
+	/* when reading, the index is only opened once it is needed */
+	if (table->berkeleydb != NULL && !readonly) {
+		r = table_opensourceindex(table);
+		if (RET_WAS_ERROR(r)) {
+			(void)table_close(table);
+			return r;
+		}
+	}
+
 	*table_p = table;
 	return RET_OK;
 }
@@ -2245,6 +2506,8 @@ retvalue database_droppackages(const char *identifier) {
 	r = database_dropsubtable("packages.db", identifier);
 	if (RET_IS_OK(r))
 		r = database_dropsubtable("packagenames.db", identifier);
+	if (RET_IS_OK(r))
+		(void)database_dropsubtable("packagesources.db", identifier);
 	return r;
 }
 
@@ -2255,6 +2518,7 @@ retvalue database_openfiles(void) {
 
 	assert (rdb_checksums == NULL);
 	assert (rdb_contents == NULL);
+	assert (rdb_pendingfilelists == NULL);
 
 	r = database_listsubtables("contents.cache.db", &identifiers);
 	if (RET_IS_OK(r)) {
@@ -2301,6 +2565,18 @@ retvalue database_openfiles(void) {
 		(void)table_close(rdb_checksums);
 		rdb_checksums = NULL;
 		rdb_contents = NULL;
+		return r;
+	}
+	/* files whose file lists are still to be read */
+	r = database_table("contents.cache.db", "pendingfilelists",
+			dbt_BTREE, DB_CREATE, &rdb_pendingfilelists);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r)) {
+		(void)table_close(rdb_contents);
+		(void)table_close(rdb_checksums);
+		rdb_checksums = NULL;
+		rdb_contents = NULL;
+		rdb_pendingfilelists = NULL;
 	}
 	return r;
 }
@@ -2360,6 +2636,26 @@ retvalue database_openreleasecache(const char *codename, struct table **cachedb_
 	return r;
 }
 
+/* the results of signature checks, RET_NOTHING if there is no database */
+retvalue database_opensignaturecache(struct table **cachedb_p) {
+	retvalue r;
+
+	if (!rdb_initialized)
+		return RET_NOTHING;
+	if (rdb_signaturecache == NULL) {
+		r = database_table("signatures.cache.db", "verified",
+				dbt_BTREE, DB_CREATE, &rdb_signaturecache);
+		assert (r != RET_NOTHING);
+		if (RET_WAS_ERROR(r)) {
+			rdb_signaturecache = NULL;
+			return r;
+		}
+		rdb_signaturecache->verbose = false;
+	}
+	*cachedb_p = rdb_signaturecache;
+	return RET_OK;
+}
+
 static retvalue table_copy(struct table *oldtable, struct table *newtable) {
 	retvalue r;
 	struct cursor *cursor;
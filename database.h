@@ -22,8 +22,10 @@ retvalue database_openfiles(void);
 retvalue database_openreferences(void);
 retvalue database_listpackages(/*@out@*/struct strlist *);
 retvalue database_droppackages(const char *);
+retvalue database_preparepackages(void);
 retvalue database_openpackages(const char *, bool /*readonly*/, /*@out@*/struct table **);
 retvalue database_openreleasecache(const char *, /*@out@*/struct table **);
+retvalue database_opensignaturecache(/*@out@*/struct table **);
 retvalue database_opentracking(const char *, bool /*readonly*/, /*@out@*/struct table **);
 retvalue database_translate_filelists(void);
 retvalue database_translate_legacy_checksums(bool /*verbosedb*/);
@@ -57,4 +59,9 @@ retvalue cursor_replace(struct table *, struct cursor *, const char *, size_t);
 retvalue cursor_delete(struct table *, struct cursor *, const char *, /*@null@*/const char *);
 retvalue cursor_close(struct table *, /*@only@*/struct cursor *);
 
+/* packages.db can have an index by source name: */
+bool table_hassourceindex(const struct table *);
+retvalue table_newsourcecursor(struct table *, const char *, /*@out@*/struct cursor **);
+bool cursor_nextsourcedata(struct table *, struct cursor *, /*@out@*/const char **, /*@out@*/const char **, /*@out@*/size_t *);
+
 #endif
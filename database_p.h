@@ -6,9 +6,11 @@
 #endif
 
 extern /*@null@*/ struct table *rdb_checksums, *rdb_contents;
+extern /*@null@*/ struct table *rdb_pendingfilelists;
 extern /*@null@*/ struct table *rdb_references;
 
 retvalue database_listsubtables(const char *, /*@out@*/struct strlist *);
 retvalue database_dropsubtable(const char *, const char *);
+void database_requireversion(const char *);
 
 #endif
@@ -171,6 +171,27 @@ static retvalue read_control_tar(char **control, const char *debfile, struct ar_
 	return RET_ERROR_MISSING;
 }
 
+retvalue debfile_controlmember(char **control, const char *debfile, struct ar_archive *ar, const char *membername) {
+	enum compression c;
+	struct archive *tar;
+	retvalue r;
+
+	if (strncmp(membername, "control.tar", 11) != 0)
+		return RET_NOTHING;
+	for (c = 0 ; c < c_COUNT ; c++) {
+		if (strcmp(membername + 11, uncompression_suffix[c]) == 0)
+			break;
+	}
+	if (c >= c_COUNT || !uncompression_supported(c))
+		return RET_NOTHING;
+	ar_archivemember_setcompression(ar, c);
+	tar = archive_read_new();
+	r = read_control_tar(control, debfile, ar, tar);
+	// TODO run archive_read_close to get error messages?
+	archive_read_free(tar);
+	return r;
+}
+
 retvalue extractcontrol(char **control, const char *debfile) {
 	struct ar_archive *ar;
 	retvalue r;
@@ -182,40 +203,19 @@ retvalue extractcontrol(char **control, const char *debfile) {
 	assert (r != RET_NOTHING);
 	do {
 		char *filename;
-		enum compression c;
 
 		r = ar_nextmember(ar, &filename);
 		if (RET_IS_OK(r)) {
-			if (strncmp(filename, "control.tar", 11) != 0) {
-				free(filename);
-				continue;
-			}
-			hadcandidate = true;
-			for (c = 0 ; c < c_COUNT ; c++) {
-				if (strcmp(filename + 11,
-						uncompression_suffix[c]) == 0)
-					break;
-			}
-			if (c >= c_COUNT) {
-				free(filename);
-				continue;
-			}
-			ar_archivemember_setcompression(ar, c);
-			if (uncompression_supported(c)) {
-				struct archive *tar;
-
-				tar = archive_read_new();
-				r = read_control_tar(control, debfile, ar, tar);
-				// TODO run archive_read_close to get error messages?
-				archive_read_free(tar);
-				if (r != RET_NOTHING) {
-					ar_close(ar);
-					free(filename);
-					return r;
-				}
-
-			}
+			if (strncmp(filename, "control.tar", 11) == 0)
+				hadcandidate = true;
+			r = debfile_controlmember(control, debfile,
+					ar, filename);
 			free(filename);
+			if (r != RET_NOTHING) {
+				ar_close(ar);
+				return r;
+			}
+			r = RET_OK;
 		}
 	} while (RET_IS_OK(r));
 	ar_close(ar);
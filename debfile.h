@@ -12,4 +12,17 @@ retvalue extractcontrol(/*@out@*/char **, const char *);
 /* Read a list of files from a .deb file */
 retvalue getfilelist(/*@out@*/char **, /*@out@*/ size_t *, const char *);
 
+/* Read a .deb file only once to calculate its checksums, extract the
+ * control information and (if filelist_p is not NULL) get the list
+ * of files in it.
+ * *filelist_p is NULL if the list could not be read that way. */
+struct checksums;
+retvalue debfile_read(const char *, /*@out@*/struct checksums **, /*@out@*/char ** /*control_p*/, /*@null@*//*@out@*/char ** /*filelist_p*/, /*@null@*//*@out@*/size_t *);
+
+/* for the above, handle a single member of an ar file,
+ * RET_NOTHING if it is not the one looked for or not supported */
+struct ar_archive;
+retvalue debfile_controlmember(/*@out@*/char **, const char *, struct ar_archive *, const char * /*membername*/);
+retvalue debfile_datamember(/*@out@*/char **, /*@out@*/size_t *, const char *, struct ar_archive *, const char * /*membername*/);
+
 #endif
@@ -25,9 +25,11 @@
 #include <ctype.h>
 #include <archive.h>
 #include <archive_entry.h>
+#define CHECKSUMS_CONTEXT visible
 #include "error.h"
 #include "uncompression.h"
 #include "ar.h"
+#include "checksums.h"
 #include "filelist.h"
 #include "debfile.h"
 
@@ -50,9 +52,12 @@ static retvalue read_data_tar(/*@out@*/char **list, /*@out@*/size_t *size, const
 
 	archive_read_support_format_tar(tar);
 	archive_read_support_format_gnutar(tar);
-	a = archive_read_open(tar, ar,
+	/* with the skip callback, the contents of the files in an
+	 * uncompressed data.tar are not read, only the headers */
+	a = archive_read_open2(tar, ar,
 			ar_archivemember_open,
 			ar_archivemember_read,
+			ar_archivemember_skip,
 			ar_archivemember_close);
 	if (a != ARCHIVE_OK) {
 		filelistcompressor_cancel(&c);
@@ -134,6 +139,45 @@ static retvalue read_data_tar(/*@out@*/char **list, /*@out@*/size_t *size, const
 }
 
 
+retvalue debfile_datamember(char **filelist, size_t *size, const char *debfile, struct ar_archive *ar, const char *membername) {
+	enum compression c;
+	struct archive *tar;
+	retvalue r;
+	int a;
+
+	if (strncmp(membername, "data.tar", 8) != 0)
+		return RET_NOTHING;
+	for (c = 0 ; c < c_COUNT ; c++) {
+		if (strcmp(membername + 8, uncompression_suffix[c]) == 0)
+			break;
+	}
+	if (c >= c_COUNT || !uncompression_supported(c))
+		return RET_NOTHING;
+	ar_archivemember_setcompression(ar, c);
+	tar = archive_read_new();
+	r = read_data_tar(filelist, size, debfile, ar, tar);
+	a = archive_read_close(tar);
+	if (a != ARCHIVE_OK && !RET_WAS_ERROR(r)) {
+		int e = archive_errno(tar);
+		if (e == -EINVAL)
+			fprintf(stderr,
+"reading data.tar within '%s' failed: %s\n",
+				debfile, archive_error_string(tar));
+		else
+			fprintf(stderr,
+"reading data.tar within '%s' failed: %d:%d:%s\n", debfile, a, e,
+				archive_error_string(tar));
+		free(*filelist);
+		r = RET_ERROR;
+	}
+	a = archive_read_free(tar);
+	if (a != ARCHIVE_OK && !RET_WAS_ERROR(r)) {
+		free(*filelist);
+		r = RET_ERROR;
+	}
+	return r;
+}
+
 retvalue getfilelist(/*@out@*/char **filelist, size_t *size, const char *debfile) {
 	struct ar_archive *ar;
 	retvalue r;
@@ -145,60 +189,19 @@ retvalue getfilelist(/*@out@*/char **filelist, size_t *size, const char *debfile
 	assert (r != RET_NOTHING);
 	do {
 		char *filename;
-		enum compression c;
 
 		r = ar_nextmember(ar, &filename);
 		if (RET_IS_OK(r)) {
-			if (strncmp(filename, "data.tar", 8) != 0) {
-				free(filename);
-				continue;
-			}
-			hadcandidate = true;
-			for (c = 0 ; c < c_COUNT ; c++) {
-				if (strcmp(filename + 8,
-						uncompression_suffix[c]) == 0)
-					break;
-			}
-			if (c >= c_COUNT) {
-				free(filename);
-				continue;
-			}
-			ar_archivemember_setcompression(ar, c);
-			if (uncompression_supported(c)) {
-				struct archive *tar;
-				int a;
-
-				tar = archive_read_new();
-				r = read_data_tar(filelist, size,
-						debfile, ar, tar);
-				a = archive_read_close(tar);
-				if (a != ARCHIVE_OK && !RET_WAS_ERROR(r)) {
-					int e = archive_errno(tar);
-					if (e == -EINVAL)
-						fprintf(stderr,
-"reading data.tar within '%s' failed: %s\n",
-							debfile,
-							archive_error_string(
-								tar));
-					else
-						fprintf(stderr,
-"reading data.tar within '%s' failed: %d:%d:%s\n", debfile, a, e,
-							archive_error_string(
-								tar));
-					r = RET_ERROR;
-				}
-				a = archive_read_free(tar);
-				if (a != ARCHIVE_OK && !RET_WAS_ERROR(r)) {
-					r = RET_ERROR;
-				}
-				if (r != RET_NOTHING) {
-					ar_close(ar);
-					free(filename);
-					return r;
-				}
-
-			}
+			if (strncmp(filename, "data.tar", 8) == 0)
+				hadcandidate = true;
+			r = debfile_datamember(filelist, size, debfile,
+					ar, filename);
 			free(filename);
+			if (r != RET_NOTHING) {
+				ar_close(ar);
+				return r;
+			}
+			r = RET_OK;
 		}
 	} while (RET_IS_OK(r));
 	ar_close(ar);
@@ -210,3 +213,56 @@ retvalue getfilelist(/*@out@*/char **filelist, size_t *size, const char *debfile
 "Could not find a data.tar file within '%s'!\n", debfile);
 	return RET_ERROR_MISSING;
 }
+
+/* everything read from the .deb file goes through this: */
+static void debfile_observe(void *p, const void *data, size_t len) {
+	struct checksumscontext *context = p;
+
+	checksumscontext_update(context, data, len);
+}
+
+retvalue debfile_read(const char *debfile, struct checksums **checksums_p, char **control_p, char **filelist_p, size_t *filelistsize_p) {
+	struct checksumscontext context;
+	struct ar_archive *ar;
+	char *filename, *control = NULL, *filelist = NULL;
+	size_t filelistsize = 0;
+	retvalue r;
+
+	checksumscontext_init(&context);
+	r = ar_openobserved(&ar, debfile, debfile_observe, &context);
+	if (RET_IS_OK(r)) {
+		while (RET_IS_OK(r = ar_nextmember(ar, &filename))) {
+			r = RET_NOTHING;
+			if (control == NULL)
+				r = debfile_controlmember(&control, debfile,
+						ar, filename);
+			if (r == RET_NOTHING && filelist_p != NULL &&
+					filelist == NULL)
+				r = debfile_datamember(&filelist,
+						&filelistsize, debfile,
+						ar, filename);
+			free(filename);
+			if (RET_WAS_ERROR(r))
+				break;
+		}
+		ar_close(ar);
+	}
+	if (!RET_WAS_ERROR(r) && control == NULL) {
+		fprintf(stderr,
+"Could not find a suitable control.tar file within '%s'!\n", debfile);
+		r = RET_ERROR_MISSING;
+	}
+	if (!RET_WAS_ERROR(r))
+		r = checksums_from_context(checksums_p, &context);
+	if (RET_WAS_ERROR(r)) {
+		free(control);
+		free(filelist);
+		return r;
+	}
+	*control_p = control;
+	if (filelist_p != NULL) {
+		*filelist_p = filelist;
+		*filelistsize_p = filelistsize;
+	}
+	return RET_OK;
+}
@@ -38,6 +38,7 @@ void diffindex_free(struct diffindex *diffindex) {
 		checksums_free(diffindex->patches[i].frompackages);
 		free(diffindex->patches[i].name);
 		checksums_free(diffindex->patches[i].checksums);
+		checksums_free(diffindex->patches[i].download);
 	}
 	free(diffindex);
 }
@@ -158,11 +159,47 @@ static inline retvalue add_history(const char *diffindexfile, struct diffindex *
 	return RET_OK;
 }
 
+/* only needed to download by-hash, so ignore anything unexpected */
+static inline retvalue add_downloads(const char *diffindexfile, struct diffindex *n, const struct strlist *downloads) {
+	int i, j;
+
+	for (i = 0 ; i < downloads->count ; i++) {
+		struct hashes hashes;
+		const char *name;
+		size_t l;
+		retvalue r;
+
+		setzero(struct hashes, &hashes);
+		r = hashline_parse(diffindexfile, downloads->values[i],
+				cs_sha256sum, &name,
+				&hashes.hashes[cs_sha256sum],
+				&hashes.hashes[cs_length]);
+		if (RET_WAS_ERROR(r))
+			continue;
+		l = strlen(name);
+		if (l <= 3 || strcmp(name + l - 3, ".gz") != 0)
+			continue;
+		for (j = 0 ; j < n->patchcount ; j++) {
+			if (strncmp(n->patches[j].name, name, l - 3) == 0
+					&& n->patches[j].name[l - 3] == '\0')
+				break;
+		}
+		if (j >= n->patchcount || n->patches[j].download != NULL)
+			continue;
+		r = checksums_initialize(&n->patches[j].download,
+				hashes.hashes);
+		if (r == RET_ERROR_OOM)
+			return r;
+	}
+	return RET_OK;
+}
+
 retvalue diffindex_read(const char *diffindexfile, struct diffindex **out_p) {
 	retvalue r;
-	char *chunk, *current;
-	struct strlist history, patches;
+	char *chunk, *current, *precedence;
+	struct strlist history, patches, downloads;
 	struct diffindex *n;
+	bool merged;
 
 	r = readtextfile(diffindexfile, diffindexfile, &chunk, NULL);
 	ASSERT_NOT_NOTHING(r);
@@ -189,6 +226,26 @@ retvalue diffindex_read(const char *diffindexfile, struct diffindex **out_p) {
 		strlist_done(&history);
 		return r;
 	}
+	r = chunk_getextralinelist(chunk, "SHA256-Download", &downloads);
+	if (RET_WAS_ERROR(r)) {
+		free(chunk);
+		strlist_done(&history);
+		strlist_done(&patches);
+		return r;
+	}
+	if (r == RET_NOTHING)
+		strlist_init(&downloads);
+	r = chunk_getvalue(chunk, "X-Patch-Precedence", &precedence);
+	if (RET_WAS_ERROR(r)) {
+		free(chunk);
+		strlist_done(&history);
+		strlist_done(&patches);
+		strlist_done(&downloads);
+		return r;
+	}
+	merged = RET_IS_OK(r) && strcmp(precedence, "merged") == 0;
+	if (RET_IS_OK(r))
+		free(precedence);
 	r = chunk_getvalue(chunk, "SHA1-Current", &current);
 	free(chunk);
 	if (r == RET_NOTHING) {
@@ -199,6 +256,7 @@ retvalue diffindex_read(const char *diffindexfile, struct diffindex **out_p) {
 	if (RET_WAS_ERROR(r)) {
 		strlist_done(&history);
 		strlist_done(&patches);
+		strlist_done(&downloads);
 		return r;
 	}
 	n = calloc(1, sizeof(struct diffindex) +
@@ -206,18 +264,23 @@ retvalue diffindex_read(const char *diffindexfile, struct diffindex **out_p) {
 	if (FAILEDTOALLOC(n)) {
 		strlist_done(&history);
 		strlist_done(&patches);
+		strlist_done(&downloads);
 		free(current);
 		return r;
 	}
 	n->patchcount = patches.count;
+	n->merged = merged;
 	r = add_current(diffindexfile, n, current);
 	if (RET_IS_OK(r))
 		r = add_patches(diffindexfile, n, &patches);
 	if (RET_IS_OK(r))
 		r = add_history(diffindexfile, n, &history);
+	if (RET_IS_OK(r))
+		r = add_downloads(diffindexfile, n, &downloads);
 	ASSERT_NOT_NOTHING(r);
 	strlist_done(&history);
 	strlist_done(&patches);
+	strlist_done(&downloads);
 	free(current);
 	if (RET_IS_OK(r))
 		*out_p = n;
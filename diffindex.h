@@ -3,13 +3,16 @@
 
 struct diffindex {
 	struct checksums *destination;
+	/* X-Patch-Precedence: merged, i.e. every patch results in
+	 * destination (instead of the version of the next patch) */
+	bool merged;
 	int patchcount;
 	struct diffindex_patch {
 		struct checksums *frompackages;
 		char *name;
 		struct checksums *checksums;
-		/* safe-guard against cycles */
-		bool done;
+		/* SHA256 of the .gz file, if listed (to get it by-hash) */
+		struct checksums *download;
 	} patches[];
 };
 
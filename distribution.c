@@ -40,6 +40,7 @@
 #include "configparser.h"
 #include "byhandhook.h"
 #include "package.h"
+#include "jobs.h"
 #include "distribution.h"
 
 static retvalue distribution_free(struct distribution *distribution) {
@@ -64,6 +65,9 @@ static retvalue distribution_free(struct distribution *distribution) {
 		atomlist_done(&distribution->udebcomponents);
 		atomlist_done(&distribution->architectures);
 		atomlist_done(&distribution->components);
+		atomset_done(&distribution->udebcomponentset);
+		atomset_done(&distribution->architectureset);
+		atomset_done(&distribution->componentset);
 		strlist_done(&distribution->signwith);
 		strlist_done(&distribution->updates);
 		strlist_done(&distribution->pulls);
@@ -247,6 +251,7 @@ CFstartparse(distribution) {
 		return RET_ERROR_OOM;
 	/* set some default value: */
 	n->limit = 1;
+	n->byhashkeep = 24*60*60;
 	r = exportmode_init(&n->udeb, true, NULL, "Packages");
 	if (RET_WAS_ERROR(r)) {
 		(void)distribution_free(n);
@@ -414,6 +419,17 @@ CFfinishparse(distribution) {
 		return r;
 	}
 
+	r = atomset_fromlist(&n->architectureset, &n->architectures);
+	if (!RET_WAS_ERROR(r))
+		r = atomset_fromlist(&n->componentset, &n->components);
+	if (!RET_WAS_ERROR(r))
+		r = atomset_fromlist(&n->udebcomponentset,
+				&n->udebcomponents);
+	if (RET_WAS_ERROR(r)) {
+		(void)distribution_free(n);
+		return r;
+	}
+
 	/* prepare substructures */
 
 	r = createtargets(n);
@@ -466,6 +482,8 @@ CFexportmodeSETPROC(distribution, dsc)
 CFcheckvalueSETPROC(distribution, codename, checkforcodename)
 CFcheckvalueSETPROC(distribution, fakecomponentprefix, checkfordirectoryandidentifier)
 CFtimespanSETPROC(distribution, validfor)
+CFtruthSETPROC2(distribution, byhash, byhash)
+CFtimespanSETPROC(distribution, byhashkeep)
 
 CFuSETPROC(distribution, archive) {
 	CFSETPROCVARS(distribution, data, mydata);
@@ -530,6 +548,8 @@ static const struct configfield distributionconfigfields[] = {
 	CFr("Architectures",	distribution,	architectures),
 	CF("Archive",		distribution,   archive),
 	CF("ByHandHooks",	distribution,	byhandhooks),
+	CF("ByHash",		distribution,	byhash),
+	CF("ByHashKeep",	distribution,	byhashkeep),
 	CFr("Codename",		distribution,	codename),
 	CFr("Components",	distribution,	components),
 	CF("ContentsArchitectures", distribution, contents_architectures),
@@ -612,7 +632,7 @@ retvalue distribution_readall(struct distribution **distributions) {
 }
 
 /* call <action> for each package */
-retvalue package_foreach(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, action_each_package action, action_each_target target_action, void *data) {
+static retvalue foreach_package(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, /*@null@*/const char *source, action_each_package action, action_each_target target_action, void *data) {
 	retvalue result, r;
 	struct target *t;
 	struct package_cursor iterator;
@@ -628,7 +648,11 @@ retvalue package_foreach(struct distribution *distribution, const struct atomlis
 			if (r == RET_NOTHING)
 				continue;
 		}
-		r = package_openiterator(t, READONLY, true, &iterator);
+		if (source != NULL)
+			r = package_opensourceiterator(t, source, READONLY,
+					&iterator);
+		else
+			r = package_openiterator(t, READONLY, true, &iterator);
 		RET_UPDATE(result, r);
 		if (RET_WAS_ERROR(r))
 			return result;
@@ -646,6 +670,16 @@ retvalue package_foreach(struct distribution *distribution, const struct atomlis
 	return result;
 }
 
+retvalue package_foreach(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, action_each_package action, action_each_target target_action, void *data) {
+	return foreach_package(distribution, components, architectures,
+			packagetypes, NULL, action, target_action, data);
+}
+
+retvalue package_foreach_source(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, const char *source, action_each_package action, action_each_target target_action, void *data) {
+	return foreach_package(distribution, components, architectures,
+			packagetypes, source, action, target_action, data);
+}
+
 retvalue package_foreach_c(struct distribution *distribution, const struct atomlist *components, architecture_t architecture, packagetype_t packagetype, action_each_package action, void *data) {
 	retvalue result, r;
 	struct target *t;
@@ -880,7 +914,31 @@ retvalue distribution_snapshot(struct distribution *distribution, const char *na
 	return result;
 }
 
-static retvalue export(struct distribution *distribution, bool onlyneeded) {
+static void export_failed(const struct distribution *distribution) {
+	struct target *target;
+	bool workleft = false;
+
+	fprintf(stderr, "ERROR: Could not finish exporting '%s'!\n",
+			distribution->codename);
+	for (target=distribution->targets; target != NULL ;
+	                                   target = target->next) {
+		workleft |= target->saved_wasmodified;
+	}
+	if (workleft) {
+		(void)fputs(
+"This means that from outside your repository will still look like before (and\n"
+"should still work if this old state worked), but the changes intended with this\n"
+"call will not be visible until you call export directly (via reprepro export)\n"
+"Changes will also get visible when something else changes the same file and\n"
+"thus creates a new export of that file, but even changes to other parts of the\n"
+"same distribution will not!\n",
+				stderr);
+	}
+}
+
+/* generate all files of a distribution, but do not sign the Release file
+ * or move anything into place yet (that is done by export_finish) */
+static retvalue export_prepare(struct distribution *distribution, bool onlyneeded, /*@out@*/struct release **release_p) {
 	struct target *target;
 	retvalue result, r;
 	struct release *release;
@@ -936,35 +994,109 @@ static retvalue export(struct distribution *distribution, bool onlyneeded) {
 		}
 	}
 	if (RET_WAS_ERROR(result)) {
-		bool workleft = false;
 		release_free(release);
-		fprintf(stderr, "ERROR: Could not finish exporting '%s'!\n",
-				distribution->codename);
-		for (target=distribution->targets; target != NULL ;
-		                                   target = target->next) {
-			workleft |= target->saved_wasmodified;
-		}
-		if (workleft) {
-			(void)fputs(
-"This means that from outside your repository will still look like before (and\n"
-"should still work if this old state worked), but the changes intended with this\n"
-"call will not be visible until you call export directly (via reprepro export)\n"
-"Changes will also get visible when something else changes the same file and\n"
-"thus creates a new export of that file, but even changes to other parts of the\n"
-"same distribution will not!\n",
-					stderr);
-		}
-	} else {
-		r = release_finish(release, distribution);
-		RET_UPDATE(result, r);
+		export_failed(distribution);
+		return result;
 	}
-	if (RET_IS_OK(result))
+	*release_p = release;
+	return RET_OK;
+}
+
+static retvalue export_finish(struct distribution *distribution, /*@only@*/struct release *release) {
+	retvalue r;
+
+	r = release_sign(release);
+	if (RET_WAS_ERROR(r)) {
+		release_free(release);
+		export_failed(distribution);
+		return r;
+	}
+	r = release_finish(release, distribution);
+	if (RET_IS_OK(r))
 		distribution->status = RET_NOTHING;
+	return r;
+}
+
+/* Exporting multiple distributions, the Release files are all signed
+ * at the same time (as signing can take some time, especially with a
+ * signing hook asking some other host) and only afterwards all the new
+ * files are moved into place, one distribution after the other. */
+struct exportjob {
+	struct distribution *distribution;
+	/*@null@*/struct release *release;
+	retvalue result;
+};
+
+static retvalue sign_job(void *privdata, size_t i) {
+	struct exportjob *job = (struct exportjob *)privdata + i;
+
+	if (job->release == NULL)
+		return RET_NOTHING;
+	/* the result is remembered and used by export_finish */
+	(void)release_sign(job->release);
+	return RET_OK;
+}
+
+static retvalue export_many(struct exportjob *jobs, size_t count, bool onlyneeded, bool stoponerror) {
+	retvalue result;
+	size_t i;
+
+	for (i = 0 ; i < count ; i++) {
+		jobs[i].release = NULL;
+		jobs[i].result = RET_NOTHING;
+	}
+	for (i = 0 ; i < count ; i++) {
+		/* only a full export is announced for every distribution */
+		if (verbose > 0 && !onlyneeded)
+			printf("Exporting %s...\n",
+					jobs[i].distribution->codename);
+		jobs[i].result = export_prepare(jobs[i].distribution,
+				onlyneeded, &jobs[i].release);
+		if (RET_WAS_ERROR(jobs[i].result) && stoponerror)
+			break;
+	}
+	/* what is not signed here (when interrupted) is signed
+	 * by export_finish */
+	(void)jobs_run(count, sign_job, jobs);
+
+	result = RET_NOTHING;
+	for (i = 0 ; i < count ; i++) {
+		if (jobs[i].release != NULL) {
+			jobs[i].result = export_finish(jobs[i].distribution,
+					jobs[i].release);
+			jobs[i].release = NULL;
+		}
+		RET_UPDATE(result, jobs[i].result);
+	}
 	return result;
 }
 
-retvalue distribution_fullexport(struct distribution *distribution) {
-	return export(distribution, false);
+retvalue distribution_fullexport(struct distribution *distributions, bool force) {
+	struct exportjob *jobs;
+	struct distribution *d;
+	size_t count;
+	retvalue result;
+
+	count = 0;
+	for (d = distributions ; d != NULL ; d = d->next)
+		count++;
+	jobs = nzNEW(count, struct exportjob);
+	if (FAILEDTOALLOC(jobs))
+		return RET_ERROR_OOM;
+	count = 0;
+	for (d = distributions ; d != NULL ; d = d->next) {
+		if (!d->selected || d->exportoptions[deo_noexport])
+			continue;
+		jobs[count++].distribution = d;
+	}
+	result = export_many(jobs, count, false, !force);
+	while (count-- > 0) {
+		if (RET_IS_OK(jobs[count].result))
+			/* avoid being exported again */
+			jobs[count].distribution->lookedat = false;
+	}
+	free(jobs);
+	return result;
 }
 
 retvalue distribution_freelist(struct distribution *distributions) {
@@ -981,9 +1113,11 @@ retvalue distribution_freelist(struct distribution *distributions) {
 }
 
 retvalue distribution_exportlist(enum exportwhen when, struct distribution *distributions) {
-	retvalue result, r;
+	retvalue result;
 	bool todo = false;
 	struct distribution *d;
+	struct exportjob *jobs;
+	size_t count;
 
 	if (verbose >= 15)
 		fprintf(stderr, "trace: distribution_exportlist() called.\n");
@@ -1003,7 +1137,9 @@ retvalue distribution_exportlist(enum exportwhen when, struct distribution *dist
 		return RET_NOTHING;
 	}
 
+	count = 0;
 	for (d=distributions; d != NULL; d = d->next) {
+		count++;
 		if (d->omitted || !d->selected || d->exportoptions[deo_noexport])
 			continue;
 		if (d->lookedat && (RET_IS_OK(d->status) ||
@@ -1016,7 +1152,10 @@ retvalue distribution_exportlist(enum exportwhen when, struct distribution *dist
 	if (verbose >= 0 && todo)
 		printf("Exporting indices...\n");
 
-	result = RET_NOTHING;
+	jobs = nzNEW(count, struct exportjob);
+	if (FAILEDTOALLOC(jobs))
+		return RET_ERROR_OOM;
+	count = 0;
 	for (d=distributions; d != NULL; d = d->next) {
 		if (verbose >= 20)
 			fprintf(stderr, " looking at distribution {codename: %s, exportoptions[deo_noexport]: %s, omitted: %s, selected: %s, status: %d}.\n",
@@ -1057,8 +1196,7 @@ retvalue distribution_exportlist(enum exportwhen when, struct distribution *dist
 "Please report this and how you got this message as bugreport. Thanks.\n"
 "Doing a export despite --export=changed....\n",
 						d->codename);
-					r = export(d, true);
-					RET_UPDATE(result, r);
+					jobs[count++].distribution = d;
 					break;
 				}
 			}
@@ -1067,10 +1205,11 @@ retvalue distribution_exportlist(enum exportwhen when, struct distribution *dist
 					(d->status == RET_NOTHING &&
 					  when != EXPORT_CHANGED) ||
 					when == EXPORT_FORCE);
-			r = export(d, true);
-			RET_UPDATE(result, r);
+			jobs[count++].distribution = d;
 		}
 	}
+	result = export_many(jobs, count, true, false);
+	free(jobs);
 	return result;
 }
 
@@ -1192,7 +1331,7 @@ retvalue distribution_prepareforwriting(struct distribution *distribution) {
 }
 
 /* delete every package decider returns RET_OK for */
-retvalue package_remove_each(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, action_each_package decider, struct trackingdata *trackingdata, void *data) {
+static retvalue remove_each_package(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, /*@null@*/const char *source, action_each_package decider, struct trackingdata *trackingdata, void *data) {
 	retvalue result, r;
 	struct target *t;
 	struct package_cursor iterator;
@@ -1208,7 +1347,11 @@ retvalue package_remove_each(struct distribution *distribution, const struct ato
 	for (t = distribution->targets ; t != NULL ; t = t->next) {
 		if (!target_matches(t, components, architectures, packagetypes))
 			continue;
-		r = package_openiterator(t, READWRITE, true, &iterator);
+		if (source != NULL)
+			r = package_opensourceiterator(t, source, READWRITE,
+					&iterator);
+		else
+			r = package_openiterator(t, READWRITE, true, &iterator);
 		RET_UPDATE(result, r);
 		if (RET_WAS_ERROR(r))
 			return result;
@@ -1231,3 +1374,13 @@ retvalue package_remove_each(struct distribution *distribution, const struct ato
 	}
 	return result;
 }
+
+retvalue package_remove_each(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, action_each_package decider, struct trackingdata *trackingdata, void *data) {
+	return remove_each_package(distribution, components, architectures,
+			packagetypes, NULL, decider, trackingdata, data);
+}
+
+retvalue package_remove_each_source(struct distribution *distribution, const struct atomlist *components, const struct atomlist *architectures, const struct atomlist *packagetypes, const char *source, action_each_package decider, struct trackingdata *trackingdata, void *data) {
+	return remove_each_package(distribution, components, architectures,
+			packagetypes, source, decider, trackingdata, data);
+}
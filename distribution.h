@@ -68,6 +68,8 @@ struct distribution {
 	struct atomlist udebcomponents;
 	/* the list of components containing a debug directory */
 	struct atomlist ddebcomponents;
+	/* the same as sets, for quick checks while planning */
+	struct atomset architectureset, componentset, udebcomponentset;
 	/* what kind of index files to generate */
 	struct exportmode dsc, deb, udeb, ddeb;
 	bool exportoptions[deo_COUNT];
@@ -110,6 +112,10 @@ struct distribution {
 	struct strlist alsoaccept;
 	/* if != 0, number of seconds to add for Vaild-Until */
 	unsigned long validfor;
+	/* also publish index files as by-hash/SHA256/<hash>, keeping
+	 * those no longer used for byhashkeep seconds */
+	bool byhash;
+	unsigned long byhashkeep;
 	/* RET_NOTHING: do not export with EXPORT_CHANGED, EXPORT_NEVER
 	 * RET_OK: export unless EXPORT_NEVER
 	 * RET_ERROR_*: only export with EXPORT_FORCE */
@@ -136,7 +142,8 @@ retvalue distribution_prepareforwriting(struct distribution *);
 /* like distribtion_getpart, but returns NULL if there is no such target */
 /*@null@*//*@dependent@*/struct target *distribution_gettarget(const struct distribution *distribution, component_t, architecture_t, packagetype_t);
 
-retvalue distribution_fullexport(struct distribution *);
+/* export all selected distributions, stop at the first error unless force */
+retvalue distribution_fullexport(struct distribution *, bool /*force*/);
 
 
 retvalue distribution_snapshot(struct distribution *, const char */*name*/);
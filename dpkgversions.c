@@ -38,18 +38,20 @@
 
 /* from dpkg-db.h.in: */
 
+/* (changed to point into the original string instead of copying,
+ *  so comparing needs no memory allocations) */
 struct versionrevision {
   unsigned long epoch;
-  const char *version;
-  const char *revision;
+  const char *version, *versionend;
+  const char *revision, *revisionend;
 };
 
 /* from parsehelp.c */
 
 static
 const char *parseversion(struct versionrevision *rversion, const char *string) {
-  char *hyphen, *colon, *eepochcolon;
-  const char *end, *ptr;
+  char *colon, *eepochcolon;
+  const char *end, *ptr, *hyphen;
   unsigned long epoch;
 
   if (!*string) return _("version string is empty");
@@ -75,10 +77,17 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
   } else {
     rversion->epoch= 0;
   }
-  rversion->version= strndup(string, end - string);
-  hyphen= strrchr(rversion->version,'-');
-  if (hyphen) *hyphen++= 0;
-  rversion->revision= hyphen ? hyphen : "";
+  rversion->version= string;
+  for (hyphen= end; hyphen > string && hyphen[-1] != '-'; hyphen--)
+    ;
+  if (hyphen > string) {
+    rversion->versionend= hyphen - 1;
+    rversion->revision= hyphen;
+  } else {
+    rversion->versionend= end;
+    rversion->revision= end;
+  }
+  rversion->revisionend= end;
 
   return NULL;
 }
@@ -92,27 +101,28 @@ const char *parseversion(struct versionrevision *rversion, const char *string) {
 		: cisalpha((x)) ? (x) \
 		: (x) + 256)
 
-static int verrevcmp(const char *val, const char *ref) {
-  if (!val) val= "";
-  if (!ref) ref= "";
-
-  while (*val || *ref) {
+/* (changed to get the end of both strings, the end counts as '\0') */
+static int verrevcmp(const char *val, const char *valend, const char *ref, const char *refend) {
+  while (val < valend || ref < refend) {
     int first_diff= 0;
 
-    while ((*val && !cisdigit(*val)) || (*ref && !cisdigit(*ref))) {
-      int vc= order(*val), rc= order(*ref);
+    while ((val < valend && !cisdigit(*val)) ||
+           (ref < refend && !cisdigit(*ref))) {
+      int vc= val < valend ? order(*val) : 0;
+      int rc= ref < refend ? order(*ref) : 0;
       if (vc != rc) return vc - rc;
       val++; ref++;
     }
 
-    while (*val == '0') val++;
-    while (*ref == '0') ref++;
-    while (cisdigit(*val) && cisdigit(*ref)) {
+    while (val < valend && *val == '0') val++;
+    while (ref < refend && *ref == '0') ref++;
+    while (val < valend && cisdigit(*val) &&
+           ref < refend && cisdigit(*ref)) {
       if (!first_diff) first_diff= *val - *ref;
       val++; ref++;
     }
-    if (cisdigit(*val)) return 1;
-    if (cisdigit(*ref)) return -1;
+    if (val < valend && cisdigit(*val)) return 1;
+    if (ref < refend && cisdigit(*ref)) return -1;
     if (first_diff) return first_diff;
   }
   return 0;
@@ -125,8 +135,11 @@ int versioncompare(const struct versionrevision *version,
 
   if (version->epoch > refversion->epoch) return 1;
   if (version->epoch < refversion->epoch) return -1;
-  r= verrevcmp(version->version,refversion->version);  if (r) return r;
-  return verrevcmp(version->revision,refversion->revision);
+  r= verrevcmp(version->version, version->versionend,
+               refversion->version, refversion->versionend);
+  if (r) return r;
+  return verrevcmp(version->revision, version->revisionend,
+                   refversion->revision, refversion->revisionend);
 }
 
 /* now own code */
@@ -139,12 +152,16 @@ retvalue dpkgversions_cmp(const char *first,const char *second,int *result) {
 	   fprintf(stderr,"Error while parsing '%s' as version: %s\n",first,m);
 	   return RET_ERROR;
 	}
+	/* when updating most packages did not change, so comparing a
+	 * version with itself is the most common case by far: */
+	if (first == second || strcmp(first, second) == 0) {
+	   *result = 0;
+	   return RET_OK;
+	}
 	if ((m = parseversion(&v2,second)) != NULL) {
 	   fprintf(stderr,"Error while parsing '%s' as version: %s\n",second,m);
 	   return RET_ERROR;
 	}
 	*result = versioncompare(&v1,&v2);
-	free((char*)v1.version);
-	free((char*)v2.version);
 	return RET_OK;
 }
@@ -38,6 +38,7 @@
 #include "filecntl.h"
 #include "hooks.h"
 #include "package.h"
+#include "pdiff.h"
 
 static const char *exportdescription(const struct exportmode *mode, char *buffer, size_t buffersize) {
 	char *result = buffer;
@@ -70,6 +71,15 @@ static const char *exportdescription(const struct exportmode *mode, char *buffer
 			needcomma = true;
 		}
 	}
+	if (mode->pdiff) {
+		assert (buffersize > 9);
+		if (needcomma) {
+			*buffer++ = ','; buffersize--;
+		}
+		memcpy(buffer, "pdiffs", 6);
+		buffer += 6; buffersize -= 6;
+		needcomma = true;
+	}
 	/* should be long enough for the previous things in all cases */
 	assert (buffersize > 10);
 	if (mode->hooks.count > 0) {
@@ -126,6 +136,7 @@ static const char *exportdescription(const struct exportmode *mode, char *buffer
 
 retvalue exportmode_init(/*@out@*/struct exportmode *mode, bool uncompressed, /*@null@*/const char *release, const char *indexfile) {
 	strlist_init(&mode->hooks);
+	mode->pdiff = false;
 	mode->compressions = IC_FLAG(ic_gzip) | (uncompressed
 			? IC_FLAG(ic_uncompressed) : 0);
 	mode->filename = strdup(indexfile);
@@ -203,6 +214,7 @@ retvalue exportmode_set(struct exportmode *mode, struct configiterator *iter) {
 		return RET_ERROR;
 	}
 	mode->compressions = 0;
+	mode->pdiff = false;
 	while (r != RET_NOTHING && word[0] == '.') {
 		if (word[1] == '\0')
 			mode->compressions |= IC_FLAG(ic_uncompressed);
@@ -218,6 +230,8 @@ retvalue exportmode_set(struct exportmode *mode, struct configiterator *iter) {
 		else if (word[1] == 'x' && word[2] == 'z' &&word[3] == '\0')
 			mode->compressions |= IC_FLAG(ic_xz);
 #endif
+		else if (strcmp(word, ".diff") == 0)
+			mode->pdiff = true;
 		else {
 			fprintf(stderr,
 "Error parsing %s, line %u, column %u:\n"
@@ -458,9 +472,16 @@ static retvalue callexporthook(/*@null@*/const char *hook, const char *relfilena
 	}
 }
 
+static inline void writeindexdata(struct filetorelease *file, /*@null@*/struct pdiff *pdiff, const char *data, size_t len) {
+	(void)release_writedata(file, data, len);
+	if (pdiff != NULL)
+		(void)pdiff_writedata(pdiff, data, len);
+}
+
 retvalue export_target(const char *relativedir, struct target *target,  const struct exportmode *exportmode, struct release *release, bool onlyifmissing, bool snapshot) {
 	retvalue r;
 	struct filetorelease *file;
+	struct pdiff *pdiff = NULL;
 	const char *status;
 	char *relfilename;
 	char buffer[100];
@@ -490,8 +511,17 @@ retvalue export_target(const char *relativedir, struct target *target,  const st
 					exportdescription(exportmode, buffer, 100));
 			status = "new";
 		}
+		if (exportmode->pdiff && !snapshot) {
+			r = pdiff_start(release, relfilename, &pdiff);
+			if (RET_WAS_ERROR(r)) {
+				release_abortfile(file);
+				free(relfilename);
+				return r;
+			}
+		}
 		r = package_openiterator(target, READONLY, true, &iterator);
 		if (RET_WAS_ERROR(r)) {
+			pdiff_abort(pdiff);
 			release_abortfile(file);
 			free(relfilename);
 			return r;
@@ -499,29 +529,45 @@ retvalue export_target(const char *relativedir, struct target *target,  const st
 		while (package_next(&iterator)) {
 			if (iterator.current.controllen == 0)
 				continue;
-			(void)release_writedata(file, iterator.current.control,
+			writeindexdata(file, pdiff, iterator.current.control,
 					iterator.current.controllen);
-			(void)release_writestring(file, "\n");
+			writeindexdata(file, pdiff, "\n", 1);
 			if (iterator.current.control[iterator.current.controllen-1] != '\n')
-				(void)release_writestring(file, "\n");
+				writeindexdata(file, pdiff, "\n", 1);
 		}
 		r = package_closeiterator(&iterator);
 		if (RET_WAS_ERROR(r)) {
+			pdiff_abort(pdiff);
 			release_abortfile(file);
 			free(relfilename);
 			return r;
 		}
 		r = release_finishfile(release, file);
 		if (RET_WAS_ERROR(r)) {
+			pdiff_abort(pdiff);
 			free(relfilename);
 			return r;
 		}
+		if (pdiff != NULL) {
+			r = pdiff_finish(release, pdiff);
+			if (RET_WAS_ERROR(r)) {
+				free(relfilename);
+				return r;
+			}
+		}
 	} else {
 		if (verbose > 9)
 			printf("  keeping old '%s/%s'%s\n",
 				release_dirofdist(release), relfilename,
 				exportdescription(exportmode, buffer, 100));
 		status = "old";
+		if (exportmode->pdiff && !snapshot) {
+			r = pdiff_keep(release, relfilename);
+			if (RET_WAS_ERROR(r)) {
+				free(relfilename);
+				return r;
+			}
+		}
 	}
 	if (!snapshot) {
 		int i;
@@ -10,6 +10,8 @@ struct exportmode {
 	char *filename;
 	/* create uncompressed, create .gz, <future things...> */
 	compressionset compressions;
+	/* also maintain <filename>.diff/ with patches (pdiffs) */
+	bool pdiff;
 	/* Generate a Release file next to the Indexfile , if non-null*/
 	/*@null@*/
 	char *release;
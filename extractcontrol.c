@@ -20,6 +20,7 @@
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <getopt.h>
@@ -28,6 +29,7 @@
 #include "filecntl.h"
 #include "readtextfile.h"
 #include "debfile.h"
+#include "checksums.h"
 #include "chunks.h"
 
 #ifdef HAVE_LIBARCHIVE
@@ -37,6 +39,9 @@
 // * This is a very simple implementation calling ar and tar, which
 // * is only used with --without-libarchive or when no libarchive was
 // * found.
+// * (The pipes are close-on-exec, as this might run in parallel jobs and
+// * children of other threads would otherwise keep the pipes open. dup2
+// * clears that flag for the ends the children get as stdin/stdout.)
 // **********************************************************************
 
 static retvalue try_extractcontrol(char **control, const char *debfile, bool brokentar) {
@@ -51,14 +56,14 @@ static retvalue try_extractcontrol(char **control, const char *debfile, bool bro
 
 	result = RET_OK;
 
-	ret = pipe(pipe_1);
+	ret = pipe2(pipe_1, O_CLOEXEC);
 	if (ret < 0) {
 		int e = errno;
 		fprintf(stderr, "Error %d creating pipe: %s\n", e, strerror(e));
 		return RET_ERRNO(e);
 	}
 
-	ret = pipe(pipe_2);
+	ret = pipe2(pipe_2, O_CLOEXEC);
 	if (ret < 0) {
 		int e = errno;
 		close(pipe_1[0]); close(pipe_1[1]);
@@ -122,7 +127,7 @@ static retvalue try_extractcontrol(char **control, const char *debfile, bool bro
 	}
 
 	close(pipe_1[0]); close(pipe_1[1]);
-	markcloseonexec(pipe_2[0]); close(pipe_2[1]);
+	close(pipe_2[1]);
 
 	controlchunk = NULL;
 
@@ -168,7 +173,9 @@ static retvalue try_extractcontrol(char **control, const char *debfile, bool bro
 	}
 
 	while (ar != -1 || tar != -1) {
-		pid=wait(&status);
+		/* only wait for our own children, other threads
+		 * might have some, too */
+		pid = waitpid((ar != -1)?ar:tar, &status, 0);
 		if (pid < 0) {
 			if (errno != EINTR)
 				RET_UPDATE(result, RET_ERRNO(errno));
@@ -259,7 +266,7 @@ retvalue getfilelist(/*@out@*/char **filelist, /*@out@*/size_t *size, const char
 
 	result = RET_OK;
 
-	ret = pipe(pipe_1);
+	ret = pipe2(pipe_1, O_CLOEXEC);
 	if (ret < 0) {
 		int e = errno;
 		fprintf(stderr, "Error %d creating pipe: %s\n", e, strerror(e));
@@ -267,7 +274,7 @@ retvalue getfilelist(/*@out@*/char **filelist, /*@out@*/size_t *size, const char
 		return RET_ERRNO(e);
 	}
 
-	ret = pipe(pipe_2);
+	ret = pipe2(pipe_2, O_CLOEXEC);
 	if (ret < 0) {
 		int e = errno;
 		fprintf(stderr, "Error %d creating pipe: %s\n", e, strerror(e));
@@ -419,7 +426,9 @@ retvalue getfilelist(/*@out@*/char **filelist, /*@out@*/size_t *size, const char
 	close(pipe_2[0]);
 
 	while (ar != -1 || tar != -1) {
-		pid=wait(&status);
+		/* only wait for our own children, other threads
+		 * might have some, too */
+		pid = waitpid((ar != -1)?ar:tar, &status, 0);
 		if (pid < 0) {
 			if (errno != EINTR)
 				RET_UPDATE(result, RET_ERRNO(errno));
@@ -456,3 +465,27 @@ retvalue getfilelist(/*@out@*/char **filelist, /*@out@*/size_t *size, const char
 	return result;
 #endif
 }
+
+/* without libarchive the file is read by different programs,
+ * so this cannot be done in one go */
+retvalue debfile_read(const char *debfile, struct checksums **checksums_p, char **control_p, char **filelist_p, size_t *filelistsize_p) {
+	struct checksums *checksums;
+	retvalue r;
+
+	r = checksums_read(debfile, &checksums);
+	if (r == RET_NOTHING)
+		r = RET_ERROR_MISSING;
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = extractcontrol(control_p, debfile);
+	if (RET_WAS_ERROR(r)) {
+		checksums_free(checksums);
+		return r;
+	}
+	*checksums_p = checksums;
+	if (filelist_p != NULL) {
+		*filelist_p = NULL;
+		*filelistsize_p = 0;
+	}
+	return r;
+}
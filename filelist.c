@@ -27,6 +27,7 @@
 #include "package.h"
 #include "debfile.h"
 #include "filelist.h"
+#include "jobs.h"
 
 struct filelist_package {
 	struct filelist_package *next;
@@ -488,6 +489,140 @@ retvalue fakefilelist(const char *filekey) {
 			"", 1, true, false);
 }
 
+/* remember a file list already read when including the file */
+retvalue cachefilelist(const char *filekey, const char *filelist, size_t size) {
+	return table_adduniqsizedrecord(rdb_contents, filekey,
+			filelist, size, true, false);
+}
+
+/* remember to read the file list of a newly added package,
+ * unless it is already known */
+retvalue filelist_queue(const char *filekey) {
+	if (rdb_pendingfilelists == NULL || rdb_contents == NULL)
+		return RET_NOTHING;
+	if (table_recordexists(rdb_contents, filekey))
+		return RET_NOTHING;
+	return table_adduniqsizedrecord(rdb_pendingfilelists, filekey,
+			"", 1, true, false);
+}
+
+struct pendingfilelist {
+	char *filekey;
+	char *filelist;
+	size_t size;
+	retvalue result;
+};
+
+static retvalue readpendingfilelist(void *privdata, size_t i) {
+	struct pendingfilelist *p = (struct pendingfilelist *)privdata + i;
+	char *debfilename;
+
+	debfilename = files_calcfullfilename(p->filekey);
+	if (FAILEDTOALLOC(debfilename))
+		p->result = RET_ERROR_OOM;
+	else
+		p->result = getfilelist(&p->filelist, &p->size, debfilename);
+	free(debfilename);
+	/* errors are reported later, so do not stop the other jobs */
+	return RET_OK;
+}
+
+/* take the next (up to count) queued files out of the queue,
+ * skipping those already in the cache or no longer in the pool */
+static retvalue takependingfilelists(struct pendingfilelist *pending, size_t count, size_t *taken_p, bool *more_p) {
+	struct cursor *cursor;
+	const char *filekey, *data;
+	size_t taken = 0;
+	retvalue r;
+
+	r = table_newglobalcursor(rdb_pendingfilelists, false, &cursor);
+	if (!RET_IS_OK(r))
+		return r;
+	*more_p = false;
+	while (cursor_nexttempdata(rdb_pendingfilelists, cursor,
+				&filekey, &data, NULL)) {
+		if (taken >= count) {
+			*more_p = true;
+			break;
+		}
+		if (!table_recordexists(rdb_contents, filekey) &&
+				table_recordexists(rdb_checksums, filekey)) {
+			pending[taken].filekey = strdup(filekey);
+			if (FAILEDTOALLOC(pending[taken].filekey)) {
+				r = RET_ERROR_OOM;
+				break;
+			}
+			pending[taken].filelist = NULL;
+			pending[taken].size = 0;
+			/* what is left when a job was not started: */
+			pending[taken].result = RET_ERROR_INTERRUPTED;
+			taken++;
+		}
+		r = cursor_delete(rdb_pendingfilelists, cursor, filekey, NULL);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	*taken_p = taken;
+	if (RET_WAS_ERROR(r)) {
+		(void)cursor_close(rdb_pendingfilelists, cursor);
+		return r;
+	}
+	return cursor_close(rdb_pendingfilelists, cursor);
+}
+
+/* read the file lists of all queued files (with multiple jobs if
+ * enabled), so that generating Contents files later does not need
+ * to read them one by one */
+retvalue filelists_processpending(void) {
+	struct pendingfilelist *pending;
+	size_t batchsize, count, i;
+	bool more = true;
+	retvalue result, r;
+
+	if (rdb_pendingfilelists == NULL)
+		return RET_NOTHING;
+
+	batchsize = (global.jobs > 4)?(4 * global.jobs):16;
+	pending = nNEW(batchsize, struct pendingfilelist);
+	if (FAILEDTOALLOC(pending))
+		return RET_ERROR_OOM;
+	result = RET_NOTHING;
+	while (more) {
+		if (interrupted()) {
+			RET_UPDATE(result, RET_ERROR_INTERRUPTED);
+			break;
+		}
+		count = 0;
+		r = takependingfilelists(pending, batchsize, &count, &more);
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			more = false;
+		(void)jobs_run(count, readpendingfilelist, pending);
+		for (i = 0 ; i < count ; i++) {
+			struct pendingfilelist *p = &pending[i];
+
+			r = p->result;
+			if (RET_IS_OK(r)) {
+				if (verbose > 1)
+					printf("Read filelist for %s\n",
+							p->filekey);
+				r = cachefilelist(p->filekey,
+						p->filelist, p->size);
+			} else if (r == RET_ERROR_INTERRUPTED)
+				/* keep it for the next time */
+				(void)table_adduniqsizedrecord(
+						rdb_pendingfilelists,
+						p->filekey, "", 1,
+						true, false);
+			RET_UPDATE(result, r);
+			free(p->filelist);
+			free(p->filekey);
+		}
+	}
+	free(pending);
+	return result;
+}
+
 static const char separator_chars[] = "\t    ";
 
 static void filelist_writefiles(char *dir, size_t len,
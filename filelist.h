@@ -17,6 +17,9 @@ retvalue filelist_write(struct filelist_list *list, struct filetorelease *file);
 void filelist_free(/*@only@*/struct filelist_list *);
 
 retvalue fakefilelist(const char *filekey);
+retvalue cachefilelist(const char *filekey, const char *, size_t);
+retvalue filelist_queue(const char *filekey);
+retvalue filelists_processpending(void);
 retvalue filelists_translate(struct table *, struct table *);
 
 /* for use in routines reading the data: */
@@ -85,6 +85,8 @@ retvalue files_removesilent(const char *filekey) {
 
 	if (rdb_contents != NULL)
 		(void)table_deleterecord(rdb_contents, filekey, true);
+	if (rdb_pendingfilelists != NULL)
+		(void)table_deleterecord(rdb_pendingfilelists, filekey, true);
 	r = table_deleterecord(rdb_checksums, filekey, true);
 	if (r == RET_NOTHING) {
 		fprintf(stderr, "Unable to forget unknown filekey '%s'.\n",
@@ -535,9 +537,10 @@ retvalue files_regenerate_filelist(bool reread) {
 }
 
 /* Include a yet unknown file into the pool */
-retvalue files_preinclude(const char *sourcefilename, const char *filekey, struct checksums **checksums_p) {
+static retvalue preinclude(const char *sourcefilename, const char *filekey, /*@null@*/const struct checksums *known, struct checksums **checksums_p) {
 	retvalue r;
-	struct checksums *checksums, *realchecksums;
+	struct checksums *checksums, *readchecksums = NULL;
+	const struct checksums *realchecksums;
 	bool improves;
 	char *fullfilename;
 
@@ -545,13 +548,17 @@ retvalue files_preinclude(const char *sourcefilename, const char *filekey, struc
 	if (RET_WAS_ERROR(r))
 		return r;
 	if (RET_IS_OK(r)) {
-		r = checksums_read(sourcefilename, &realchecksums);
-		if (r == RET_NOTHING)
-			r = RET_ERROR_MISSING;
-		if (RET_WAS_ERROR(r)) {
-			checksums_free(checksums);
-			return r;
-		}
+		if (known == NULL) {
+			r = checksums_read(sourcefilename, &readchecksums);
+			if (r == RET_NOTHING)
+				r = RET_ERROR_MISSING;
+			if (RET_WAS_ERROR(r)) {
+				checksums_free(checksums);
+				return r;
+			}
+			realchecksums = readchecksums;
+		} else
+			realchecksums = known;
 		if (!checksums_check(checksums, realchecksums, &improves)) {
 			fprintf(stderr,
 "ERROR: '%s' cannot be included as '%s'.\n"
@@ -560,24 +567,24 @@ retvalue files_preinclude(const char *sourcefilename, const char *filekey, struc
 			checksums_printdifferences(stderr, checksums,
 					realchecksums);
 			checksums_free(checksums);
-			checksums_free(realchecksums);
+			checksums_free(readchecksums);
 			return RET_ERROR_WRONG_MD5;
 		}
 		if (improves) {
 			r = checksums_combine(&checksums, realchecksums, NULL);
 			if (RET_WAS_ERROR(r)) {
-				checksums_free(realchecksums);
+				checksums_free(readchecksums);
 				checksums_free(checksums);
 				return r;
 			}
 			r = files_replace_checksums(filekey, checksums);
 			if (RET_WAS_ERROR(r)) {
-				checksums_free(realchecksums);
+				checksums_free(readchecksums);
 				checksums_free(checksums);
 				return r;
 			}
 		}
-		checksums_free(realchecksums);
+		checksums_free(readchecksums);
 		// args, this breaks retvalue semantics!
 		if (checksums_p != NULL)
 			*checksums_p = checksums;
@@ -590,7 +597,20 @@ retvalue files_preinclude(const char *sourcefilename, const char *filekey, struc
 	if (FAILEDTOALLOC(fullfilename))
 		return RET_ERROR_OOM;
 	(void)dirs_make_parent(fullfilename);
-	r = checksums_copyfile(fullfilename, sourcefilename, true, &checksums);
+	if (known == NULL)
+		r = checksums_copyfile(fullfilename, sourcefilename, true,
+				&checksums);
+	else {
+		r = checksums_copyknownfile(fullfilename, sourcefilename,
+				known);
+		if (RET_IS_OK(r)) {
+			checksums = checksums_dup(known);
+			if (FAILEDTOALLOC(checksums)) {
+				deletefile(fullfilename);
+				r = RET_ERROR_OOM;
+			}
+		}
+	}
 	if (r == RET_ERROR_EXIST) {
 		// TODO: deal with already existing files!
 		fprintf(stderr, "File '%s' does already exist!\n",
@@ -618,6 +638,15 @@ retvalue files_preinclude(const char *sourcefilename, const char *filekey, struc
 	return RET_OK;
 }
 
+retvalue files_preinclude(const char *sourcefilename, const char *filekey, struct checksums **checksums_p) {
+	return preinclude(sourcefilename, filekey, NULL, checksums_p);
+}
+
+retvalue files_preincludeknown(const char *sourcefilename, const char *filekey, const struct checksums *known, struct checksums **checksums_p) {
+	assert (known != NULL);
+	return preinclude(sourcefilename, filekey, known, checksums_p);
+}
+
 static retvalue checkimproveorinclude(const char *sourcedir, const char *basefilename, const char *filekey, struct checksums **checksums_p, bool *improving) {
 	retvalue r;
 	struct checksums *checksums = NULL;
@@ -49,6 +49,8 @@ retvalue files_checkorimprove(const struct strlist *, struct checksums **);
  *  (the original file is not deleted in that case, even if delete is positive)
  */
 retvalue files_preinclude(const char *sourcefilename, const char *filekey, /*@null@*//*@out@*/struct checksums **);
+/* the same if the checksums of sourcefilename were already calculated */
+retvalue files_preincludeknown(const char *sourcefilename, const char *filekey, const struct checksums *, /*@null@*//*@out@*/struct checksums **);
 retvalue files_checkincludefile(const char *directory, const char *sourcefilename, const char *filekey, struct checksums **);
 
 typedef retvalue per_file_action(void *data, const char *filekey);
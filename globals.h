@@ -82,6 +82,8 @@ extern struct global_config {
 	bool onlysmalldeletes;
 	/* verbosity of downloading statistics */
 	int showdownloadpercent;
+	/* maximum number of threads to use (<= 1 means no threads) */
+	unsigned int jobs;
 } global;
 
 enum compression { c_none, c_gzip, c_bzip2, c_lzma, c_xz, c_lunzip, c_zstd, c_COUNT };
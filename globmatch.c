@@ -39,6 +39,10 @@
 */
 
 bool globmatch(const char *string, const char *pattern) {
+	return globmatch_n(string, strlen(string), pattern);
+}
+
+bool globmatch_n(const char *string, size_t len, const char *pattern) {
 	int i, l = strlen(pattern);
 	int smallest_possible = 0, largest_possible = 0;
 	bool possible[ l + 1 ];
@@ -56,7 +60,7 @@ bool globmatch(const char *string, const char *pattern) {
 	Assert (largest_possible <= l);
 	possible[largest_possible] = true;
 
-	for (p = string ; *p != '\0' ; p++) {
+	for (p = string ; p < string + len ; p++) {
 		Assert (largest_possible >= smallest_possible);
 		for (i = largest_possible ; i >= smallest_possible ; i--) {
 			if (!possible[i])
@@ -2,6 +2,8 @@
 #define REPREPRO_GLOBMATCH_H
 
 bool globmatch(const char * /*string*/, const char */*pattern*/);
+/* the same with a string that is not 0-terminated */
+bool globmatch_n(const char * /*string*/, size_t, const char */*pattern*/);
 
 #endif
 
@@ -52,6 +52,7 @@
 #include "configparser.h"
 #include "byhandhook.h"
 #include "changes.h"
+#include "jobs.h"
 
 enum permitflags {
 	/* do not error out on unused files */
@@ -498,6 +499,9 @@ struct candidate {
 		/* only valid while parsing */
 		struct hashes h;
 	} *files;
+	/* set by candidate_fetch_files when run as job before candidate_add */
+	bool fetched;
+	retvalue fetchresult;
 	struct candidate_perdistribution {
 		struct candidate_perdistribution *next;
 		struct distribution *into;
@@ -1075,7 +1079,7 @@ static retvalue candidate_read_deb(struct incoming *i, struct candidate *c, stru
 	return RET_OK;
 }
 
-static retvalue candidate_read_dsc(struct incoming *i, struct candidate_file *file) {
+static retvalue candidate_read_dsc(const struct incoming *i, struct candidate_file *file) {
 	retvalue r;
 	bool broken = false;
 	char *p;
@@ -1096,7 +1100,10 @@ static retvalue candidate_read_dsc(struct incoming *i, struct candidate_file *fi
 	return RET_OK;
 }
 
-static retvalue candidate_read_files(struct incoming *i, struct candidate *c) {
+/* the expensive part of reading the files (copying them, computing
+ * their checksums and extracting the control data), only looks at
+ * the candidate, so it can run as job for multiple candidates */
+static retvalue candidate_fetch_files(const struct incoming *i, const struct candidate *c) {
 	struct candidate_file *file;
 	retvalue r;
 
@@ -1110,7 +1117,7 @@ static retvalue candidate_read_files(struct incoming *i, struct candidate *c) {
 		assert(file->tempfilename != NULL);
 
 		if (FE_BINARY(file->type))
-			r = candidate_read_deb(i, c, file);
+			r = binaries_extractdeb(&file->deb, file->tempfilename);
 		else if (file->type == fe_DSC)
 			r = candidate_read_dsc(i, file);
 		else {
@@ -1123,6 +1130,27 @@ static retvalue candidate_read_files(struct incoming *i, struct candidate *c) {
 	return RET_OK;
 }
 
+static retvalue candidate_read_files(struct incoming *i, struct candidate *c) {
+	struct candidate_file *file;
+	retvalue r;
+
+	if (c->fetched)
+		r = c->fetchresult;
+	else
+		r = candidate_fetch_files(i, c);
+	if (RET_WAS_ERROR(r))
+		return r;
+
+	for (file = c->files ; file != NULL ; file = file->next) {
+		if (!FE_BINARY(file->type))
+			continue;
+		r = candidate_read_deb(i, c, file);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
 static retvalue candidate_preparebuildinfos(const struct incoming *i, const struct candidate *c, struct candidate_perdistribution *per) {
 	retvalue r;
 	struct candidate_package *package;
@@ -2292,12 +2320,9 @@ static retvalue candidate_really_add(struct incoming *i, struct candidate *c) {
 	return RET_OK;
 }
 
-static retvalue candidate_add(struct incoming *i, struct candidate *c) {
+static retvalue candidate_checkdistributions(struct incoming *i, struct candidate *c) {
 	struct candidate_perdistribution *d;
-	struct candidate_file *file;
 	retvalue r;
-	bool somethingtodo;
-	char *origfilename;
 	assert (c->perdistribution != NULL);
 
 	/* check if every distribution this is to be added to supports
@@ -2315,6 +2340,16 @@ static retvalue candidate_add(struct incoming *i, struct candidate *c) {
 	// TODO: once uploaderlist allows one to look for package names or
 	// existing override entries or such things, check package names here
 	// enable checking for content name with outer name
+	return RET_OK;
+}
+
+static retvalue candidate_add(struct incoming *i, struct candidate *c) {
+	struct candidate_perdistribution *d;
+	struct candidate_file *file;
+	retvalue r;
+	bool somethingtodo;
+	char *origfilename;
+	assert (c->perdistribution != NULL);
 
 	/* when we get here, the package is allowed in, now we have to
 	 * read the parts and check all stuff we only know now */
@@ -2416,35 +2451,24 @@ static retvalue candidate_add(struct incoming *i, struct candidate *c) {
 	return r;
 }
 
-static retvalue process_changes(struct incoming *i, int ofs) {
-	struct candidate *c;
-	retvalue r;
-	int j, k;
-	bool broken = false, tried = false;
+static void candidate_onerror(struct incoming *i, const struct candidate *c) {
+	struct candidate_file *file;
 
-	r = candidate_read(i, ofs, &c, &broken);
-	if (RET_WAS_ERROR(r))
-		return r;
-	assert (RET_IS_OK(r));
-	r = candidate_parse(i, c);
-	if (RET_WAS_ERROR(r)) {
-		candidate_free(c);
-		return r;
+	if (!i->cleanup[cuf_on_error])
+		return;
+	i->delete[c->ofs] = true;
+	for (file = c->files ; file != NULL ; file = file->next) {
+		i->delete[file->ofs] = true;
 	}
-	r = candidate_earlychecks(i, c);
-	if (RET_WAS_ERROR(r)) {
-		if (i->cleanup[cuf_on_error]) {
-			struct candidate_file *file;
+}
+
+/* look which distributions to put it in and if it is allowed there,
+ * returns RET_OK if the files should be read and the candidate added */
+static retvalue candidate_accept(struct incoming *i, struct candidate *c, bool broken) {
+	retvalue r;
+	int j, k;
+	bool tried = false;
 
-			i->delete[c->ofs] = true;
-			for (file = c->files ; file != NULL ;
-			                       file = file->next) {
-				i->delete[file->ofs] = true;
-			}
-		}
-		candidate_free(c);
-		return r;
-	}
 	for (k = 0 ; k < c->distributions.count ; k++) {
 		const char *name = c->distributions.values[k];
 
@@ -2459,10 +2483,9 @@ static retvalue process_changes(struct incoming *i, int ofs) {
 				if (RET_IS_OK(r))
 					r = candidate_newdistribution(c,
 							i->allow_into[j]);
-				if (RET_WAS_ERROR(r)) {
-					candidate_free(c);
+				if (RET_WAS_ERROR(r))
 					return r;
-				} else
+				else
 					break;
 			}
 		}
@@ -2473,10 +2496,8 @@ static retvalue process_changes(struct incoming *i, int ofs) {
 	if (c->perdistribution == NULL && i->default_into != NULL) {
 		tried = true;
 		r = candidate_checkpermissions(i, c, i->default_into);
-		if (RET_WAS_ERROR(r)) {
-			candidate_free(c);
+		if (RET_WAS_ERROR(r))
 			return r;
-		}
 		if (RET_IS_OK(r)) {
 			r = candidate_newdistribution(c, i->default_into);
 		}
@@ -2484,7 +2505,7 @@ static retvalue process_changes(struct incoming *i, int ofs) {
 	if (c->perdistribution == NULL) {
 		fprintf(stderr, tried?"No distribution accepting '%s' (i.e. none of the candidate distributions allowed inclusion)!\n":
 				      "No distribution found for '%s'!\n",
-			i->files.values[ofs]);
+			BASENAME(i, c->ofs));
 		if (i->cleanup[cuf_on_deny]) {
 			struct candidate_file *file;
 
@@ -2496,30 +2517,156 @@ static retvalue process_changes(struct incoming *i, int ofs) {
 					i->delete[file->ofs] = true;
 			}
 		}
-		r = RET_ERROR_INCOMING_DENY;
-	} else {
-		if (broken) {
-			fprintf(stderr,
+		return RET_ERROR_INCOMING_DENY;
+	}
+	if (broken) {
+		fprintf(stderr,
 "'%s' is signed with only invalid signatures.\n"
 "If this was not corruption but willfull modification,\n"
 "remove the signatures and try again.\n",
-				i->files.values[ofs]);
-			r = RET_ERROR;
-		} else
-			r = candidate_add(i, c);
-		if (RET_WAS_ERROR(r) && i->cleanup[cuf_on_error]) {
-			struct candidate_file *file;
+			BASENAME(i, c->ofs));
+		r = RET_ERROR;
+	} else
+		r = candidate_checkdistributions(i, c);
+	if (RET_WAS_ERROR(r))
+		candidate_onerror(i, c);
+	return r;
+}
 
-			i->delete[c->ofs] = true;
-			for (file = c->files ; file != NULL ;
-			                       file = file->next) {
-				i->delete[file->ofs] = true;
-			}
+/* The .changes files are processed in batches: reading and checking
+ * the .changes files and reading the files they list is done with
+ * jobs, everything else one after the other in the order of the
+ * .changes files. */
+
+struct changesjob {
+	int ofs;
+	struct candidate *c;
+	bool broken;
+	/* if the files can be read in a job */
+	bool fetch;
+	retvalue result;
+};
+
+struct changesbatch {
+	struct incoming *i;
+	struct changesjob *jobs;
+};
+
+static retvalue read_changes_job(void *privdata, size_t n) {
+	struct changesbatch *b = privdata;
+	struct changesjob *job = &b->jobs[n];
+	struct incoming *i = b->i;
+	retvalue r;
+
+	r = candidate_read(i, job->ofs, &job->c, &job->broken);
+	if (RET_WAS_ERROR(r)) {
+		job->result = r;
+		return RET_OK;
+	}
+	assert (RET_IS_OK(r));
+	r = candidate_parse(i, job->c);
+	if (RET_WAS_ERROR(r)) {
+		candidate_free(job->c);
+		job->c = NULL;
+	} else
+		r = candidate_earlychecks(i, job->c);
+	/* errors are handled later, so do not stop the other jobs */
+	job->result = r;
+	return RET_OK;
+}
+
+static retvalue fetch_files_job(void *privdata, size_t n) {
+	struct changesbatch *b = privdata;
+	struct changesjob *job = &b->jobs[n];
+
+	if (job->c == NULL || !job->fetch)
+		return RET_NOTHING;
+	job->c->fetchresult = candidate_fetch_files(b->i, job->c);
+	job->c->fetched = true;
+	return RET_OK;
+}
+
+/* files listed in multiple .changes files of this batch share the
+ * same name in the TempDir, so only the first may read them in a job */
+static retvalue mark_fetchable(const struct incoming *i, struct changesjob *jobs, size_t count) {
+	bool *claimed;
+	const struct candidate_file *file;
+	size_t n;
+
+	claimed = nzNEW(i->files.count, bool);
+	if (FAILEDTOALLOC(claimed))
+		return RET_ERROR_OOM;
+	for (n = 0 ; n < count ; n++) {
+		if (jobs[n].c == NULL)
+			continue;
+		jobs[n].fetch = true;
+		for (file = jobs[n].c->files ; file != NULL ;
+		                               file = file->next) {
+			if (FE_PACKAGE(file->type) && claimed[file->ofs])
+				jobs[n].fetch = false;
+		}
+		for (file = jobs[n].c->files ; file != NULL ;
+		                               file = file->next) {
+			if (FE_PACKAGE(file->type))
+				claimed[file->ofs] = true;
 		}
 	}
-	logger_wait();
-	candidate_free(c);
-	return r;
+	free(claimed);
+	return RET_OK;
+}
+
+static retvalue process_changes(struct incoming *i, struct changesjob *jobs, size_t count) {
+	struct changesbatch batch;
+	retvalue result;
+	size_t n;
+
+	for (n = 0 ; n < count ; n++) {
+		jobs[n].c = NULL;
+		jobs[n].broken = false;
+		jobs[n].fetch = false;
+		/* what is left when a job was not started: */
+		jobs[n].result = RET_ERROR_INTERRUPTED;
+	}
+	batch.i = i;
+	batch.jobs = jobs;
+
+	(void)jobs_run(count, read_changes_job, &batch);
+
+	for (n = 0 ; n < count ; n++) {
+		struct candidate *c = jobs[n].c;
+
+		if (c == NULL)
+			continue;
+		if (RET_WAS_ERROR(jobs[n].result))
+			candidate_onerror(i, c);
+		else
+			jobs[n].result = candidate_accept(i, c,
+					jobs[n].broken);
+		if (RET_WAS_ERROR(jobs[n].result)) {
+			candidate_free(c);
+			jobs[n].c = NULL;
+		}
+	}
+
+	/* if this fails, candidate_add reads the files itself */
+	result = mark_fetchable(i, jobs, count);
+	if (RET_IS_OK(result))
+		(void)jobs_run(count, fetch_files_job, &batch);
+
+	for (n = 0 ; n < count ; n++) {
+		struct candidate *c = jobs[n].c;
+
+		if (c != NULL) {
+			jobs[n].result = candidate_add(i, c);
+			if (RET_WAS_ERROR(jobs[n].result))
+				candidate_onerror(i, c);
+			logger_wait();
+			candidate_free(c);
+			jobs[n].c = NULL;
+		}
+		RET_UPDATE(result, jobs[n].result);
+	}
+	return result;
 }
 
 static inline /*@null@*/char *create_uniq_subdir(const char *basedir) {
@@ -2567,6 +2714,8 @@ retvalue process_incoming(struct distribution *distributions, const char *name,
 	retvalue result, r;
 	int j;
 	char *morguedir;
+	struct changesjob *jobs;
+	size_t count, batchsize;
 
 	result = RET_NOTHING;
 
@@ -2574,6 +2723,15 @@ retvalue process_incoming(struct distribution *distributions, const char *name,
 	if (RET_WAS_ERROR(r))
 		return r;
 
+	/* Do not look at all .changes files at once, as the copies of
+	 * all their files would need to fit into the TempDir: */
+	batchsize = (global.jobs > 1)?4 * global.jobs:1;
+	jobs = nzNEW(batchsize, struct changesjob);
+	if (FAILEDTOALLOC(jobs)) {
+		incoming_free(i);
+		return RET_ERROR_OOM;
+	}
+	count = 0;
 	for (j = 0 ; j < i->files.count ; j ++) {
 		const char *basefilename = i->files.values[j];
 		size_t l = strlen(basefilename);
@@ -2585,9 +2743,18 @@ retvalue process_incoming(struct distribution *distributions, const char *name,
 		if (changesfilename != NULL && strcmp(basefilename, changesfilename) != 0)
 			continue;
 		/* a .changes file, check it */
-		r = process_changes(i, j);
+		jobs[count++].ofs = j;
+		if (count < batchsize)
+			continue;
+		r = process_changes(i, jobs, count);
+		RET_UPDATE(result, r);
+		count = 0;
+	}
+	if (count > 0) {
+		r = process_changes(i, jobs, count);
 		RET_UPDATE(result, r);
 	}
+	free(jobs);
 
 	logger_wait();
 	if (i->morguedir == NULL)
@@ -91,64 +91,92 @@ retvalue indexfile_close(struct indexfile *f) {
 	return r;
 }
 
-static retvalue indexfile_get(struct indexfile *f) {
-	char *p, *d, *e, *start;
-	bool afternewline, nothingyet;
+/* make a found chunk a proper string: '\r' are ignored, '\0' made spaces
+ * (only if there are any, usually it can stay as it is) */
+static char *indexfile_cleanchunk(char *start, char *end) {
+	size_t len = end - start;
+
+	if (unlikely(memchr(start, '\r', len) != NULL ||
+	             memchr(start, '\0', len) != NULL)) {
+		char *p, *d = start;
+
+		for (p = start ; p < end ; p++) {
+			/* just ignore '\r', even if not line-end... */
+			if (*p == '\r')
+				continue;
+			if (unlikely(*p == '\0'))
+				*(d++) = ' ';
+			else
+				*(d++) = *p;
+		}
+		end = d;
+	}
+	if (end > start && *(end-1) == '\n')
+		end--;
+	*end = '\0';
+	return start;
+}
+
+/* get the next chunk, which is kept in the buffer where it was read to */
+static retvalue indexfile_get(struct indexfile *f, /*@out@*/char **chunk_p) {
+	char *start, *p, *e, *nl, *n;
+	/* how much of the current chunk was already looked at */
+	size_t scanned = 0;
+	int lines = 0;
 	int bytes_read;
 
 	if (f->failed)
 		return RET_ERROR;
 
-	d = f->buffer;
-	afternewline = true;
-	nothingyet = true;
 	do {
 		start = f->buffer + f->ofs;
-		p = start ;
-		e = p + f->content;
-
-		// TODO: if the chunk_get* are more tested with strange
-		// input, this could be kept in-situ and only chunk_edit
-		// beautifying this chunk...
-
-		while (p < e) {
-			/* just ignore '\r', even if not line-end... */
-			if (*p == '\r') {
-				p++;
-				continue;
+		e = start + f->content;
+		if (scanned == 0) {
+			/* skip empty lines before the chunk */
+			while (start < e && (*start == '\n' || *start == '\r')) {
+				if (*start == '\n')
+					f->linenumber++;
+				start++;
 			}
-			if (*p == '\n') {
-				f->linenumber++;
-				if (afternewline) {
-					p++;
-					f->content -= (p - start);
-					f->ofs += (p - start);
-					assert (f->ofs == (p - f->buffer));
-					if (nothingyet)
-						/* restart */
-						return indexfile_get(f);
-					if (d > f->buffer && *(d-1) == '\n')
-						d--;
-					*d = '\0';
-					return RET_OK;
-				}
-				afternewline = true;
-				nothingyet = false;
-			} else
-				afternewline = false;
-			if (unlikely(*p == '\0')) {
-				*(d++) = ' ';
-				p++;
-			} else
-				*(d++) = *(p++);
+			f->content -= start - (f->buffer + f->ofs);
+			f->ofs = start - f->buffer;
+		}
+		/* look for an empty line (only '\r' counting as empty) */
+		p = start + scanned;
+		while (true) {
+			nl = memchr(p, '\n', e - p);
+			if (nl == NULL) {
+				scanned = e - start;
+				break;
+			}
+			n = nl + 1;
+			while (n < e && *n == '\r')
+				n++;
+			if (n >= e) {
+				/* cannot know yet if this ends the chunk */
+				scanned = nl - start;
+				break;
+			}
+			lines++;
+			if (*n == '\n') {
+				f->linenumber += lines + 1;
+				n++;
+				f->content -= n - start;
+				f->ofs = n - f->buffer;
+				*chunk_p = indexfile_cleanchunk(start, nl);
+				return RET_OK;
+			}
+			p = n;
 		}
 		/* ** out of data, read new ** */
 
-		/* start at beginning of free space */
-		f->ofs = (d - f->buffer);
-		f->content = 0;
+		/* move what is already there to the beginning */
+		if (f->ofs > 0) {
+			memmove(f->buffer, start, f->content);
+			f->ofs = 0;
+		}
 
-		if (f->size - f->ofs <= 2048) {
+		if (f->size - f->content <= 2048) {
 			/* Adding code to enlarge the buffer in this case
 			 * is risky as hard to test properly.
 			 *
@@ -165,23 +193,29 @@ static retvalue indexfile_get(struct indexfile *f) {
 			return RET_ERROR;
 		}
 
-		bytes_read = uncompress_read(f->f, d, f->size - f->ofs);
+		bytes_read = uncompress_read(f->f, f->buffer + f->content,
+				f->size - f->content);
 		if (bytes_read < 0)
 			return RET_ERROR;
 		else if (bytes_read == 0)
 			break;
-		f->content = bytes_read;
+		f->content += bytes_read;
 	} while (true);
 
-	if (d == f->buffer)
+	if (f->content == 0)
 		return RET_NOTHING;
 
 	/* end of file reached, return what we got so far */
-	assert (f->content == 0);
-	assert (d-f->buffer <= f->size);
-	if (d > f->buffer && *(d-1) == '\n')
-		d--;
-	*d = '\0';
+	start = f->buffer + f->ofs;
+	e = start + f->content;
+	for (p = start + scanned ; p < e ; p++)
+		if (*p == '\n')
+			lines++;
+	f->linenumber += lines;
+	f->ofs += f->content;
+	f->content = 0;
+	assert (f->ofs <= f->size);
+	*chunk_p = indexfile_cleanchunk(start, e);
 	return RET_OK;
 }
 
@@ -189,7 +223,7 @@ bool indexfile_getnext(struct indexfile *f, struct package *pkgout, struct targe
 	retvalue r;
 	bool ignorecruft = false; // TODO
 	char *packagename, *version;
-	const char *control;
+	char *control;
 	architecture_t atom;
 
 	packagename = NULL; version = NULL;
@@ -197,10 +231,9 @@ bool indexfile_getnext(struct indexfile *f, struct package *pkgout, struct targe
 		free(packagename); packagename = NULL;
 		free(version); version = NULL;
 		f->startlinenumber = f->linenumber + 1;
-		r = indexfile_get(f);
+		r = indexfile_get(f, &control);
 		if (!RET_IS_OK(r))
 			break;
-		control = f->buffer;
 		r = chunk_getvalue(control, "Package", &packagename);
 		if (r == RET_NOTHING) {
 			fprintf(stderr,
@@ -269,13 +302,15 @@ bool indexfile_getnext(struct indexfile *f, struct package *pkgout, struct targe
 						f->filename,
 						f->startlinenumber,
 						f->linenumber);
-				if (ignored[IGN_wrongarchitecture] == 0) {
+				/* might be parsed in parallel jobs */
+				if (__atomic_fetch_add(
+						&ignored[IGN_wrongarchitecture],
+						1, __ATOMIC_RELAXED) == 0) {
 					fprintf(stderr,
 "This either mean the repository you get packages from is of an extremely\n"
 "low quality, or something went wrong. Trying to ignore it now, though.\n"
 "To no longer get this message use '--ignore=wrongarchitecture'.\n");
 				}
-				ignored[IGN_wrongarchitecture]++;
 				free(architecture);
 				continue;
 			} else {
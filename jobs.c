@@ -0,0 +1,134 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "jobs.h"
+
+/* This module runs independent CPU-bound steps (like parsing index files)
+ * in multiple threads. Everything with side effects (database, pool,
+ * output that has to be in order) stays in the main thread, so only
+ * the callers know which parts are safe to hand over. */
+
+struct jobrun {
+	pthread_mutex_t mutex;
+	jobaction *action;
+	void *privdata;
+	size_t count, next;
+	retvalue result;
+};
+
+static bool jobs_nextitem(struct jobrun *run, /*@out@*/size_t *i_p) {
+	bool found;
+
+	pthread_mutex_lock(&run->mutex);
+	found = run->next < run->count && !RET_WAS_ERROR(run->result);
+	if (found)
+		*i_p = run->next++;
+	pthread_mutex_unlock(&run->mutex);
+	return found;
+}
+
+static void *jobs_thread(void *p) {
+	struct jobrun *run = p;
+	size_t i;
+	retvalue r;
+
+	while (jobs_nextitem(run, &i)) {
+		if (interrupted())
+			r = RET_ERROR_INTERRUPTED;
+		else
+			r = run->action(run->privdata, i);
+		pthread_mutex_lock(&run->mutex);
+		RET_UPDATE(run->result, r);
+		pthread_mutex_unlock(&run->mutex);
+	}
+	return NULL;
+}
+
+retvalue jobs_run(size_t count, jobaction *action, void *privdata) {
+	struct jobrun run;
+	pthread_t *threads;
+	unsigned int i, started, wanted;
+	int e;
+
+	if (count == 0)
+		return RET_NOTHING;
+
+	run.action = action;
+	run.privdata = privdata;
+	run.count = count;
+	run.next = 0;
+	run.result = RET_NOTHING;
+
+	wanted = (global.jobs > 1) ? global.jobs : 1;
+	if (wanted > count)
+		wanted = count;
+	if (wanted <= 1) {
+		size_t j;
+
+		for (j = 0 ; j < count ; j++) {
+			retvalue r;
+
+			if (interrupted())
+				r = RET_ERROR_INTERRUPTED;
+			else
+				r = action(privdata, j);
+			RET_UPDATE(run.result, r);
+			if (RET_WAS_ERROR(r))
+				break;
+		}
+		return run.result;
+	}
+
+	threads = nNEW(wanted, pthread_t);
+	if (FAILEDTOALLOC(threads))
+		return RET_ERROR_OOM;
+	e = pthread_mutex_init(&run.mutex, NULL);
+	if (e != 0) {
+		fprintf(stderr, "Error %d initializing mutex: %s\n",
+				e, strerror(e));
+		free(threads);
+		return RET_ERRNO(e);
+	}
+	/* the calling thread takes part, too: */
+	started = 0;
+	for (i = 1 ; i < wanted ; i++) {
+		e = pthread_create(&threads[started], NULL, jobs_thread, &run);
+		if (e != 0) {
+			/* not fatal, the others can do the work as well */
+			if (verbose > 0)
+				fprintf(stderr,
+"Error %d starting additional thread: %s\n", e, strerror(e));
+			break;
+		}
+		started++;
+	}
+	(void)jobs_thread(&run);
+	for (i = 0 ; i < started ; i++) {
+		e = pthread_join(threads[i], NULL);
+		assert (e == 0);
+	}
+	free(threads);
+	(void)pthread_mutex_destroy(&run.mutex);
+	return run.result;
+}
@@ -0,0 +1,21 @@
+#ifndef REPREPRO_JOBS_H
+#define REPREPRO_JOBS_H
+
+#ifndef REPREPRO_ERROR_H
+#include "error.h"
+#endif
+
+/* Run action(privdata, i) for every 0 <= i < count, using up to
+ * global.jobs threads at the same time (everything in the calling
+ * thread if that is 1 or less).
+ * No new i is started once an action returned an error or reprepro was
+ * interrupted. Returns the RET_UPDATE-combination of all results.
+ *
+ * The actions may only change data belonging to their i and only read
+ * data nobody changes while they run. Especially they may not use the
+ * database, except reading the packages of different targets as
+ * query.c does. */
+typedef retvalue jobaction(void * /*privdata*/, size_t /*i*/);
+retvalue jobs_run(size_t /*count*/, jobaction *, void * /*privdata*/);
+
+#endif
@@ -75,6 +75,7 @@
 #include "descriptions.h"
 #include "outhook.h"
 #include "package.h"
+#include "query.h"
 
 #ifndef STD_BASE_DIR
 #define STD_BASE_DIR "."
@@ -143,7 +144,7 @@ static off_t reservedotherspace = 1024*1024;
  * to change something owned by lower owners. */
 enum config_option_owner config_state,
 #define O(x) owner_ ## x = CONFIG_OWNER_DEFAULT
-O(fast), O(x_morguedir), O(x_outdir), O(x_basedir), O(x_distdir), O(x_dbdir), O(x_listdir), O(x_confdir), O(x_logdir), O(x_methoddir), O(x_section), O(x_priority), O(x_component), O(x_architecture), O(x_packagetype), O(nothingiserror), O(nolistsdownload), O(keepunusednew), O(keepunreferenced), O(keeptemporaries), O(keepdirectories), O(askforpassphrase), O(skipold), O(export), O(waitforlock), O(spacecheckmode), O(reserveddbspace), O(reservedotherspace), O(guessgpgtty), O(verbosedatabase), O(gunzip), O(bunzip2), O(unlzma), O(unxz), O(lunzip), O(unzstd), O(gnupghome), O(listformat), O(listmax), O(listskip), O(onlysmalldeletes), O(endhook), O(outhook);
+O(fast), O(x_morguedir), O(x_outdir), O(x_basedir), O(x_distdir), O(x_dbdir), O(x_listdir), O(x_confdir), O(x_logdir), O(x_methoddir), O(x_section), O(x_priority), O(x_component), O(x_architecture), O(x_packagetype), O(nothingiserror), O(nolistsdownload), O(keepunusednew), O(keepunreferenced), O(keeptemporaries), O(keepdirectories), O(askforpassphrase), O(skipold), O(export), O(waitforlock), O(spacecheckmode), O(reserveddbspace), O(reservedotherspace), O(guessgpgtty), O(verbosedatabase), O(gunzip), O(bunzip2), O(unlzma), O(unxz), O(lunzip), O(unzstd), O(gnupghome), O(listformat), O(listmax), O(listskip), O(onlysmalldeletes), O(endhook), O(outhook), O(jobs);
 #undef O
 
 #define CONFIGSET(variable, value) if (owner_ ## variable <= config_state) { \
@@ -526,6 +527,12 @@ ACTION_F(n, n, n, y, generatefilelists) {
 	return RET_ERROR;
 }
 
+ACTION_F(n, n, n, y, processfilelists) {
+	assert (argc == 1);
+
+	return filelists_processpending();
+}
+
 ACTION_T(n, n, translatefilelists) {
 	return database_translate_filelists();
 }
@@ -908,11 +915,19 @@ static retvalue remove_packages(struct distribution *distribution, struct remove
 		RET_ENDUPDATE(result, r);
 		return result;
 	}
-	return package_remove_each(distribution,
-			// TODO: why not arch comp pt here?
-			atom_unknown, atom_unknown, atom_unknown,
-			package_source_fits, NULL,
-			toremove);
+	/* only look at the packages of each source given */
+	for (; toremove->sourcename != NULL ; toremove++) {
+		r = package_remove_each_source(distribution,
+				// TODO: why not arch comp pt here?
+				atom_unknown, atom_unknown, atom_unknown,
+				toremove->sourcename,
+				package_source_fits, NULL,
+				toremove);
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	return result;
 }
 
 ACTION_D(n, n, y, removesrc) {
@@ -1008,6 +1023,7 @@ ACTION_D(y, n, y, removefilter) {
 	trackingdb tracks;
 	struct trackingdata trackingdata;
 	term *condition;
+	const char *source;
 
 	assert (argc == 3);
 
@@ -1052,11 +1068,19 @@ ACTION_D(y, n, y, removefilter) {
 	} else
 		tracks = NULL;
 
-	result = package_remove_each(distribution,
-			components, architectures, packagetypes,
-			package_matches_condition,
-			(tracks != NULL)?&trackingdata:NULL,
-			condition);
+	source = term_requiredsource(condition);
+	if (source != NULL)
+		result = package_remove_each_source(distribution,
+				components, architectures, packagetypes,
+				source, package_matches_condition,
+				(tracks != NULL)?&trackingdata:NULL,
+				condition);
+	else
+		result = package_remove_each(distribution,
+				components, architectures, packagetypes,
+				package_matches_condition,
+				(tracks != NULL)?&trackingdata:NULL,
+				condition);
 	if (tracks != NULL) {
 		trackingdata_finish(tracks, &trackingdata);
 		r = tracking_done(tracks, distribution);
@@ -1296,6 +1320,11 @@ struct lspart {
 	const char *component;
 	struct lsversion *versions;
 };
+/* the versions found in each target of the plan */
+struct lsquery {
+	const char *packagename;
+	struct lsversion **found;
+};
 
 static retvalue newlsversion(struct lsversion **versions_p, struct package *package, architecture_t architecture) {
 	struct lsversion *v, **v_p;
@@ -1334,6 +1363,42 @@ static retvalue ls_in_target(struct target *target, const char *packagename, str
 	return result;
 }
 
+/* add the versions found in one target (each with only the
+ * architecture of that target) to the versions to print */
+static retvalue mergelsversions(struct lsversion **versions_p, /*@only@*/struct lsversion *found) {
+	struct lsversion *v, **v_p;
+	retvalue result = RET_OK, r;
+
+	while (found != NULL) {
+		struct lsversion *f = found;
+
+		found = f->next;
+		f->next = NULL;
+		for (v_p = versions_p ; (v = *v_p) != NULL ; v_p = &v->next) {
+			if (strcmp(v->version, f->version) == 0)
+				break;
+		}
+		if (v == NULL) {
+			*v_p = f;
+			continue;
+		}
+		assert (f->architectures.count == 1);
+		r = atomlist_add_uniq(&v->architectures,
+				f->architectures.atoms[0]);
+		RET_UPDATE(result, r);
+		free(f->version);
+		atomlist_done(&f->architectures);
+		free(f);
+	}
+	return result;
+}
+
+static retvalue ls_job(struct target *target, void *data, size_t i) {
+	struct lsquery *q = data;
+
+	return ls_in_target(target, q->packagename, &q->found[i]);
+}
+
 static inline retvalue printlsparts(const char *pkgname, struct lspart *parts) {
 	int versionlen, codenamelen, componentlen;
 	struct lspart *p;
@@ -1391,53 +1456,132 @@ static inline retvalue printlsparts(const char *pkgname, struct lspart *parts) {
 	return result;
 }
 
+/* look into all targets of the plan, collect the results in the lspart
+ * each target belongs to and print those parts where anything was found */
+static retvalue ls_query(const char *packagename, const struct queryplan *plan, /*@only@*/struct lspart *parts) {
+	struct lsquery q;
+	struct lspart *p, *first, **last_p;
+	retvalue result, r;
+	size_t i;
+
+	q.packagename = packagename;
+	q.found = nzNEW(plan->count, struct lsversion *);
+	if (FAILEDTOALLOC(q.found))
+		result = RET_ERROR_OOM;
+	else
+		result = query_run(plan, ls_job, &q);
+	for (i = 0 ; q.found != NULL && i < plan->count ; i++) {
+		p = plan->items[i].data;
+		r = mergelsversions(&p->versions, q.found[i]);
+		RET_UPDATE(result, r);
+	}
+	free(q.found);
+
+	first = NULL;
+	last_p = &first;
+	while (parts != NULL) {
+		p = parts;
+		parts = p->next;
+		if (p->versions != NULL && !RET_WAS_ERROR(result)) {
+			*last_p = p;
+			last_p = &p->next;
+			continue;
+		}
+		while (p->versions != NULL) {
+			struct lsversion *v = p->versions;
+
+			p->versions = v->next;
+			free(v->version);
+			atomlist_done(&v->architectures);
+			free(v);
+		}
+		free(p);
+	}
+	if (RET_WAS_ERROR(result))
+		return result;
+	/* printlsparts stops at the first part without codename */
+	*last_p = zNEW(struct lspart);
+	if (FAILEDTOALLOC(*last_p))
+		return RET_ERROR_OOM;
+	return printlsparts(packagename, first);
+}
+
+static void freelsparts(/*@only@*/struct lspart *parts) {
+	while (parts != NULL) {
+		struct lspart *p = parts;
+
+		parts = p->next;
+		free(p);
+	}
+}
+
 ACTION_B(y, n, y, ls) {
 	retvalue r;
 	struct distribution *d;
 	struct target *t;
-	struct lspart *first, *last;
+	struct lspart *first, **last_p, *part;
+	struct queryplan plan;
 
 	assert (argc == 2);
 
-	first = zNEW(struct lspart);
-	last = first;
-
+	/* first look which targets to look at, so that all can be
+	 * looked at the same time */
+	queryplan_init(&plan);
+	first = NULL;
+	last_p = &first;
+	r = RET_NOTHING;
 	for (d = alldistributions ; d != NULL ; d = d->next) {
+		part = NULL;
 		for (t = d->targets ; t != NULL ; t = t->next) {
 			if (!target_matches(t, components, architectures,
 						packagetypes))
 				continue;
-			r = ls_in_target(t, argv[1], &last->versions);
+			if (part == NULL) {
+				part = zNEW(struct lspart);
+				if (FAILEDTOALLOC(part)) {
+					r = RET_ERROR_OOM;
+					break;
+				}
+				part->codename = d->codename;
+				*last_p = part;
+				last_p = &part->next;
+			}
+			r = queryplan_add(&plan, t, part);
 			if (RET_WAS_ERROR(r))
-				return r;
-		}
-		if (last->versions != NULL) {
-			last->codename = d->codename;
-			last->next = zNEW(struct lspart);
-			last = last->next;
+				break;
 		}
+		if (RET_WAS_ERROR(r))
+			break;
 	}
-	return printlsparts(argv[1], first);
+	if (RET_WAS_ERROR(r))
+		freelsparts(first);
+	else
+		r = ls_query(argv[1], &plan, first);
+	queryplan_done(&plan);
+	return r;
 }
 
 ACTION_B(y, n, y, lsbycomponent) {
 	retvalue r;
 	struct distribution *d;
 	struct target *t;
-	struct lspart *first, *last;
+	struct lspart *first, **last_p, *part;
+	struct queryplan plan;
 	int i;
 
 	assert (argc == 2);
 
-	first = zNEW(struct lspart);
-	last = first;
-
+	queryplan_init(&plan);
+	first = NULL;
+	last_p = &first;
+	r = RET_NOTHING;
 	for (d = alldistributions ; d != NULL ; d = d->next) {
 		for (i = 0 ; i < d->components.count ; i ++) {
 			component_t component = d->components.atoms[i];
 
 			if (limitations_missed(components, component))
 				continue;
+			part = NULL;
 			for (t = d->targets ; t != NULL ; t = t->next) {
 				if (t->component != component)
 					continue;
@@ -1447,19 +1591,34 @@ ACTION_B(y, n, y, lsbycomponent) {
 				if (limitations_missed(packagetypes,
 							t->packagetype))
 					continue;
-				r = ls_in_target(t, argv[1], &last->versions);
+				if (part == NULL) {
+					part = zNEW(struct lspart);
+					if (FAILEDTOALLOC(part)) {
+						r = RET_ERROR_OOM;
+						break;
+					}
+					part->codename = d->codename;
+					part->component =
+						atoms_components[component];
+					*last_p = part;
+					last_p = &part->next;
+				}
+				r = queryplan_add(&plan, t, part);
 				if (RET_WAS_ERROR(r))
-					return r;
-			}
-			if (last->versions != NULL) {
-				last->codename = d->codename;
-				last->component = atoms_components[component];
-				last->next = zNEW(struct lspart);
-				last = last->next;
+					break;
 			}
+			if (RET_WAS_ERROR(r))
+				break;
 		}
+		if (RET_WAS_ERROR(r))
+			break;
 	}
-	return printlsparts(argv[1], first);
+	if (RET_WAS_ERROR(r))
+		freelsparts(first);
+	else
+		r = ls_query(argv[1], &plan, first);
+	queryplan_done(&plan);
+	return r;
 }
 
 static retvalue listfilterprint(struct package *package, void *data) {
@@ -1487,6 +1646,7 @@ ACTION_B(y, n, y, listfilter) {
 	retvalue r, result;
 	struct distribution *distribution;
 	term *condition;
+	const char *source;
 
 	assert (argc == 3);
 
@@ -1500,9 +1660,15 @@ ACTION_B(y, n, y, listfilter) {
 		return result;
 	}
 
-	result = package_foreach(distribution,
-			components, architectures, packagetypes,
-			listfilterprint, NULL, condition);
+	source = term_requiredsource(condition);
+	if (source != NULL)
+		result = package_foreach_source(distribution,
+				components, architectures, packagetypes,
+				source, listfilterprint, NULL, condition);
+	else
+		result = package_foreach(distribution,
+				components, architectures, packagetypes,
+				listfilterprint, NULL, condition);
 	term_free(condition);
 	return result;
 }
@@ -1631,7 +1797,7 @@ ACTION_B(n, n, n, dumpcontents) {
 }
 
 ACTION_F(n, n, y, y, export) {
-	retvalue result, r;
+	retvalue result;
 	struct distribution *d;
 
 	if (export == EXPORT_NEVER || export == EXPORT_SILENT_NEVER) {
@@ -1644,7 +1810,6 @@ ACTION_F(n, n, y, y, export) {
 	assert (result != RET_NOTHING);
 	if (RET_WAS_ERROR(result))
 		return result;
-	result = RET_NOTHING;
 	for (d = alldistributions ; d != NULL ; d = d->next) {
 		if (!d->selected)
 			continue;
@@ -1654,22 +1819,10 @@ ACTION_F(n, n, y, y, export) {
 			if (argc > 1 && verbose >= 0 ) {
 				printf("No exporting %s (as it has the noexport option set).\n", d->codename);
 			}
-			continue;
-		}
-
-		if (verbose > 0) {
-			printf("Exporting %s...\n", d->codename);
-		}
-		r = distribution_fullexport(d);
-		if (RET_IS_OK(r))
-			/* avoid being exported again */
-			d->lookedat = false;
-		RET_UPDATE(result, r);
-		if (RET_WAS_ERROR(r) && export != EXPORT_FORCE) {
-			return r;
 		}
 	}
-	return result;
+	return distribution_fullexport(alldistributions,
+			export == EXPORT_FORCE);
 }
 
 /***********************update********************************/
@@ -2885,16 +3038,10 @@ ACTION_D(y, y, y, includedeb) {
 	} else {
 		tracks = NULL;
 	}
-	result = RET_NOTHING;
-	for (i = 2 ; i < argc ; i++) {
-		const char *filename = argv[i];
-
-		r = deb_add(component, architectures,
-				section, priority, packagetype,
-				distribution, filename,
-				delete, tracks);
-		RET_UPDATE(result, r);
-	}
+	result = deb_addmany(component, architectures,
+			section, priority, packagetype,
+			distribution, argc - 2, argv + 2,
+			delete, tracks);
 
 	distribution_unloadoverrides(distribution);
 
@@ -4131,6 +4278,8 @@ static const struct action {
 		2, 2, "[--delete] include <distribution> <.changes-file>"},
 	{"generatefilelists",	A_F(generatefilelists),
 		0, 1, "generatefilelists [reread]"},
+	{"processfilelists",	A_F(processfilelists),
+		0, 0, "[--jobs <count>] processfilelists"},
 	{"translatefilelists",	A__T(translatefilelists),
 		0, 0, "translatefilelists"},
 	{"translatelegacychecksums",	A_N(translatelegacychecksums),
@@ -4509,6 +4658,7 @@ LO_RESTRICT_FILE_BIN,
 LO_RESTRICT_FILE_SRC,
 LO_ENDHOOK,
 LO_OUTHOOK,
+LO_JOBS,
 LO_UNIGNORE};
 static int longoption = 0;
 const char *programname;
@@ -4801,6 +4951,10 @@ static void handle_option(int c, const char *argument) {
 				case LO_OUTHOOK:
 					CONFIGDUP(outhook, argument);
 					break;
+				case LO_JOBS:
+					CONFIGGSET(jobs, parse_number("--jobs",
+							argument, 1024));
+					break;
 				case LO_LISTMAX:
 					i = parse_number("--list-max",
 							argument, INT_MAX);
@@ -5127,6 +5281,7 @@ int main(int argc, char *argv[]) {
 		{"restrict-file-binary", required_argument, &longoption, LO_RESTRICT_FILE_BIN},
 		{"endhook", required_argument, &longoption, LO_ENDHOOK},
 		{"outhook", required_argument, &longoption, LO_OUTHOOK},
+		{"jobs", required_argument, &longoption, LO_JOBS},
 		{NULL, 0, NULL, 0}
 	};
 	const struct action *a;
@@ -5280,6 +5435,7 @@ int main(int argc, char *argv[]) {
 	if (unzstd != NULL && lunzip[0] == '+')
 		lunzip = expand_plus_prefix(unzstd, "unzstd", "boc", true);
 	uncompressions_check(gunzip, bunzip2, unlzma, unxz, lunzip, unzstd);
+	uncompression_setthreads(global.jobs);
 	free(gunzip);
 	free(bunzip2);
 	free(unlzma);
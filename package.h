@@ -17,6 +17,9 @@ struct package {
 	/* used to keep the memory that might be needed for the above,
 	 * only to be used to free once this struct is abandoned */
 	char *pkgchunk, *pkgname, *pkgversion, *pkgsource, *pkgsrcversion;
+	/* allocated sizes of the above, so that an iterator can reuse
+	 * them for the next package (0 if not to be reused) */
+	size_t pkgnamesize, pkgversionsize, pkgsourcesize, pkgsrcversionsize;
 };
 struct distribution;
 struct target;
@@ -31,9 +34,13 @@ typedef retvalue action_each_package(struct package *, void *);
 retvalue package_foreach(struct distribution *, /*@null@*/const struct atomlist *, /*@null@*/const struct atomlist *, /*@null@*/const struct atomlist *, action_each_package, /*@null@*/action_each_target, void *);
 /* same but different ways to restrict it */
 retvalue package_foreach_c(struct distribution *, /*@null@*/const struct atomlist *, architecture_t, packagetype_t, action_each_package, void *);
+/* only packages whose source is (most likely) the given one */
+retvalue package_foreach_source(struct distribution *, /*@null@*/const struct atomlist *, /*@null@*/const struct atomlist *, /*@null@*/const struct atomlist *, const char *, action_each_package, /*@null@*/action_each_target, void *);
 
 /* delete every package decider returns RET_OK for */
 retvalue package_remove_each(struct distribution *, const struct atomlist *, const struct atomlist *, const struct atomlist *, action_each_package /*decider*/, struct trackingdata *, void *);
+/* same, but only looking at packages of the given source */
+retvalue package_remove_each_source(struct distribution *, const struct atomlist *, const struct atomlist *, const struct atomlist *, const char * /*source*/, action_each_package /*decider*/, struct trackingdata *, void *);
 
 
 retvalue package_get(struct target *, const char * /*name*/, /*@null@*/ const char */*version*/, /*@out@*/ struct package *);
@@ -60,6 +67,7 @@ static inline char *package_dupversion(struct package *package) {
 		// (caller must ensure it is not freed while still needed)
 		char *v = package->pkgversion;
 		package->pkgversion = NULL;
+		package->pkgversionsize = 0;
 		return v;
 	}
 }
@@ -69,9 +77,15 @@ struct package_cursor {
 	struct cursor *cursor;
 	struct package current;
 	bool close_database;
+	/* iterating the source index, current.name is allocated */
+	bool bysource;
 };
 
 retvalue package_openiterator(struct target *, bool /*readonly*/, bool /*duplicate*/, /*@out@*/struct package_cursor *);
+/* only packages built from the given source (if the database has no
+ * index for that, it iterates over all packages instead),
+ * package_newcontrol_by_cursor cannot be used with such an iterator */
+retvalue package_opensourceiterator(struct target *, const char * /*source*/, bool /*readonly*/, /*@out@*/struct package_cursor *);
 retvalue package_openduplicateiterator(struct target *t, const char *name, long long, /*@out@*/struct package_cursor *tc);
 bool package_next(struct package_cursor *);
 retvalue package_closeiterator(struct package_cursor *);
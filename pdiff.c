@@ -0,0 +1,1500 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#define CHECKSUMS_CONTEXT visible
+#include "error.h"
+#include "mprintf.h"
+#include "strlist.h"
+#include "filecntl.h"
+#include "chunks.h"
+#include "readtextfile.h"
+#include "checksums.h"
+#include "uncompression.h"
+#include "rredpatch.h"
+#include "release.h"
+#include "pdiff.h"
+
+/* This generates the same kind of .diff directories as rredtool does
+ * when called as export hook, but without calling diff and gzip and
+ * without reading the index files again: the new file is collected
+ * while being exported and compared with the old one stanza by stanza.
+ * Like with rredtool, new changes are merged into the old patches, so
+ * a client only needs to download a single patch. */
+
+/* apt had a bug, http://bugs.debian.org/545694
+ * to fail if a patch file only prepends text. */
+#define APT_545694_WORKAROUND
+
+/* apt always wants to apply the last patch
+ * (see http://bugs.debian.org/545699), so
+ * always create an fake-empty patch last */
+#define APT_545699_WORKAROUND
+
+/* the Index file needs to be downloaded, too, so do not make it too long */
+#define PDIFF_MAXPATCHES 20
+
+/* changed blocks with more than that (old lines times new lines) are
+ * replaced as a whole instead of looking for common lines within */
+#define FINEDIFF_MAXCELLS (1 << 18)
+
+#define DATEFMT "%Y-%m-%d-%H%M.%S"
+#define DATELEN (4 + 1 + 2 + 1 + 2 + 1 + 2 + 2 + 1 + 2)
+
+struct pdiff {
+	char *relfilename;
+	/* the file currently in place */
+	char *olddata;
+	size_t oldlen;
+	/* what is exported now */
+	char *newdata;
+	size_t newlen, newsize;
+	retvalue state;
+};
+
+struct pdiff_patch {
+	struct pdiff_patch *next, *prev;
+	char *name;
+	/* part until the + in the name */
+	char *nameprefix;
+	/* the file this patch applies to */
+	struct checksums *from;
+	/* the uncompressed patch and the .gz file */
+	struct checksums *patch, *download;
+	/* temporary file to delete if not used after all */
+	char *tmpfilename;
+};
+
+struct pdiff_index {
+	struct checksums *current;
+	struct pdiff_patch *first, *last;
+};
+
+static void patches_free(/*@only@*/struct pdiff_patch *p) {
+	while (p != NULL) {
+		struct pdiff_patch *n = p->next;
+
+		free(p->name);
+		free(p->nameprefix);
+		checksums_free(p->from);
+		checksums_free(p->patch);
+		checksums_free(p->download);
+		if (p->tmpfilename != NULL) {
+			(void)unlink(p->tmpfilename);
+			free(p->tmpfilename);
+		}
+		free(p);
+		p = n;
+	}
+}
+
+static void index_done(struct pdiff_index *i) {
+	checksums_free(i->current);
+	patches_free(i->first);
+	setzero(struct pdiff_index, i);
+}
+
+static inline bool samechecksums(const struct checksums *a, const struct checksums *b) {
+	return checksums_check(a, b, NULL);
+}
+
+/* read a whole (possibly compressed) file into memory */
+static retvalue readwholefile(const char *filename, enum compression c, /*@out@*/char **data_p, /*@out@*/size_t *len_p) {
+	struct compressedfile *f;
+	char *data = NULL, *h;
+	size_t len = 0, size = 0;
+	int got;
+	retvalue r;
+
+	r = uncompress_open(&f, filename, c);
+	if (RET_WAS_ERROR(r))
+		return r;
+	do {
+		size_t chunk;
+
+		if (size - len < 65536) {
+			size = (size == 0) ? 1048576 : 2 * size;
+			h = realloc(data, size);
+			if (FAILEDTOALLOC(h)) {
+				uncompress_abort(f);
+				free(data);
+				return RET_ERROR_OOM;
+			}
+			data = h;
+		}
+		chunk = size - len;
+		if (chunk > INT_MAX)
+			chunk = INT_MAX;
+		got = uncompress_read(f, data + len, chunk);
+		if (got < 0) {
+			uncompress_abort(f);
+			free(data);
+			return RET_ERROR;
+		}
+		len += got;
+	} while (got > 0);
+	r = uncompress_close(f);
+	if (RET_WAS_ERROR(r)) {
+		free(data);
+		return r;
+	}
+	*data_p = data;
+	*len_p = len;
+	return RET_OK;
+}
+
+static retvalue checksums_ofdata(/*@out@*/struct checksums **checksums_p, const void *data, size_t len) {
+	struct checksumscontext context;
+
+	checksumscontext_init(&context);
+	checksumscontext_update(&context, data, len);
+	return checksums_from_context(checksums_p, &context);
+}
+
+static retvalue get_date_string(char *date, size_t max) {
+	struct tm *tm;
+	time_t current_time;
+	size_t len;
+
+	assert (max == DATELEN + 1);
+
+	current_time = time(NULL);
+	if (current_time == ((time_t) -1)) {
+		int e = errno;
+		fprintf(stderr, "Error %d from time: %s\n",
+				e, strerror(e));
+		return RET_ERROR;
+	}
+	tm = gmtime(&current_time);
+	if (tm == NULL) {
+		int e = errno;
+		fprintf(stderr, "Error %d from gmtime: %s\n",
+				e, strerror(e));
+		return RET_ERROR;
+	}
+	len = strftime(date, max, DATEFMT, tm);
+	if (len == 0 || len != DATELEN) {
+		fputs("Internal problem calling strftime!\n", stderr);
+		return RET_ERROR;
+	}
+	return RET_OK;
+}
+
+/**** the Index file ****/
+
+static retvalue make_prefix_uniq(struct pdiff_patch *o) {
+	struct pdiff_patch *p, *last = NULL;
+	const char *lookfor = o->nameprefix;
+
+	/* make the prefix uniq by extending all previous occurrences
+	 * of this prefix with an additional +. As this might already
+	 * have happened, this has to be possibly repeated */
+
+	while (true) {
+		for (p = o->prev ; p != NULL ; p = p->prev) {
+			if (p == last)
+				continue;
+			if (strcmp(p->nameprefix, lookfor) == 0) {
+				char *h;
+				size_t l = strlen(p->nameprefix);
+
+				h = realloc(p->nameprefix, l+2);
+				if (FAILEDTOALLOC(h))
+					return RET_ERROR_OOM;
+				h[l] = '+' ;
+				h[l+1] = '\0';
+				p->nameprefix = h;
+				lookfor = h;
+				last = p;
+				break;
+			}
+		}
+		if (p == NULL)
+			return RET_OK;
+	}
+}
+
+/* parse "<hash> <size>" */
+static bool parse_current(const char *value, enum checksumtype cs, struct hashes *hashes) {
+	const char *p = value;
+
+	hashes->hashes[cs].start = p;
+	while ((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'f'))
+		p++;
+	hashes->hashes[cs].len = p - hashes->hashes[cs].start;
+	if (*p != ' ')
+		return false;
+	while (*p == ' ')
+		p++;
+	hashes->hashes[cs_length].start = p;
+	while (*p >= '0' && *p <= '9')
+		p++;
+	hashes->hashes[cs_length].len = p - hashes->hashes[cs_length].start;
+	return *p == '\0' && hashes->hashes[cs].len > 0
+		&& hashes->hashes[cs_length].len > 0;
+}
+
+static const char * const indexfields[2][3] = {
+	{ "SHA1-Current", "SHA1-History", "SHA1-Patches" },
+	{ "SHA256-Current", "SHA256-History", "SHA256-Patches" }
+};
+static const enum checksumtype indexhashes[2] = { cs_sha1sum, cs_sha256sum };
+
+/* the checksums of the .gz files are only needed to keep them by-hash,
+ * so ignore them if missing or strange */
+static retvalue parse_downloads(const char *indexfilename, const char *chunk, struct pdiff_index *index) {
+	struct strlist lines;
+	struct pdiff_patch *o;
+	retvalue r;
+	int i;
+
+	r = chunk_getextralinelist(chunk, "SHA256-Download", &lines);
+	if (!RET_IS_OK(r))
+		return r;
+	for (i = 0, o = index->first ; o != NULL && i < lines.count ;
+			i++, o = o->next) {
+		struct hashes hashes;
+		const char *name;
+		size_t l = strlen(o->name);
+
+		setzero(struct hashes, &hashes);
+		r = hashline_parse(indexfilename, lines.values[i],
+				cs_sha256sum, &name,
+				&hashes.hashes[cs_sha256sum],
+				&hashes.hashes[cs_length]);
+		if (RET_WAS_ERROR(r))
+			break;
+		if (strncmp(name, o->name, l) != 0
+				|| strcmp(name + l, ".gz") != 0)
+			continue;
+		r = checksums_initialize(&o->download, hashes.hashes);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	strlist_done(&lines);
+	if (r == RET_ERROR_OOM)
+		return r;
+	return RET_OK;
+}
+
+/* RET_NOTHING means no Index or not one written by us */
+static retvalue parse_index(const char *indexfilename, const char *chunk, struct pdiff_index *index) {
+	struct strlist lists[2][2];
+	char *current[2] = { NULL, NULL }, *precedence;
+	struct hashes hashes;
+	retvalue r;
+	int h, l, i;
+
+	r = chunk_getvalue(chunk, "X-Patch-Precedence", &precedence);
+	if (!RET_IS_OK(r))
+		return r;
+	if (strcmp(precedence, "merged") != 0) {
+		free(precedence);
+		return RET_NOTHING;
+	}
+	free(precedence);
+
+	memset(lists, 0, sizeof(lists));
+	for (h = 0 ; h < 2 ; h++) {
+		r = chunk_getvalue(chunk, indexfields[h][0], &current[h]);
+		for (l = 0 ; RET_IS_OK(r) && l < 2 ; l++)
+			r = chunk_getextralinelist(chunk, indexfields[h][l+1],
+					&lists[h][l]);
+		if (!RET_IS_OK(r))
+			break;
+	}
+	if (RET_IS_OK(r)) {
+		setzero(struct hashes, &hashes);
+		if (!parse_current(current[0], cs_sha1sum, &hashes))
+			r = RET_NOTHING;
+		else {
+			struct hash_data size = hashes.hashes[cs_length];
+
+			if (!parse_current(current[1], cs_sha256sum, &hashes)
+					|| size.len != hashes.hashes[cs_length].len
+					|| memcmp(size.start,
+						hashes.hashes[cs_length].start,
+						size.len) != 0)
+				r = RET_NOTHING;
+			else
+				r = checksums_initialize(&index->current,
+						hashes.hashes);
+		}
+	}
+	for (l = 0 ; RET_IS_OK(r) && l < 2 ; l++) {
+		if (lists[0][l].count != lists[0][0].count
+				|| lists[1][l].count != lists[0][0].count)
+			r = RET_NOTHING;
+	}
+	for (i = 0 ; RET_IS_OK(r) && i < lists[0][0].count ; i++) {
+		struct pdiff_patch *o;
+		const char *name = NULL;
+		struct checksums **c;
+
+		o = zNEW(struct pdiff_patch);
+		if (FAILEDTOALLOC(o)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		o->prev = index->last;
+		index->last = o;
+		if (o->prev == NULL)
+			index->first = o;
+		else
+			o->prev->next = o;
+
+		for (l = 0 ; RET_IS_OK(r) && l < 2 ; l++) {
+			struct hash_data size[2];
+
+			setzero(struct hashes, &hashes);
+			for (h = 0 ; RET_IS_OK(r) && h < 2 ; h++) {
+				const char *n;
+
+				r = hashline_parse(indexfilename,
+						lists[h][l].values[i],
+						indexhashes[h], &n,
+						&hashes.hashes[indexhashes[h]],
+						&size[h]);
+				if (RET_WAS_ERROR(r)) {
+					r = RET_NOTHING;
+					break;
+				}
+				if (name == NULL)
+					name = n;
+				else if (strcmp(name, n) != 0)
+					r = RET_NOTHING;
+			}
+			if (RET_IS_OK(r) && (size[0].len != size[1].len ||
+					memcmp(size[0].start, size[1].start,
+						size[0].len) != 0))
+				r = RET_NOTHING;
+			if (!RET_IS_OK(r))
+				break;
+			hashes.hashes[cs_length] = size[0];
+			c = (l == 0) ? &o->from : &o->patch;
+			r = checksums_initialize(c, hashes.hashes);
+		}
+		if (!RET_IS_OK(r))
+			break;
+		/* no directories or other funny stuff */
+		if (name[0] == '.' || strchr(name, '/') != NULL) {
+			r = RET_NOTHING;
+			break;
+		}
+		o->name = strdup(name);
+		if (FAILEDTOALLOC(o->name)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		name = strchr(o->name, '+');
+		if (name == NULL)
+			o->nameprefix = mprintf("%s+", o->name);
+		else
+			o->nameprefix = strndup(o->name,
+					1 + (size_t)(name - o->name));
+		if (FAILEDTOALLOC(o->nameprefix)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		r = make_prefix_uniq(o);
+	}
+	for (h = 0 ; h < 2 ; h++) {
+		free(current[h]);
+		for (l = 0 ; l < 2 ; l++)
+			strlist_done(&lists[h][l]);
+	}
+	if (RET_IS_OK(r))
+		r = parse_downloads(indexfilename, chunk, index);
+	if (!RET_IS_OK(r))
+		index_done(index);
+	return r;
+}
+
+static retvalue read_index(const char *dirofdist, const char *relfilename, /*@out@*/struct pdiff_index *index) {
+	char *indexfilename, *chunk;
+	retvalue r;
+
+	setzero(struct pdiff_index, index);
+	indexfilename = mprintf("%s/%s.diff/Index", dirofdist, relfilename);
+	if (FAILEDTOALLOC(indexfilename))
+		return RET_ERROR_OOM;
+	if (!isregularfile(indexfilename)) {
+		free(indexfilename);
+		return RET_NOTHING;
+	}
+	r = readtextfile(indexfilename, indexfilename, &chunk, NULL);
+	if (RET_IS_OK(r)) {
+		r = parse_index(indexfilename, chunk, index);
+		free(chunk);
+		if (r == RET_NOTHING && verbose >= 0)
+			fprintf(stderr,
+"Ignoring '%s' not looking like generated by reprepro, starting a new one.\n",
+					indexfilename);
+	}
+	free(indexfilename);
+	return r;
+}
+
+enum patchpart { pp_from, pp_patch, pp_download };
+
+static void write_hashlines(struct filetorelease *f, const char *field, const struct pdiff_patch *root, enum patchpart part, enum checksumtype cs) {
+	const struct pdiff_patch *p;
+
+	(void)release_writestring(f, field);
+	(void)release_writestring(f, ":\n");
+	for (p = root ; p != NULL ; p = p->next) {
+		const struct checksums *c;
+		const char *hash, *size;
+		size_t hashlen, sizelen;
+		bool found;
+
+		if (part == pp_from)
+			c = p->from;
+		else if (part == pp_patch)
+			c = p->patch;
+		else
+			c = p->download;
+		found = checksums_gethashpart(c, cs, &hash, &hashlen,
+				&size, &sizelen);
+		assert (found);
+		(void)release_writestring(f, " ");
+		(void)release_writedata(f, hash, hashlen);
+		(void)release_writestring(f, " ");
+		(void)release_writedata(f, size, sizelen);
+		(void)release_writestring(f, " ");
+		(void)release_writestring(f, p->name);
+		if (part == pp_download)
+			(void)release_writestring(f, ".gz");
+		(void)release_writestring(f, "\n");
+	}
+}
+
+static retvalue write_index(struct release *release, const char *relfilename, const struct checksums *current, const struct pdiff_patch *root) {
+	struct filetorelease *f;
+	char *relindexfilename;
+	retvalue r;
+	int h;
+
+	relindexfilename = mprintf("%s.diff/Index", relfilename);
+	if (FAILEDTOALLOC(relindexfilename))
+		return RET_ERROR_OOM;
+	r = release_startfile(release, relindexfilename,
+			IC_FLAG(ic_uncompressed), false, &f);
+	free(relindexfilename);
+	if (RET_WAS_ERROR(r))
+		return r;
+	for (h = 0 ; h < 2 ; h++) {
+		const char *hash, *size;
+		size_t hashlen, sizelen;
+		bool found;
+
+		found = checksums_gethashpart(current, indexhashes[h],
+				&hash, &hashlen, &size, &sizelen);
+		assert (found);
+		(void)release_writestring(f, indexfields[h][0]);
+		(void)release_writestring(f, ": ");
+		(void)release_writedata(f, hash, hashlen);
+		(void)release_writestring(f, " ");
+		(void)release_writedata(f, size, sizelen);
+		(void)release_writestring(f, "\n");
+	}
+	for (h = 0 ; h < 2 ; h++)
+		write_hashlines(f, indexfields[h][1], root, pp_from,
+				indexhashes[h]);
+	for (h = 0 ; h < 2 ; h++)
+		write_hashlines(f, indexfields[h][2], root, pp_patch,
+				indexhashes[h]);
+	write_hashlines(f, "SHA1-Download", root, pp_download, cs_sha1sum);
+	write_hashlines(f, "SHA256-Download", root, pp_download,
+			cs_sha256sum);
+	(void)release_writestring(f, "X-Patch-Precedence: merged\n");
+	return release_finishfile(release, f);
+}
+
+/* mark all files in the .diff directory not needed any more for deletion */
+static retvalue remove_old_diffs(struct release *release, const char *relfilename, const struct pdiff_patch *keep) {
+	char *diffdirectory, *filename;
+	struct dirent *de;
+	DIR *dir;
+	const struct pdiff_patch *p;
+	retvalue result, r;
+
+	diffdirectory = mprintf("%s/%s.diff", release_dirofdist(release),
+			relfilename);
+	if (FAILEDTOALLOC(diffdirectory))
+		return RET_ERROR_OOM;
+	if (!isdirectory(diffdirectory)) {
+		free(diffdirectory);
+		return RET_NOTHING;
+	}
+	dir = opendir(diffdirectory);
+	free(diffdirectory);
+	if (dir == NULL)
+		return RET_NOTHING;
+
+	result = RET_NOTHING;
+	while ((de = readdir(dir)) != NULL) {
+		size_t len = strlen(de->d_name);
+
+		/* the Index is replaced or deleted below */
+		if (strcmp(de->d_name, "Index") == 0)
+			continue;
+		/* if it does not end with .gz or .gz.new, ignore */
+		if (len >= 4 && memcmp(de->d_name + len - 4, ".new", 4) == 0)
+			len -= 4;
+		if (len < 3 || memcmp(de->d_name + len - 3, ".gz", 3) != 0)
+			continue;
+		len -= 3;
+
+		/* do not mark files to be deleted we still need: */
+		for (p = keep ; p != NULL ; p = p->next) {
+			if (strlen(p->name) == len &&
+					memcmp(p->name, de->d_name, len) == 0)
+				break;
+		}
+		if (p != NULL)
+			continue;
+		filename = mprintf("%s.diff/%s", relfilename, de->d_name);
+		if (FAILEDTOALLOC(filename)) {
+			(void)closedir(dir);
+			return RET_ERROR_OOM;
+		}
+		r = release_adddel(release, filename);
+		if (RET_WAS_ERROR(r)) {
+			(void)closedir(dir);
+			return r;
+		}
+		result = RET_OK;
+	}
+	(void)closedir(dir);
+	if (keep == NULL) {
+		char *indexfilename;
+		bool found;
+
+		indexfilename = mprintf("%s/%s.diff/Index",
+				release_dirofdist(release), relfilename);
+		if (FAILEDTOALLOC(indexfilename))
+			return RET_ERROR_OOM;
+		found = isregularfile(indexfilename);
+		free(indexfilename);
+		if (found) {
+			filename = mprintf("%s.diff/Index", relfilename);
+			if (FAILEDTOALLOC(filename))
+				return RET_ERROR_OOM;
+			r = release_adddel(release, filename);
+			if (RET_WAS_ERROR(r))
+				return r;
+			result = RET_OK;
+		}
+	}
+	return result;
+}
+
+/**** finding the differences ****/
+
+#define NOSTANZA ((size_t)-1)
+
+struct lines {
+	const char *data;
+	size_t count;
+	/* offset of each line (count + 1 entries) */
+	size_t *start;
+	/* first line of each stanza (stanzacount + 1 entries) */
+	size_t stanzacount;
+	size_t *stanza;
+	/* to look up stanzas of the other file: */
+	uint32_t *hash;
+	size_t *samehash;
+	size_t *table, tablemask;
+};
+
+static void lines_done(struct lines *l) {
+	free(l->start);
+	free(l->stanza);
+	free(l->hash);
+	free(l->samehash);
+	free(l->table);
+}
+
+static inline bool emptyline(const struct lines *l, size_t i) {
+	const char *p = l->data + l->start[i];
+	size_t len = l->start[i+1] - l->start[i];
+
+	return len == 1 || (len == 2 && p[0] == '\r');
+}
+
+static inline const char *stanza_data(const struct lines *l, size_t i, /*@out@*/size_t *len_p) {
+	size_t s = l->start[l->stanza[i]];
+
+	*len_p = l->start[l->stanza[i+1]] - s;
+	return l->data + s;
+}
+
+/* the data must end with a newline */
+static retvalue lines_init(/*@out@*/struct lines *l, const char *data, size_t len) {
+	const char *p, *e = data + len;
+	size_t i, s, tablesize;
+
+	setzero(struct lines, l);
+	assert (len == 0 || data[len - 1] == '\n');
+	l->data = data;
+	for (p = data ; p < e ; p++) {
+		p = memchr(p, '\n', e - p);
+		l->count++;
+	}
+	l->start = nNEW(l->count + 1, size_t);
+	if (FAILEDTOALLOC(l->start))
+		return RET_ERROR_OOM;
+	i = 0;
+	for (p = data ; p < e ; p++) {
+		l->start[i++] = p - data;
+		p = memchr(p, '\n', e - p);
+	}
+	l->start[i] = len;
+	/* a stanza is everything up to and including the next empty lines */
+	for (i = 0 ; i < l->count ; i++) {
+		if (i == 0 || (!emptyline(l, i) && emptyline(l, i - 1)))
+			l->stanzacount++;
+	}
+	l->stanza = nNEW(l->stanzacount + 1, size_t);
+	l->hash = nNEW(l->stanzacount, uint32_t);
+	l->samehash = nNEW(l->stanzacount, size_t);
+	tablesize = 16;
+	while (tablesize < 2 * l->stanzacount)
+		tablesize *= 2;
+	l->table = nzNEW(tablesize, size_t);
+	l->tablemask = tablesize - 1;
+	if (FAILEDTOALLOC(l->stanza) || FAILEDTOALLOC(l->hash)
+			|| FAILEDTOALLOC(l->samehash)
+			|| FAILEDTOALLOC(l->table)) {
+		lines_done(l);
+		return RET_ERROR_OOM;
+	}
+	s = 0;
+	for (i = 0 ; i < l->count ; i++) {
+		if (i == 0 || (!emptyline(l, i) && emptyline(l, i - 1)))
+			l->stanza[s++] = i;
+	}
+	assert (s == l->stanzacount);
+	l->stanza[s] = l->count;
+	for (s = 0 ; s < l->stanzacount ; s++) {
+		/* FNV-1a */
+		uint32_t h = 2166136261U;
+		const unsigned char *d;
+		size_t slen;
+
+		d = (const unsigned char *)stanza_data(l, s, &slen);
+		while (slen-- > 0) {
+			h ^= *(d++);
+			h *= 16777619U;
+		}
+		l->hash[s] = h;
+	}
+	/* insert backwards so that the chains are sorted */
+	for (s = l->stanzacount ; s-- > 0 ;) {
+		size_t slot = l->hash[s] & l->tablemask;
+
+		while (l->table[slot] != 0 &&
+				l->hash[l->table[slot] - 1] != l->hash[s])
+			slot = (slot + 1) & l->tablemask;
+		l->samehash[s] = (l->table[slot] == 0) ? NOSTANZA
+			: l->table[slot] - 1;
+		l->table[slot] = s + 1;
+	}
+	return RET_OK;
+}
+
+static inline bool samestanza(const struct lines *o, size_t i, const struct lines *n, size_t j) {
+	const char *a, *b;
+	size_t alen, blen;
+
+	if (o->hash[i] != n->hash[j])
+		return false;
+	a = stanza_data(o, i, &alen);
+	b = stanza_data(n, j, &blen);
+	return alen == blen && memcmp(a, b, alen) == 0;
+}
+
+/* find stanza j of other at or after stanza from in l */
+static size_t findstanza(const struct lines *l, size_t from, const struct lines *other, size_t j) {
+	size_t slot = other->hash[j] & l->tablemask, k;
+
+	while (l->table[slot] != 0 &&
+			l->hash[l->table[slot] - 1] != other->hash[j])
+		slot = (slot + 1) & l->tablemask;
+	if (l->table[slot] == 0)
+		return NOSTANZA;
+	for (k = l->table[slot] - 1 ; k != NOSTANZA ; k = l->samehash[k]) {
+		if (k >= from && samestanza(l, k, other, j))
+			return k;
+	}
+	return NOSTANZA;
+}
+
+static inline bool sameline(const struct lines *o, size_t i, const struct lines *n, size_t j) {
+	size_t len = o->start[i+1] - o->start[i];
+
+	return len == n->start[j+1] - n->start[j] &&
+		memcmp(o->data + o->start[i], n->data + n->start[j], len) == 0;
+}
+
+struct patchbuilder {
+	const struct lines *o, *n;
+	struct modification *first, *last;
+};
+
+/* old lines [o0, o1) are replaced by new lines [n0, n1) */
+static retvalue addchange(struct patchbuilder *pb, size_t o0, size_t o1, size_t n0, size_t n1) {
+	struct modification *m;
+
+	if (o0 == o1 && n0 == n1)
+		return RET_NOTHING;
+	m = modification_append(pb->last, o0 + 1, o1 - o0,
+			pb->n->data + pb->n->start[n0],
+			pb->n->start[n1] - pb->n->start[n0], n1 - n0);
+	if (FAILEDTOALLOC(m))
+		return RET_ERROR_OOM;
+	if (pb->first == NULL)
+		pb->first = m;
+	pb->last = m;
+	return RET_OK;
+}
+
+/* look for common lines within a block of changed stanzas,
+ * so that changing a single field does not replace the whole stanza */
+static retvalue finediff(struct patchbuilder *pb, size_t o0, size_t o1, size_t n0, size_t n1) {
+	const struct lines *o = pb->o, *n = pb->n;
+	size_t rows, cols, a, b, ca, cb;
+	uint16_t *lcs;
+	retvalue r;
+
+	while (o0 < o1 && n0 < n1 && sameline(o, o0, n, n0)) {
+		o0++;
+		n0++;
+	}
+	while (o0 < o1 && n0 < n1 && sameline(o, o1 - 1, n, n1 - 1)) {
+		o1--;
+		n1--;
+	}
+	rows = o1 - o0;
+	cols = n1 - n0;
+	if (rows == 0 || cols == 0 ||
+			(rows + 1) * (cols + 1) > FINEDIFF_MAXCELLS)
+		return addchange(pb, o0, o1, n0, n1);
+
+	/* longest common subsequence of the lines,
+	 * (at most sqrt(FINEDIFF_MAXCELLS), so 16 bit suffice) */
+	lcs = nNEW((rows + 1) * (cols + 1), uint16_t);
+	if (FAILEDTOALLOC(lcs))
+		return RET_ERROR_OOM;
+#define L(x, y) lcs[(x) * (cols + 1) + (y)]
+	for (a = rows + 1 ; a-- > 0 ;) {
+		for (b = cols + 1 ; b-- > 0 ;) {
+			if (a == rows || b == cols)
+				L(a, b) = 0;
+			else if (sameline(o, o0 + a, n, n0 + b))
+				L(a, b) = L(a + 1, b + 1) + 1;
+			else if (L(a + 1, b) >= L(a, b + 1))
+				L(a, b) = L(a + 1, b);
+			else
+				L(a, b) = L(a, b + 1);
+		}
+	}
+	a = b = ca = cb = 0;
+	r = RET_OK;
+	while (a < rows || b < cols) {
+		if (a < rows && b < cols && sameline(o, o0 + a, n, n0 + b)) {
+			r = addchange(pb, o0 + ca, o0 + a, n0 + cb, n0 + b);
+			if (RET_WAS_ERROR(r))
+				break;
+			a++;
+			b++;
+			ca = a;
+			cb = b;
+		} else if (b >= cols || (a < rows && L(a + 1, b) >= L(a, b + 1)))
+			a++;
+		else
+			b++;
+	}
+#undef L
+	free(lcs);
+	if (RET_WAS_ERROR(r))
+		return r;
+	return addchange(pb, o0 + ca, o0 + rows, n0 + cb, n0 + cols);
+}
+
+/* Index files are sorted lists of stanzas, most of them unchanged.
+ * So walk both files in parallel and only look at lines within blocks
+ * of stanzas that are not in both. */
+static retvalue diff_files(const struct lines *o, const struct lines *n, /*@out@*/struct modification **patch_p) {
+	struct patchbuilder pb;
+	size_t i = 0, j = 0, i0, j0, p, q;
+	size_t oc = o->stanzacount, nc = n->stanzacount;
+	retvalue r;
+
+	pb.o = o;
+	pb.n = n;
+	pb.first = NULL;
+	pb.last = NULL;
+	while (i < oc || j < nc) {
+		if (i < oc && j < nc && samestanza(o, i, n, j)) {
+			i++;
+			j++;
+			continue;
+		}
+		i0 = i;
+		j0 = j;
+		while ((i < oc || j < nc) &&
+				!(i < oc && j < nc && samestanza(o, i, n, j))) {
+			p = (j < nc) ? findstanza(o, i, n, j) : NOSTANZA;
+			q = (i < oc) ? findstanza(n, j, o, i) : NOSTANZA;
+			if (p != NOSTANZA && (q == NOSTANZA || p - i <= q - j))
+				/* the old ones before were deleted */
+				i = p;
+			else if (q != NOSTANZA)
+				/* the new ones before were added */
+				j = q;
+			else {
+				/* changed (or both deleted and added) */
+				if (i < oc)
+					i++;
+				if (j < nc)
+					j++;
+			}
+		}
+		r = finediff(&pb, o->stanza[i0], o->stanza[i],
+				n->stanza[j0], n->stanza[j]);
+		if (RET_WAS_ERROR(r)) {
+			modification_freelist(pb.first);
+			return r;
+		}
+	}
+	*patch_p = pb.first;
+	return RET_OK;
+}
+
+/**** writing patches ****/
+
+struct membuffer {
+	char *data;
+	size_t len, size;
+	bool failed;
+};
+
+static void membuffer_write(const void *data, size_t len, void *p) {
+	struct membuffer *b = p;
+
+	if (b->failed)
+		return;
+	if (b->size - b->len < len) {
+		size_t newsize = b->size + len + 65536;
+		char *h = realloc(b->data, newsize);
+
+		if (FAILEDTOALLOC(h)) {
+			b->failed = true;
+			return;
+		}
+		b->data = h;
+		b->size = newsize;
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static retvalue writetofile(const char *filename, const unsigned char *data, size_t len) {
+	int fd;
+
+	(void)unlink(filename);
+	fd = open(filename, O_WRONLY|O_CREAT|O_EXCL|O_NOCTTY, 0666);
+	if (fd < 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d creating '%s': %s\n",
+				e, filename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	while (len > 0) {
+		ssize_t written = write(fd, data, len);
+		if (written >= 0) {
+			len -= written;
+			data += written;
+		} else {
+			int e = errno;
+			if (e == EAGAIN || e == EINTR)
+				continue;
+			fprintf(stderr, "Error %d writing to '%s': %s\n",
+					e, filename, strerror(e));
+			(void)close(fd);
+			(void)unlink(filename);
+			return RET_ERRNO(e);
+		}
+	}
+	if (close(fd) != 0) {
+		int e = errno;
+		fprintf(stderr, "Error %d writing to '%s': %s\n",
+				e, filename, strerror(e));
+		(void)unlink(filename);
+		return RET_ERRNO(e);
+	}
+	return RET_OK;
+}
+
+static retvalue gzip_data(const struct membuffer *text, /*@out@*/unsigned char **gz_p, /*@out@*/size_t *gzlen_p) {
+	z_stream z;
+	unsigned char *gz = NULL;
+	uLong gzsize;
+	int zret;
+
+	memset(&z, 0, sizeof(z));
+	zret = deflateInit2(&z, 9, Z_DEFLATED, 16 + MAX_WBITS, 9,
+			Z_DEFAULT_STRATEGY);
+	if (zret == Z_MEM_ERROR)
+		return RET_ERROR_OOM;
+	if (zret != Z_OK) {
+		fprintf(stderr, "Error from zlib's deflateInit2: %s\n",
+				(z.msg == NULL) ? "unknown" : z.msg);
+		return RET_ERROR;
+	}
+	gzsize = deflateBound(&z, text->len);
+	gz = malloc(gzsize);
+	if (FAILEDTOALLOC(gz)) {
+		(void)deflateEnd(&z);
+		return RET_ERROR_OOM;
+	}
+	z.next_in = (Bytef *)text->data;
+	z.avail_in = text->len;
+	z.next_out = gz;
+	z.avail_out = gzsize;
+	zret = deflate(&z, Z_FINISH);
+	if (zret != Z_STREAM_END) {
+		fprintf(stderr, "Error from zlib's deflate: %s\n",
+				(z.msg == NULL) ? "unknown" : z.msg);
+		(void)deflateEnd(&z);
+		free(gz);
+		return RET_ERROR;
+	}
+	*gzlen_p = gzsize - z.avail_out;
+	(void)deflateEnd(&z);
+	*gz_p = gz;
+	return RET_OK;
+}
+
+/* write a new <relfilename>.diff/<prefix><date>.gz.new and put it first into
+ * root_p. (from is for the caller to fill in) */
+static retvalue write_patch(struct pdiff_patch **root_p, const char *dirofdist, const char *relfilename, /*@null@*/const char *prefix, const char date[DATELEN+1], const struct modification *m) {
+	struct membuffer text;
+	struct pdiff_patch *p;
+	unsigned char *gz = NULL;
+	size_t gzlen = 0;
+	retvalue r;
+
+	setzero(struct membuffer, &text);
+	modification_printaspatch(&text, m, membuffer_write);
+	if (text.failed) {
+		free(text.data);
+		return RET_ERROR_OOM;
+	}
+	p = zNEW(struct pdiff_patch);
+	if (FAILEDTOALLOC(p)) {
+		free(text.data);
+		return RET_ERROR_OOM;
+	}
+	p->name = mprintf("%s%s", (prefix == NULL) ? "" : prefix, date);
+	if (FAILEDTOALLOC(p->name)) {
+		free(text.data);
+		patches_free(p);
+		return RET_ERROR_OOM;
+	}
+	r = checksums_ofdata(&p->patch, text.data, text.len);
+	if (RET_IS_OK(r))
+		r = gzip_data(&text, &gz, &gzlen);
+	free(text.data);
+	if (RET_WAS_ERROR(r)) {
+		patches_free(p);
+		return r;
+	}
+	r = checksums_ofdata(&p->download, gz, gzlen);
+	if (RET_IS_OK(r)) {
+		p->tmpfilename = mprintf("%s/%s.diff/%s.gz.new",
+				dirofdist, relfilename, p->name);
+		if (FAILEDTOALLOC(p->tmpfilename))
+			r = RET_ERROR_OOM;
+	}
+	if (RET_IS_OK(r)) {
+		r = writetofile(p->tmpfilename, gz, gzlen);
+		if (RET_WAS_ERROR(r)) {
+			free(p->tmpfilename);
+			p->tmpfilename = NULL;
+		}
+	}
+	free(gz);
+	if (RET_WAS_ERROR(r)) {
+		patches_free(p);
+		return r;
+	}
+	p->next = *root_p;
+	*root_p = p;
+	return RET_OK;
+}
+
+static retvalue read_old_patch(const char *dirofdist, const char *relfilename, const struct pdiff_patch *o, /*@out@*/struct rred_patch **rred_p) {
+	char *filename, *data;
+	size_t len;
+	struct checksums *checksums;
+	retvalue r;
+
+	filename = mprintf("%s/%s.diff/%s.gz", dirofdist, relfilename, o->name);
+	if (FAILEDTOALLOC(filename))
+		return RET_ERROR_OOM;
+	if (!isregularfile(filename)) {
+		free(filename);
+		return RET_NOTHING;
+	}
+	r = readwholefile(filename, c_gzip, &data, &len);
+	if (RET_WAS_ERROR(r)) {
+		free(filename);
+		return r;
+	}
+	r = checksums_ofdata(&checksums, data, len);
+	if (RET_IS_OK(r)) {
+		if (!samechecksums(checksums, o->patch)) {
+			fprintf(stderr,
+"Ignoring '%s' as it does not match the Index file.\n", filename);
+			r = RET_NOTHING;
+		}
+		checksums_free(checksums);
+	}
+	if (!RET_IS_OK(r)) {
+		free(data);
+		free(filename);
+		return r;
+	}
+	r = patch_loaddata(filename, data, len, rred_p);
+	free(filename);
+	return r;
+}
+
+/**** the interface for exports.c ****/
+
+retvalue pdiff_start(struct release *release, const char *relfilename, struct pdiff **pdiff_p) {
+	struct pdiff *pdiff;
+	enum compression c;
+	char *filename = NULL;
+	retvalue r;
+
+	/* use whatever form of the old file is easiest to read */
+	for (c = c_none ; c < c_COUNT ; c++) {
+		if (c != c_none && !uncompression_builtin(c))
+			continue;
+		filename = mprintf("%s/%s%s", release_dirofdist(release),
+				relfilename, uncompression_suffix[c]);
+		if (FAILEDTOALLOC(filename))
+			return RET_ERROR_OOM;
+		if (isregularfile(filename))
+			break;
+		free(filename);
+		filename = NULL;
+	}
+	if (filename == NULL) {
+		r = remove_old_diffs(release, relfilename, NULL);
+		if (RET_WAS_ERROR(r))
+			return r;
+		return RET_NOTHING;
+	}
+	pdiff = zNEW(struct pdiff);
+	if (FAILEDTOALLOC(pdiff)) {
+		free(filename);
+		return RET_ERROR_OOM;
+	}
+	pdiff->state = RET_OK;
+	pdiff->relfilename = strdup(relfilename);
+	if (FAILEDTOALLOC(pdiff->relfilename)) {
+		free(filename);
+		pdiff_abort(pdiff);
+		return RET_ERROR_OOM;
+	}
+	r = readwholefile(filename, c, &pdiff->olddata, &pdiff->oldlen);
+	free(filename);
+	if (RET_WAS_ERROR(r)) {
+		pdiff_abort(pdiff);
+		return r;
+	}
+	/* most of the time the new file will be similar big */
+	pdiff->newsize = pdiff->oldlen + pdiff->oldlen / 8 + 4096;
+	pdiff->newdata = malloc(pdiff->newsize);
+	if (FAILEDTOALLOC(pdiff->newdata)) {
+		pdiff_abort(pdiff);
+		return RET_ERROR_OOM;
+	}
+	*pdiff_p = pdiff;
+	return RET_OK;
+}
+
+retvalue pdiff_writedata(struct pdiff *pdiff, const char *data, size_t len) {
+	if (RET_WAS_ERROR(pdiff->state))
+		return pdiff->state;
+	if (pdiff->newsize - pdiff->newlen < len) {
+		size_t newsize = pdiff->newsize * 2 + len;
+		char *h = realloc(pdiff->newdata, newsize);
+
+		if (FAILEDTOALLOC(h)) {
+			pdiff->state = RET_ERROR_OOM;
+			return RET_ERROR_OOM;
+		}
+		pdiff->newdata = h;
+		pdiff->newsize = newsize;
+	}
+	memcpy(pdiff->newdata + pdiff->newlen, data, len);
+	pdiff->newlen += len;
+	return RET_OK;
+}
+
+void pdiff_abort(struct pdiff *pdiff) {
+	if (pdiff == NULL)
+		return;
+	free(pdiff->relfilename);
+	free(pdiff->olddata);
+	free(pdiff->newdata);
+	free(pdiff);
+}
+
+/* tell the release about the patch files (moving new ones in place),
+ * so they are also available by-hash but not listed in Release */
+static retvalue publish_patches(struct release *release, const char *relfilename, const struct pdiff_patch *first) {
+	const struct pdiff_patch *p;
+	retvalue r;
+
+	for (p = first ; p != NULL ; p = p->next) {
+		char *tmpfilename = NULL, *filename;
+		struct checksums *download = NULL;
+
+		filename = mprintf("%s.diff/%s.gz", relfilename, p->name);
+		if (FAILEDTOALLOC(filename))
+			return RET_ERROR_OOM;
+		if (p->tmpfilename != NULL) {
+			tmpfilename = mprintf("%s.new", filename);
+			if (FAILEDTOALLOC(tmpfilename)) {
+				free(filename);
+				return RET_ERROR_OOM;
+			}
+		}
+		if (p->download != NULL) {
+			download = checksums_dup(p->download);
+			if (FAILEDTOALLOC(download)) {
+				free(tmpfilename);
+				free(filename);
+				return RET_ERROR_OOM;
+			}
+		}
+		if (download != NULL)
+			r = release_addunlisted(release, tmpfilename,
+					filename, download);
+		else if (tmpfilename != NULL)
+			r = release_addsilentnew(release, tmpfilename,
+					filename);
+		else {
+			free(filename);
+			r = RET_NOTHING;
+		}
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+/* keep the old patches if the Index is valid for the (unchanged) file */
+static retvalue keep_diffs(struct release *release, const char *relfilename, /*@null@*/const struct checksums *current) {
+	struct pdiff_index index;
+	char *indexfilename;
+	retvalue r;
+	bool valid;
+
+	r = read_index(release_dirofdist(release), relfilename, &index);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (r == RET_NOTHING)
+		return remove_old_diffs(release, relfilename, NULL);
+	/* a kept file was recorded with the checksums of its uncompressed
+	 * content, even if only compressed forms are exported */
+	if (current == NULL)
+		current = release_getchecksums(release, relfilename);
+	valid = current != NULL && samechecksums(index.current, current);
+	if (!valid) {
+		index_done(&index);
+		return remove_old_diffs(release, relfilename, NULL);
+	}
+	r = remove_old_diffs(release, relfilename, index.first);
+	if (!RET_WAS_ERROR(r))
+		r = publish_patches(release, relfilename, index.first);
+	index_done(&index);
+	if (RET_WAS_ERROR(r))
+		return r;
+	indexfilename = mprintf("%s.diff/Index", relfilename);
+	if (FAILEDTOALLOC(indexfilename))
+		return RET_ERROR_OOM;
+	return release_addold(release, indexfilename);
+}
+
+retvalue pdiff_keep(struct release *release, const char *relfilename) {
+	return keep_diffs(release, relfilename, NULL);
+}
+
+static retvalue generate_diffs(struct release *release, struct pdiff *pdiff, const struct checksums *oldchecksums, const struct checksums *newchecksums) {
+	const char *dirofdist = release_dirofdist(release);
+	const char *relfilename = pdiff->relfilename;
+	char date[DATELEN + 1], *diffdir;
+	struct pdiff_index index;
+	struct pdiff_patch *root = NULL, *o, *p;
+	struct lines oldlines, newlines;
+	struct modification *new_modifications = NULL, *newdup;
+	int patch_count;
+	off_t newlen = pdiff->newlen;
+	retvalue r;
+
+	r = get_date_string(date, sizeof(date));
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = read_index(dirofdist, relfilename, &index);
+	if (RET_WAS_ERROR(r))
+		return r;
+	/* ignore old Index file if it does not match the old file */
+	if (RET_IS_OK(r) && !samechecksums(index.current, oldchecksums))
+		index_done(&index);
+
+	diffdir = mprintf("%s.diff", relfilename);
+	if (FAILEDTOALLOC(diffdir)) {
+		index_done(&index);
+		return RET_ERROR_OOM;
+	}
+	r = release_mkdir(release, diffdir);
+	free(diffdir);
+	if (RET_WAS_ERROR(r)) {
+		index_done(&index);
+		return r;
+	}
+
+#ifdef APT_545699_WORKAROUND
+	/* create a fake diff to work around http://bugs.debian.org/545699 */
+	newdup = NULL;
+	r = modification_addstuffdata(pdiff->newdata, pdiff->newlen, &newdup);
+	if (RET_IS_OK(r))
+		r = write_patch(&root, dirofdist, relfilename,
+				"aptbug545699+", date, newdup);
+	modification_freelist(newdup);
+	if (RET_IS_OK(r)) {
+		root->from = checksums_dup(newchecksums);
+		if (FAILEDTOALLOC(root->from))
+			r = RET_ERROR_OOM;
+	}
+	if (RET_WAS_ERROR(r)) {
+		patches_free(root);
+		index_done(&index);
+		return r;
+	}
+#endif
+
+	r = lines_init(&oldlines, pdiff->olddata, pdiff->oldlen);
+	if (RET_IS_OK(r)) {
+		r = lines_init(&newlines, pdiff->newdata, pdiff->newlen);
+		if (RET_IS_OK(r)) {
+			r = diff_files(&oldlines, &newlines,
+					&new_modifications);
+			lines_done(&newlines);
+		}
+		lines_done(&oldlines);
+	}
+	if (RET_WAS_ERROR(r)) {
+		patches_free(root);
+		index_done(&index);
+		return r;
+	}
+	assert (new_modifications != NULL);
+
+#ifdef APT_545694_WORKAROUND
+	newdup = modification_dup(new_modifications);
+	if (FAILEDTOALLOC(newdup))
+		r = RET_ERROR_OOM;
+	else
+		r = modification_addstuffdata(pdiff->newdata, pdiff->newlen,
+				&newdup);
+	if (!RET_WAS_ERROR(r))
+		r = write_patch(&root, dirofdist, relfilename, NULL, date,
+				newdup);
+	modification_freelist(newdup);
+#else
+	r = write_patch(&root, dirofdist, relfilename, NULL, date,
+			new_modifications);
+#endif
+	if (RET_IS_OK(r)) {
+		root->from = checksums_dup(oldchecksums);
+		if (FAILEDTOALLOC(root->from))
+			r = RET_ERROR_OOM;
+	}
+	if (RET_WAS_ERROR(r)) {
+		modification_freelist(new_modifications);
+		patches_free(root);
+		index_done(&index);
+		return r;
+	}
+
+	/* if the diff is bigger than the new file, there is no point in
+	 * not getting the full file. And merged older patches will most
+	 * likely be even bigger, so remove all. */
+	if (checksums_getfilesize(root->patch) > newlen) {
+		modification_freelist(new_modifications);
+		patches_free(root);
+		index_done(&index);
+		return remove_old_diffs(release, relfilename, NULL);
+	}
+
+	patch_count = 1;
+	/* merge this into the old patches */
+	for (o = index.last ; o != NULL ; o = o->prev) {
+		struct rred_patch *old_rred_patch;
+		struct modification *merged;
+
+		/* ignore patches from the old or the new state, to filter
+		 * out old pseudo-empty patches and to reduce the number of
+		 * patches in case the file is reverted to an earlier state */
+		if (samechecksums(o->from, index.current) ||
+				samechecksums(o->from, newchecksums))
+			continue;
+		if (patch_count >= PDIFF_MAXPATCHES)
+			continue;
+		/* empty files only make problems. */
+		if (checksums_getfilesize(o->from) == 0)
+			continue;
+
+		r = read_old_patch(dirofdist, relfilename, o, &old_rred_patch);
+		if (r == RET_NOTHING)
+			continue;
+		if (RET_WAS_ERROR(r))
+			break;
+
+		newdup = modification_dup(new_modifications);
+		if (FAILEDTOALLOC(newdup)) {
+			patch_free(old_rred_patch);
+			r = RET_ERROR_OOM;
+			break;
+		}
+		r = combine_patches(&merged,
+				patch_getmodifications(old_rred_patch), newdup);
+		if (RET_WAS_ERROR(r)) {
+			patch_free(old_rred_patch);
+			break;
+		}
+		if (merged == NULL) {
+			/* this should never happen as the checksums should
+			 * already be the same, but better safe than sorry */
+			patch_free(old_rred_patch);
+			continue;
+		}
+#ifdef APT_545694_WORKAROUND
+		r = modification_addstuffdata(pdiff->newdata, pdiff->newlen,
+				&merged);
+		if (!RET_WAS_ERROR(r))
+#endif
+			r = write_patch(&root, dirofdist, relfilename,
+					o->nameprefix, date, merged);
+		modification_freelist(merged);
+		patch_free(old_rred_patch);
+		if (RET_WAS_ERROR(r))
+			break;
+		root->from = checksums_dup(o->from);
+		if (FAILEDTOALLOC(root->from)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		/* remove patches that are bigger than the new file */
+		if (checksums_getfilesize(root->patch) >= newlen) {
+			p = root;
+			root = p->next;
+			p->next = NULL;
+			patches_free(p);
+		}
+		patch_count++;
+	}
+	modification_freelist(new_modifications);
+	index_done(&index);
+	if (RET_WAS_ERROR(r)) {
+		patches_free(root);
+		return r;
+	}
+	r = write_index(release, relfilename, newchecksums, root);
+	/* tell the release to remove all no longer needed files */
+	if (!RET_WAS_ERROR(r))
+		r = remove_old_diffs(release, relfilename, root);
+	/* and to move the new ones in place (but not list them) */
+	if (!RET_WAS_ERROR(r))
+		r = publish_patches(release, relfilename, root);
+	if (!RET_WAS_ERROR(r)) {
+		/* the release deletes them now if not used */
+		for (p = root ; p != NULL ; p = p->next) {
+			free(p->tmpfilename);
+			p->tmpfilename = NULL;
+		}
+	}
+	patches_free(root);
+	return r;
+}
+
+retvalue pdiff_finish(struct release *release, struct pdiff *pdiff) {
+	struct checksums *oldchecksums, *newchecksums;
+	retvalue r;
+
+	if (RET_WAS_ERROR(pdiff->state)) {
+		r = pdiff->state;
+		pdiff_abort(pdiff);
+		return r;
+	}
+	r = checksums_ofdata(&oldchecksums, pdiff->olddata, pdiff->oldlen);
+	if (RET_WAS_ERROR(r)) {
+		pdiff_abort(pdiff);
+		return r;
+	}
+	r = checksums_ofdata(&newchecksums, pdiff->newdata, pdiff->newlen);
+	if (RET_WAS_ERROR(r)) {
+		checksums_free(oldchecksums);
+		pdiff_abort(pdiff);
+		return r;
+	}
+	if (samechecksums(oldchecksums, newchecksums))
+		/* nothing changed */
+		r = keep_diffs(release, pdiff->relfilename, oldchecksums);
+	else if (pdiff->oldlen == 0 || pdiff->newlen == 0 ||
+			pdiff->olddata[pdiff->oldlen - 1] != '\n')
+		/* nothing patches can be made from or to */
+		r = remove_old_diffs(release, pdiff->relfilename, NULL);
+	else
+		r = generate_diffs(release, pdiff, oldchecksums, newchecksums);
+	checksums_free(oldchecksums);
+	checksums_free(newchecksums);
+	pdiff_abort(pdiff);
+	return r;
+}
@@ -0,0 +1,30 @@
+#ifndef REPREPRO_PDIFF_H
+#define REPREPRO_PDIFF_H
+
+#ifndef REPREPRO_ERROR_H
+#include "error.h"
+#warning "What's hapening here?"
+#endif
+#ifndef REPREPRO_RELEASE_H
+#include "release.h"
+#endif
+
+/* Maintain <indexfile>.diff/ directories (ed style patches and their
+ * Index for apt) while exporting, instead of calling rredtool as hook */
+
+struct pdiff;
+
+/* Start generating patches for an index file about to be replaced.
+ * (reads the old file, if there is none RET_NOTHING is returned and
+ * all old patches are marked for deletion) */
+retvalue pdiff_start(struct release *, const char * /*relfilename*/, /*@out@*/struct pdiff **);
+/* errors will be cached for pdiff_finish */
+retvalue pdiff_writedata(struct pdiff *, const char *, size_t);
+void pdiff_abort(/*@only@*/struct pdiff *);
+/* compare with the old file, merge the new patch into the old ones and
+ * tell the release about the new Index and the patch files */
+retvalue pdiff_finish(struct release *, /*@only@*/struct pdiff *);
+/* the index file was not regenerated, keep the patches if still valid */
+retvalue pdiff_keep(struct release *, const char * /*relfilename*/);
+
+#endif
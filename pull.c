@@ -60,6 +60,8 @@ struct pull_rule {
 	//e.g. "UDebComponents: main" // (not set means all)
 	struct atomlist udebcomponents;
 	bool udebcomponents_set;
+	/* the same as sets, only set after _loadsourcedistributions */
+	struct atomset componentset, udebcomponentset;
 	// We don't have equivalents for ddebs yet since we don't know
 	// what the Debian archive layout is going to look like
 	// NULL means no condition
@@ -80,6 +82,8 @@ static void pull_rule_free(/*@only@*/struct pull_rule *pull) {
 	atomlist_done(&pull->architectures_into);
 	atomlist_done(&pull->components);
 	atomlist_done(&pull->udebcomponents);
+	atomset_done(&pull->componentset);
+	atomset_done(&pull->udebcomponentset);
 	term_free(pull->includecondition);
 	filterlist_release(&pull->filterlist);
 	filterlist_release(&pull->filtersrclist);
@@ -255,9 +259,21 @@ static retvalue pull_init(struct pull_distribution **pulls,
 static retvalue pull_loadsourcedistributions(struct distribution *alldistributions, struct pull_rule *rules) {
 	struct pull_rule *rule;
 	struct distribution *d;
+	retvalue r;
 
 	for (rule = rules ; rule != NULL ; rule = rule->next) {
-		if (rule->used && rule->distribution == NULL) {
+		if (!rule->used)
+			continue;
+		atomset_done(&rule->componentset);
+		atomset_done(&rule->udebcomponentset);
+		r = atomset_fromlist(&rule->componentset, &rule->components);
+		if (RET_WAS_ERROR(r))
+			return r;
+		r = atomset_fromlist(&rule->udebcomponentset,
+				&rule->udebcomponents);
+		if (RET_WAS_ERROR(r))
+			return r;
+		if (rule->distribution == NULL) {
 			for (d = alldistributions ; d != NULL ; d = d->next) {
 				if (strcmp(d->codename, rule->from) == 0) {
 					rule->distribution = d;
@@ -309,7 +325,7 @@ static void pull_freetargets(struct pull_target *targets) {
 static retvalue pull_createsource(struct pull_rule *rule,
 		struct target *target,
 		struct pull_source ***s) {
-	const struct atomlist *c;
+	const struct atomset *c;
 	const struct atomlist *a_from, *a_into;
 	int ai;
 
@@ -325,17 +341,17 @@ static retvalue pull_createsource(struct pull_rule *rule,
 	}
 	if (target->packagetype == pt_udeb)  {
 		if (rule->udebcomponents_set)
-			c = &rule->udebcomponents;
+			c = &rule->udebcomponentset;
 		else
-			c = &rule->distribution->udebcomponents;
+			c = &rule->distribution->udebcomponentset;
 	} else {
 		if (rule->components_set)
-			c = &rule->components;
+			c = &rule->componentset;
 		else
-			c = &rule->distribution->components;
+			c = &rule->distribution->componentset;
 	}
 
-	if (!atomlist_in(c, target->component))
+	if (!atomset_in(c, target->component))
 		return RET_NOTHING;
 
 	for (ai = 0 ; ai < a_into->count ; ai++) {
@@ -429,182 +445,111 @@ static retvalue pull_generatetargets(struct pull_distribution *pull_distribution
  * Some checking to be able to warn against typos                          *
  **************************************************************************/
 
-static bool *preparefoundlist(const struct atomlist *list) {
-	bool *found;
-	int i, j;
-
-	found = nzNEW(list->count, bool);
-	if (FAILEDTOALLOC(found))
-		return found;
-	for (i = 0 ; i < list->count ; i++) {
-		if (found[i])
-			continue;
-		for (j = i + 1 ; j < list->count ; j++)
-			if (list->atoms[i] == list->atoms[j])
-				found[j] = true;
-	}
-	return found;
+static const struct atomset *architecturesof(const struct distribution *d) {
+	return &d->architectureset;
 }
-
-
-static inline void markasused(const struct strlist *pulls, const char *rulename, const struct atomlist *needed, const struct atomlist *have, bool *found) {
-	int i, j, o;
-
-	for (i = 0 ; i < pulls->count ; i++) {
-		if (strcmp(pulls->values[i], rulename) != 0)
-			continue;
-		for (j = 0 ; j < have->count ; j++) {
-			o = atomlist_ofs(needed, have->atoms[j]);
-			if (o >= 0)
-				found[o] = true;
-		}
-	}
+static const struct atomset *componentsof(const struct distribution *d) {
+	return &d->componentset;
 }
-
-static void checkifarchitectureisused(const struct atomlist *architectures, const struct distribution *alldistributions, const struct pull_rule *rule, const char *action) {
-	bool *found;
-	const struct distribution *d;
-	int i;
-
-	assert (rule != NULL);
-	if (architectures->count == 0)
-		return;
-	found = preparefoundlist(architectures);
-	if (found == NULL)
-		return;
-	for (d = alldistributions ; d != NULL ; d = d->next) {
-		markasused(&d->pulls, rule->name,
-				architectures, &d->architectures,
-				found);
-	}
-	for (i = 0 ; i < architectures->count ; i++) {
-		if (found[i])
-			continue;
-		fprintf(stderr,
-"Warning: pull rule '%s' wants to %s architecture '%s',\n"
-"but no distribution using this has such an architecture.\n"
-"(This will simply be ignored and is not even checked when using --fast).\n",
-				rule->name, action,
-				atoms_architectures[architectures->atoms[i]]);
-	}
-	free(found);
-	return;
+static const struct atomset *udebcomponentsof(const struct distribution *d) {
+	return &d->udebcomponentset;
 }
 
-static void checkifcomponentisused(const struct atomlist *components, const struct distribution *alldistributions, const struct pull_rule *rule, const char *action) {
-	bool *found;
+static void checkifused(const struct atomlist *needed, const struct distribution *alldistributions, const struct pull_rule *rule, const char *action, const char *what, const char **atoms, const struct atomset *(*setof)(const struct distribution *)) {
+	struct atomset found, warned;
 	const struct distribution *d;
 	int i;
 
 	assert (rule != NULL);
-	if (components->count == 0)
-		return;
-	found = preparefoundlist(components);
-	if (found == NULL)
+	if (needed->count == 0)
 		return;
+	atomset_init(&found);
+	atomset_init(&warned);
 	for (d = alldistributions ; d != NULL ; d = d->next) {
-		markasused(&d->pulls, rule->name,
-				components, &d->components,
-				found);
-	}
-	for (i = 0 ; i < components->count ; i++) {
-		if (found[i])
+		if (!strlist_in(&d->pulls, rule->name))
 			continue;
-		fprintf(stderr,
-"Warning: pull rule '%s' wants to %s component '%s',\n"
-"but no distribution using this has such an component.\n"
-"(This will simply be ignored and is not even checked when using --fast).\n",
-				rule->name, action,
-				atoms_components[components->atoms[i]]);
+		if (RET_WAS_ERROR(atomset_union(&found, setof(d))))
+			goto done;
 	}
-	free(found);
-	return;
-}
-
-static void checkifudebcomponentisused(const struct atomlist *udebcomponents, const struct distribution *alldistributions, const struct pull_rule *rule, const char *action) {
-	bool *found;
-	const struct distribution *d;
-	int i;
+	for (i = 0 ; i < needed->count ; i++) {
+		atom_t atom = needed->atoms[i];
 
-	assert (rule != NULL);
-	if (udebcomponents->count == 0)
-		return;
-	found = preparefoundlist(udebcomponents);
-	if (found == NULL)
-		return;
-	for (d = alldistributions ; d != NULL ; d = d->next) {
-		markasused(&d->pulls, rule->name,
-				udebcomponents, &d->udebcomponents,
-				found);
-	}
-	for (i = 0 ; i < udebcomponents->count ; i++) {
-		if (found[i])
+		if (atomset_in(&found, atom) || atomset_in(&warned, atom))
 			continue;
+		if (RET_WAS_ERROR(atomset_add(&warned, atom)))
+			break;
 		fprintf(stderr,
-"Warning: pull rule '%s' wants to %s udeb component '%s',\n"
-"but no distribution using this has such an udeb component.\n"
+"Warning: pull rule '%s' wants to %s %s '%s',\n"
+"but no distribution using this has such an %s.\n"
 "(This will simply be ignored and is not even checked when using --fast).\n",
-				rule->name, action,
-				atoms_components[udebcomponents->atoms[i]]);
+				rule->name, action, what,
+				atoms[atom], what);
 	}
-	free(found);
-	return;
+done:
+	atomset_done(&found);
+	atomset_done(&warned);
 }
 
-static void checksubset(const struct atomlist *needed, const struct atomlist *have, const char *rulename, const char *from, const char *what, const char **atoms) {
-	int i, j;
+static void checksubset(const struct atomlist *needed, const struct atomset *have, const char *rulename, const char *from, const char *what, const char **atoms) {
+	struct atomset warned;
+	int i;
 
+	atomset_init(&warned);
 	for (i = 0 ; i < needed->count ; i++) {
 		atom_t value = needed->atoms[i];
 
-		for (j = 0 ; j < i ; j++) {
-			if (value == needed->atoms[j])
-				break;
-		}
-		if (j < i)
+		if (atomset_in(have, value) || atomset_in(&warned, value))
 			continue;
-
-		if (!atomlist_in(have, value)) {
-			fprintf(stderr,
+		if (RET_WAS_ERROR(atomset_add(&warned, value)))
+			break;
+		fprintf(stderr,
 "Warning: pull rule '%s' wants to get something from %s '%s',\n"
 "but there is no such %s in distribution '%s'.\n"
 "(This will simply be ignored and is not even checked when using --fast).\n",
-					rulename, what,
-					atoms[value], what, from);
-		}
+				rulename, what,
+				atoms[value], what, from);
 	}
+	atomset_done(&warned);
 }
 
 static void searchunused(const struct distribution *alldistributions, const struct pull_rule *rule) {
 	if (rule->distribution != NULL) {
 		// TODO: move this part of the checks into parsing?
 		checksubset(&rule->architectures_from,
-				&rule->distribution->architectures,
+				&rule->distribution->architectureset,
 				rule->name, rule->from, "architecture",
 				atoms_architectures);
 		checksubset(&rule->components,
-				&rule->distribution->components,
+				&rule->distribution->componentset,
 				rule->name, rule->from, "component",
 				atoms_components);
 		checksubset(&rule->udebcomponents,
-				&rule->distribution->udebcomponents,
+				&rule->distribution->udebcomponentset,
 				rule->name, rule->from, "udeb component",
 				atoms_components);
 	}
 
 	if (rule->distribution == NULL) {
 		assert (strcmp(rule->from, "*") == 0);
-		checkifarchitectureisused(&rule->architectures_from,
-				alldistributions, rule, "get something from");
+		checkifused(&rule->architectures_from,
+				alldistributions, rule, "get something from",
+				"architecture", atoms_architectures,
+				architecturesof);
 		/* no need to check component and udebcomponent, as those
 		 * are the same with the others */
 	}
-	checkifarchitectureisused(&rule->architectures_into,
-			alldistributions, rule, "put something into");
-	checkifcomponentisused(&rule->components,
-			alldistributions, rule, "put something into");
-	checkifudebcomponentisused(&rule->udebcomponents,
-			alldistributions, rule, "put something into");
+	checkifused(&rule->architectures_into,
+			alldistributions, rule, "put something into",
+			"architecture", atoms_architectures,
+			architecturesof);
+	checkifused(&rule->components,
+			alldistributions, rule, "put something into",
+			"component", atoms_components,
+			componentsof);
+	checkifused(&rule->udebcomponents,
+			alldistributions, rule, "put something into",
+			"udeb component", atoms_components,
+			udebcomponentsof);
 }
 
 static void pull_searchunused(const struct distribution *alldistributions, struct pull_rule *pull_rules) {
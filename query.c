@@ -0,0 +1,99 @@
+/*  This file is part of "reprepro"
+ *  Copyright (C) 2026 agent
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License version 2 as
+ *  published by the Free Software Foundation.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02111-1301  USA
+ */
+#include <config.h>
+
+#include <errno.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "error.h"
+#include "database.h"
+#include "target.h"
+#include "jobs.h"
+#include "query.h"
+
+/* Every target has its own tables in the database, so they can be
+ * opened and read by different threads at the same time. (Only the
+ * database environment is shared, which is opened with DB_THREAD). */
+
+void queryplan_done(struct queryplan *plan) {
+	free(plan->items);
+	plan->items = NULL;
+	plan->count = 0;
+	plan->size = 0;
+}
+
+retvalue queryplan_add(struct queryplan *plan, struct target *target, void *data) {
+	if (plan->count >= plan->size) {
+		size_t newsize = plan->size + 16;
+		struct queryitem *n;
+
+		n = realloc(plan->items, newsize * sizeof(struct queryitem));
+		if (FAILEDTOALLOC(n))
+			return RET_ERROR_OOM;
+		plan->items = n;
+		plan->size = newsize;
+	}
+	plan->items[plan->count].target = target;
+	plan->items[plan->count].data = data;
+	plan->count++;
+	return RET_OK;
+}
+
+struct queryrun {
+	const struct queryplan *plan;
+	query_action *action;
+	void *privdata;
+};
+
+static retvalue query_job(void *p, size_t i) {
+	struct queryrun *run = p;
+	struct target *target;
+	retvalue r, r2;
+
+	target = run->plan->items[i].target;
+	r = target_initpackagesdb(target, READONLY);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = run->action(target, run->privdata, i);
+	r2 = target_closepackagesdb(target);
+	RET_ENDUPDATE(r, r2);
+	return r;
+}
+
+retvalue query_run(const struct queryplan *plan, query_action *action, void *privdata) {
+	struct queryrun run;
+	retvalue result, r;
+
+	if (plan->count == 0)
+		return RET_NOTHING;
+
+	/* opening a packages database might have to convert the
+	 * whole database from an older format first, which may
+	 * not happen while other threads have it open */
+	result = database_preparepackages();
+	if (RET_WAS_ERROR(result))
+		return result;
+
+	run.plan = plan;
+	run.action = action;
+	run.privdata = privdata;
+	r = jobs_run(plan->count, query_job, &run);
+	RET_UPDATE(result, r);
+	return result;
+}
@@ -0,0 +1,40 @@
+#ifndef REPREPRO_QUERY_H
+#define REPREPRO_QUERY_H
+
+#ifndef REPREPRO_ERROR_H
+#include "error.h"
+#warning "What's hapening here?"
+#endif
+#ifndef REPREPRO_TARGET_H
+#include "target.h"
+#endif
+
+/* Read-only queries over the package tables of many targets (also
+ * of different distributions): first collect the targets to look at
+ * in a queryplan, in the order the results are wanted, then let
+ * query_run look at all of them (in parallel if --jobs allows) and
+ * merge the results per target in that order afterwards. */
+
+struct queryplan {
+	size_t count, size;
+	struct queryitem {
+		/*@dependent@*/struct target *target;
+		/* for the caller to know where to merge the results */
+		/*@dependent@*/void *data;
+	} *items;
+};
+
+static inline void queryplan_init(/*@out@*/struct queryplan *plan) {
+	plan->count = 0;
+	plan->size = 0;
+	plan->items = NULL;
+}
+void queryplan_done(struct queryplan *);
+retvalue queryplan_add(struct queryplan *, struct target *, /*@dependent@*/void *);
+
+/* called with the packages database of the target opened read-only,
+ * may only change data belonging to this target (i.e. to i) */
+typedef retvalue query_action(struct target *, void * /*privdata*/, size_t /*i*/);
+retvalue query_run(const struct queryplan *, query_action *, void * /*privdata*/);
+
+#endif
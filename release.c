@@ -28,6 +28,7 @@
 #include <ctype.h>
 #include <fcntl.h>
 #include <time.h>
+#include <dirent.h>
 #include <zlib.h>
 #ifdef HAVE_LIBBZ2
 #include <bzlib.h>
@@ -76,6 +77,8 @@ struct release {
 		char *fullfinalfilename;
 		char *fulltemporaryfilename;
 		char *symlinktarget;
+		/* has checksums only for by-hash, not to be put in Release */
+		bool unlisted;
 		/* name chks NULL NULL NULL: add old filename or virtual file
 		 * name chks file file NULL: rename new file and publish
 		 * name NULL file file NULL: rename new file
@@ -85,6 +88,12 @@ struct release {
 	/* the Release file in preperation
 	 * (only valid between _prepare and _finish) */
 	struct signedfile *signedfile;
+	/* where it is written to and how it is to be signed
+	 * (only valid while signedfile is not yet signed) */
+	struct release_entry *plainentry, *signedentry, *detachedentry;
+	/*@dependent@*/const struct strlist *signwith;
+	/* the result of signing it, once that is done */
+	retvalue signresult;
 	/* the cache database for old files */
 	struct table *cachedb;
 };
@@ -123,11 +132,24 @@ const char *release_dirofdist(struct release *release) {
 	return release->dirofdist;
 }
 
-static retvalue newreleaseentry(struct release *release, /*@only@*/ char *relativefilename,
+/* the checksums already recorded for a file (e.g. from the cache) */
+const struct checksums *release_getchecksums(const struct release *release, const char *relfilename) {
+	const struct release_entry *e;
+
+	for (e = release->files ; e != NULL ; e = e->next) {
+		if (e->relativefilename != NULL && e->checksums != NULL &&
+		    strcmp(e->relativefilename, relfilename) == 0)
+			return e->checksums;
+	}
+	return NULL;
+}
+
+static retvalue addreleaseentry(struct release *release, /*@only@*/ char *relativefilename,
 		/*@only@*/ struct checksums *checksums,
 		/*@only@*/ /*@null@*/ char *fullfinalfilename,
 		/*@only@*/ /*@null@*/ char *fulltemporaryfilename,
-		/*@only@*/ /*@null@*/ char *symlinktarget) {
+		/*@only@*/ /*@null@*/ char *symlinktarget,
+		bool unlisted) {
 	struct release_entry *n, *p;
 
 	/* everything has a relative name */
@@ -159,6 +181,7 @@ static retvalue newreleaseentry(struct release *release, /*@only@*/ char *relati
 	n->fullfinalfilename = fullfinalfilename;
 	n->fulltemporaryfilename = fulltemporaryfilename;
 	n->symlinktarget = symlinktarget;
+	n->unlisted = unlisted;
 	if (release->files == NULL)
 		release->files = n;
 	else {
@@ -170,6 +193,16 @@ static retvalue newreleaseentry(struct release *release, /*@only@*/ char *relati
 	return RET_OK;
 }
 
+static inline retvalue newreleaseentry(struct release *release, /*@only@*/ char *relativefilename,
+		/*@only@*/ struct checksums *checksums,
+		/*@only@*/ /*@null@*/ char *fullfinalfilename,
+		/*@only@*/ /*@null@*/ char *fulltemporaryfilename,
+		/*@only@*/ /*@null@*/ char *symlinktarget) {
+	return addreleaseentry(release, relativefilename, checksums,
+			fullfinalfilename, fulltemporaryfilename,
+			symlinktarget, false);
+}
+
 retvalue release_init(struct release **release, const char *codename, const char *suite, const char *fakecomponentprefix) {
 	struct release *n;
 	size_t len, suitelen, codenamelen;
@@ -349,6 +382,29 @@ retvalue release_addold(struct release *release, /*@only@*/char *relfilename) {
 			checksums, NULL, NULL, NULL);
 }
 
+/* a file not listed in the Release file, but to be available by-hash, too
+ * (if reltmpfile is not NULL, it is first to be moved in place) */
+retvalue release_addunlisted(struct release *release, /*@only@*//*@null@*/char *reltmpfile, /*@only@*/char *relfilename, /*@only@*/struct checksums *checksums) {
+	char *filename = NULL, *finalfilename = NULL;
+
+	if (reltmpfile != NULL) {
+		filename = calc_dirconcat(release->dirofdist, reltmpfile);
+		free(reltmpfile);
+		finalfilename = calc_dirconcat(release->dirofdist,
+				relfilename);
+		if (FAILEDTOALLOC(filename) || FAILEDTOALLOC(finalfilename)) {
+			free(filename);
+			free(finalfilename);
+			free(relfilename);
+			checksums_free(checksums);
+			return RET_ERROR_OOM;
+		}
+		release->new = true;
+	}
+	return addreleaseentry(release, relfilename,
+			checksums, finalfilename, filename, NULL, true);
+}
+
 static retvalue release_addsymlink(struct release *release, /*@only@*/char *relfilename, /*@only@*/ char *symlinktarget) {
 	char *fullfilename;
 
@@ -1487,7 +1543,7 @@ static retvalue storechecksums(struct release *release) {
 		if (RET_WAS_ERROR(r))
 			return r;
 
-		if (file->checksums == NULL)
+		if (file->checksums == NULL || file->unlisted)
 			continue;
 
 		r = checksums_getcombined(file->checksums, &combinedchecksum, &len);
@@ -1690,6 +1746,8 @@ retvalue release_prepare(struct release *release, struct distribution *distribut
 		writestring("\nButAutomaticUpgrades: ");
 		writestring(distribution->butautomaticupgrades);
 	}
+	if (distribution->byhash)
+		writestring("\nAcquire-By-Hash: yes");
 	writechar('\n');
 
 	for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++) {
@@ -1698,7 +1756,7 @@ retvalue release_prepare(struct release *release, struct distribution *distribut
 		for (file = release->files ; file != NULL ; file = file->next) {
 			const char *hash, *size;
 			size_t hashlen, sizelen;
-			if (file->checksums == NULL)
+			if (file->checksums == NULL || file->unlisted)
 				continue;
 			if (!checksums_gethashpart(file->checksums, cs,
 					&hash, &hashlen, &size, &sizelen))
@@ -1713,17 +1771,47 @@ retvalue release_prepare(struct release *release, struct distribution *distribut
 		}
 	}
 	r = signedfile_create(release->signedfile,
-			plainentry->fulltemporaryfilename,
-			&signedentry->fulltemporaryfilename,
-			&detachedentry->fulltemporaryfilename,
-			&distribution->signwith, !global.keeptemporaries);
+			plainentry->fulltemporaryfilename);
 	if (RET_WAS_ERROR(r)) {
 		signedfile_free(release->signedfile);
 		release->signedfile = NULL;
 		return r;
 	}
-	omitunusedspecialreleaseentry(release, signedentry);
-	omitunusedspecialreleaseentry(release, detachedentry);
+	/* signing is left to release_sign, so that the Release files of
+	 * multiple distributions can be signed at the same time */
+	release->plainentry = plainentry;
+	release->signedentry = signedentry;
+	release->detachedentry = detachedentry;
+	release->signwith = &distribution->signwith;
+	release->signresult = RET_NOTHING;
+	return RET_OK;
+}
+
+/* Sign the Release file written by release_prepare (if that was not
+ * yet done). Multiple releases may be signed at the same time. */
+retvalue release_sign(struct release *release) {
+	retvalue r;
+
+	if (release->signedfile == NULL)
+		return release->signresult;
+
+	r = signedfile_sign(release->signedfile,
+			release->plainentry->fulltemporaryfilename,
+			&release->signedentry->fulltemporaryfilename,
+			&release->detachedentry->fulltemporaryfilename,
+			release->signwith, !global.keeptemporaries);
+	signedfile_free(release->signedfile);
+	release->signedfile = NULL;
+	if (RET_WAS_ERROR(r)) {
+		release->signresult = r;
+		return r;
+	}
+	omitunusedspecialreleaseentry(release, release->signedentry);
+	omitunusedspecialreleaseentry(release, release->detachedentry);
+	release->plainentry = NULL;
+	release->signedentry = NULL;
+	release->detachedentry = NULL;
+	release->signresult = RET_OK;
 	return RET_OK;
 }
 
@@ -1783,16 +1871,201 @@ static inline void release_toouthook(struct release *release, struct distributio
 	free(reldir);
 }
 
+/* the by-hash/SHA256 directory for a file (relative to the dist dir) */
+static inline char *byhashdir(const char *relativefilename) {
+	const char *slash = strrchr(relativefilename, '/');
+
+	if (slash == NULL)
+		return strdup("by-hash/SHA256");
+	return mprintf("%.*s/by-hash/SHA256",
+			(int)(slash - relativefilename), relativefilename);
+}
+
+/* make every file with checksums also available as by-hash/SHA256/<hash>
+ * in its directory (done before anything is moved in place, so that
+ * everything a new Release file lists is already there by hash) */
+static retvalue release_linkbyhash(struct release *release, /*@out@*/struct strlist *dirs, /*@out@*/struct strlist *linked) {
+	struct release_entry *file;
+	retvalue r;
+
+	strlist_init(dirs);
+	strlist_init(linked);
+	for (file = release->files ; file != NULL ; file = file->next) {
+		const char *hash, *size, *source;
+		size_t hashlen, sizelen;
+		char *reldir, *fulldir, *linkname, *fullfilename = NULL;
+
+		if (file->checksums == NULL)
+			continue;
+		if (!checksums_gethashpart(file->checksums, cs_sha256sum,
+					&hash, &hashlen, &size, &sizelen))
+			continue;
+		if (file->fulltemporaryfilename != NULL)
+			source = file->fulltemporaryfilename;
+		else if (file->fullfinalfilename != NULL)
+			source = file->fullfinalfilename;
+		else {
+			fullfilename = calc_dirconcat(release->dirofdist,
+					file->relativefilename);
+			if (FAILEDTOALLOC(fullfilename))
+				return RET_ERROR_OOM;
+			source = fullfilename;
+		}
+		/* only listed in the Release file, not really there */
+		if (!isregularfile(source)) {
+			free(fullfilename);
+			continue;
+		}
+		reldir = byhashdir(file->relativefilename);
+		if (FAILEDTOALLOC(reldir)) {
+			free(fullfilename);
+			return RET_ERROR_OOM;
+		}
+		linkname = mprintf("%s/%.*s", reldir, (int)hashlen, hash);
+		fulldir = calc_dirconcat(release->dirofdist, reldir);
+		r = strlist_adduniq(dirs, reldir);
+		if (RET_WAS_ERROR(r) || FAILEDTOALLOC(linkname)
+				|| FAILEDTOALLOC(fulldir)) {
+			free(linkname);
+			free(fulldir);
+			free(fullfilename);
+			return RET_ERROR_OOM;
+		}
+		r = dirs_make_recursive(fulldir);
+		free(fulldir);
+		if (RET_WAS_ERROR(r)) {
+			free(linkname);
+			free(fullfilename);
+			return r;
+		}
+		if (strlist_in(linked, linkname)) {
+			free(linkname);
+			free(fullfilename);
+			continue;
+		}
+		fulldir = calc_dirconcat(release->dirofdist, linkname);
+		if (FAILEDTOALLOC(fulldir)) {
+			free(linkname);
+			free(fullfilename);
+			return RET_ERROR_OOM;
+		}
+		if (link(source, fulldir) != 0 && errno != EEXIST) {
+			int e = errno;
+			fprintf(stderr, "Error %d linking '%s' to '%s': %s\n",
+					e, source, fulldir, strerror(e));
+			free(fulldir);
+			free(linkname);
+			free(fullfilename);
+			return RET_ERRNO(e);
+		}
+		free(fulldir);
+		free(fullfilename);
+		r = strlist_add(linked, linkname);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
+}
+
+/* remove files from by-hash directories no longer used by any current
+ * file for at least keep seconds. (As all by-hash files are hardlinks,
+ * a file only there has only a single link left and its ctime tells
+ * when the link count changed, i.e. when it was replaced) */
+static retvalue release_cleanbyhash(struct release *release, const struct strlist *dirs, const struct strlist *linked, unsigned long keep) {
+	time_t now;
+	int i;
+
+	(void)time(&now);
+	for (i = 0 ; i < dirs->count ; i++) {
+		const char *reldir = dirs->values[i];
+		struct dirent *ent;
+		char *fulldir;
+		DIR *dir;
+
+		fulldir = calc_dirconcat(release->dirofdist, reldir);
+		if (FAILEDTOALLOC(fulldir))
+			return RET_ERROR_OOM;
+		dir = opendir(fulldir);
+		if (dir == NULL) {
+			int e = errno;
+			fprintf(stderr, "Error %d opening directory '%s': %s\n",
+					e, fulldir, strerror(e));
+			free(fulldir);
+			return RET_ERRNO(e);
+		}
+		while ((ent = readdir(dir)) != NULL) {
+			struct stat s;
+			char *relname, *fullname;
+			bool used;
+
+			if (ent->d_name[0] == '.')
+				continue;
+			relname = calc_dirconcat(reldir, ent->d_name);
+			if (FAILEDTOALLOC(relname)) {
+				(void)closedir(dir);
+				free(fulldir);
+				return RET_ERROR_OOM;
+			}
+			used = strlist_in(linked, relname);
+			free(relname);
+			if (used)
+				continue;
+			fullname = calc_dirconcat(fulldir, ent->d_name);
+			if (FAILEDTOALLOC(fullname)) {
+				(void)closedir(dir);
+				free(fulldir);
+				return RET_ERROR_OOM;
+			}
+			if (lstat(fullname, &s) != 0 || !S_ISREG(s.st_mode)
+					|| s.st_nlink > 1
+					|| now - s.st_ctime < (time_t)keep) {
+				free(fullname);
+				continue;
+			}
+			if (verbose > 5)
+				printf("removing old by-hash file '%s'\n",
+						fullname);
+			if (unlink(fullname) != 0) {
+				int e = errno;
+				fprintf(stderr,
+"Error %d deleting %s: %s. (Will be ignored)\n",
+					e, fullname, strerror(e));
+			}
+			free(fullname);
+		}
+		(void)closedir(dir);
+		free(fulldir);
+	}
+	return RET_OK;
+}
+
 /* Generate a main "Release" file for a distribution */
 retvalue release_finish(/*@only@*/struct release *release, struct distribution *distribution) {
 	retvalue result, r;
 	int e;
 	struct release_entry *file;
+	struct strlist byhashdirs, byhashfiles;
 	bool somethingwasdone;
 
 	somethingwasdone = false;
 	result = RET_OK;
 
+	r = release_sign(release);
+	if (RET_WAS_ERROR(r)) {
+		release_free(release);
+		return r;
+	}
+
+	if (distribution->byhash) {
+		r = release_linkbyhash(release, &byhashdirs, &byhashfiles);
+		if (RET_WAS_ERROR(r)) {
+			strlist_done(&byhashdirs);
+			strlist_done(&byhashfiles);
+			release_free(release);
+			return r;
+		}
+	}
+
 	for (file = release->files ; file != NULL ; file = file->next) {
 		assert (file->relativefilename != NULL);
 		if (file->checksums == NULL
@@ -1826,6 +2099,10 @@ retvalue release_finish(/*@only@*/struct release *release, struct distribution *
 				/* after something was done, do not stop
 				 * but try to do as much as possible */
 				if (!somethingwasdone) {
+					if (distribution->byhash) {
+						strlist_done(&byhashdirs);
+						strlist_done(&byhashfiles);
+					}
 					release_free(release);
 					return r;
 				}
@@ -1851,6 +2128,10 @@ retvalue release_finish(/*@only@*/struct release *release, struct distribution *
 				/* after something was done, do not stop
 				 * but try to do as much as possible */
 				if (!somethingwasdone) {
+					if (distribution->byhash) {
+						strlist_done(&byhashdirs);
+						strlist_done(&byhashfiles);
+					}
 					release_free(release);
 					return r;
 				}
@@ -1867,6 +2148,15 @@ retvalue release_finish(/*@only@*/struct release *release, struct distribution *
 "manually (via reprepro export codenames) as soon as possible!\n",
 			distribution->codename);
 	}
+	if (distribution->byhash) {
+		if (!RET_WAS_ERROR(result)) {
+			r = release_cleanbyhash(release, &byhashdirs,
+					&byhashfiles, distribution->byhashkeep);
+			RET_UPDATE(result, r);
+		}
+		strlist_done(&byhashdirs);
+		strlist_done(&byhashfiles);
+	}
 	if (release->cachedb != NULL) {
 		// TODO: split this in removing before and adding later?
 		// remember which file were changed in case of error, so
@@ -13,6 +13,7 @@
 #endif
 
 struct release;
+struct checksums;
 
 #define ic_first ic_uncompressed
 enum indexcompression {ic_uncompressed=0, ic_gzip,
@@ -35,11 +36,13 @@ retvalue release_initsnapshot(const char *codename, const char *name, struct rel
 retvalue release_mkdir(struct release *, const char * /*relativedirectory*/);
 
 const char *release_dirofdist(struct release *);
+/*@null@*/const struct checksums *release_getchecksums(const struct release *, const char * /*relfilename*/);
 
 retvalue release_addnew(struct release *, /*@only@*/char *, /*@only@*/char *);
 retvalue release_addsilentnew(struct release *, /*@only@*/char *, /*@only@*/char *);
 retvalue release_adddel(struct release *, /*@only@*/char *);
 retvalue release_addold(struct release *, /*@only@*/char *);
+retvalue release_addunlisted(struct release *, /*@only@*//*@null@*/char *, /*@only@*/char *, /*@only@*/struct checksums *);
 
 struct filetorelease;
 
@@ -63,6 +66,9 @@ retvalue release_directorydescription(struct release *, const struct distributio
 
 void release_free(/*@only@*/struct release *);
 retvalue release_prepare(struct release *, struct distribution *, bool /*onlyneeded*/);
+/* sign the prepared Release file (can be called in jobs, done by
+ * release_finish if not called before) */
+retvalue release_sign(struct release *);
 retvalue release_finish(/*@only@*/struct release *, struct distribution *);
 
 #endif
@@ -24,6 +24,7 @@
 #include <string.h>
 #include <errno.h>
 #include <dirent.h>
+#include <sys/stat.h>
 
 #include "globals.h"
 #include "error.h"
@@ -107,6 +108,8 @@ struct remote_distribution {
 
 	/* filenames and checksums from the Release file */
 	struct checksumsarray remotefiles;
+	/* Release file says files are available as by-hash/SHA256/<hash> */
+	bool byhash;
 
 	/* the index files we need */
 	struct remote_index *indices;
@@ -139,6 +142,11 @@ struct remote_index {
 	int lasttriedencoding;
 	/* the compression to be tried currently */
 	enum compression compression;
+	/* and if it was requested by-hash */
+	bool triedbyhash;
+	/* an interrupted download of this compression left over
+	 * from an earlier run, that is to be continued */
+	/*@dependant@*/struct cachedlistfile *partial;
 
 	/* the old uncompressed file, so that it is only deleted
 	 * when needed, to avoid losing it for a patch run */
@@ -147,10 +155,16 @@ struct remote_index {
 
 	/* if using pdiffs, the content of the Packages.diff/Index: */
 	struct diffindex *diffindex;
-	/* the last patch queued to be applied */
-	char *patchfilename;
-	/*@dependant@*/const struct diffindex_patch *selectedpatch;
-	bool deletecompressedpatch;
+	/* the patches queued to be downloaded, merged and applied at once */
+	struct pendingpatch {
+		/*@dependant@*/struct remote_index *ri;
+		/*@dependant@*/const struct diffindex_patch *patch;
+		char *filename;
+		bool deletecompressed, triedbyhash;
+	} *pendingpatches;
+	int pendingcount, pendingmissing;
+	/* one of the patches failed, falling back to other encodings */
+	bool pendingfailed;
 
 	bool queued;
 	bool needed;
@@ -169,11 +183,22 @@ struct cachedlistfile {
 };
 
 
+static void pendingpatches_free(struct remote_index *ri) {
+	int i;
+
+	for (i = 0 ; i < ri->pendingcount ; i++)
+		free(ri->pendingpatches[i].filename);
+	free(ri->pendingpatches);
+	ri->pendingpatches = NULL;
+	ri->pendingcount = 0;
+	ri->pendingmissing = 0;
+}
+
 static void remote_index_free(/*@only@*/struct remote_index *i) {
 	if (i == NULL)
 		return;
 	free(i->cachefilename);
-	free(i->patchfilename);
+	pendingpatches_free(i);
 	free(i->filename_in_release);
 	diffindex_free(i->diffindex);
 	checksums_free(i->oldchecksums);
@@ -701,6 +726,8 @@ static retvalue enqueue_old_release_files(struct remote_distribution *d) {
 	retvalue r;
 
 	d->noinrelease = true;
+	/* do not let a stale InRelease shadow the Release file later */
+	(void)unlink(d->inreleasefile);
 	r = aptmethod_enqueueindex(d->repository->download,
 			d->suite_base_dir, "Release", "",
 			d->releasefile, "",
@@ -726,12 +753,9 @@ static retvalue remote_distribution_enqueuemetalists(struct remote_distribution
 	if (d->ignorerelease)
 		return RET_NOTHING;
 
-	(void)unlink(d->inreleasefile);
-	(void)unlink(d->releasefile);
-	if (d->verify != NULL) {
-		(void)unlink(d->releasegpgfile);
-	}
-
+	/* the files from the last run are not deleted here, so that
+	 * the method can tell (by their date) if they are unchanged
+	 * and does not need to download them again */
 	if (d->noinrelease)
 		return enqueue_old_release_files(d);
 	else
@@ -882,6 +906,7 @@ static retvalue process_remoterelease(struct remote_distribution *rd) {
 	}
 	r = release_getchecksums(rd->usedreleasefile, releasedata,
 			rd->ignorehashes, &rd->remotefiles);
+	rd->byhash = chunk_gettruth(releasedata, "Acquire-By-Hash") == RET_OK;
 	free(releasedata);
 	if (RET_WAS_ERROR(r))
 		return r;
@@ -1269,6 +1294,16 @@ static inline retvalue reuse_old_compressed_index(struct remote_distribution *rd
 	return RET_OK;
 }
 
+/* something smaller than the file should be is most likely what an
+ * interrupted download left behind */
+static bool ispartial(const struct cachedlistfile *old, const struct checksums *wanted) {
+	struct stat s;
+
+	if (stat(old->fullfilename, &s) != 0 || !S_ISREG(s.st_mode))
+		return false;
+	return s.st_size > 0 && s.st_size < checksums_getfilesize(wanted);
+}
+
 static inline retvalue queueindex(struct remote_distribution *rd, struct remote_index *ri, bool nodownload, /*@null@*/struct cachedlistfile *oldfiles) {
 	enum compression c;
 	retvalue r;
@@ -1292,6 +1327,7 @@ static inline retvalue queueindex(struct remote_distribution *rd, struct remote_
 	remote_index_oldfiles(ri, oldfiles, old);
 	ri->olduncompressed = NULL;
 	ri->oldchecksums = NULL;
+	ri->partial = NULL;
 	if (ri->ofs[c_none] < 0 && old[c_none] != NULL) {
 		/* if we know not what it should be,
 		 * we canot use the old... */
@@ -1336,6 +1372,17 @@ static inline retvalue queueindex(struct remote_distribution *rd, struct remote_
 	for (c = 0 ; c < c_COUNT ; c++) {
 		if (old[c] == NULL)
 			continue;
+		if (c != c_none && ri->ofs[c] >= 0 && ri->partial == NULL
+				&& ispartial(old[c], rd->remotefiles.checksums[
+					ri->ofs[c]])) {
+			if (verbose > 1)
+				fprintf(stderr,
+"Keeping incomplete '%s' to continue the download.\n",
+						old[c]->fullfilename);
+			ri->partial = old[c];
+			old[c] = NULL;
+			continue;
+		}
 		if (c != c_none && ri->ofs[c] >= 0) {
 			/* check if it can be used */
 			r = checksums_test(old[c]->fullfilename,
@@ -1377,8 +1424,83 @@ static inline retvalue queueindex(struct remote_distribution *rd, struct remote_
 	return queue_next_encoding(rd, ri);
 }
 
-static retvalue queue_next_encoding(struct remote_distribution *rd, struct remote_index *ri) {
+/* queue <filename_in_release><suffix> for download, using the
+ * by-hash/SHA256/ location in the same directory instead if the
+ * Release file announces those and byhash is set */
+static retvalue enqueue_indexfile(struct remote_index *ri, const char *suffix, /*@null@*/const struct checksums *checksums, bool byhash, const char *destfile, const char *downloadsuffix, queue_callback *callback, void *privdata2, /*@out@*/bool *triedbyhash_p) {
+	struct remote_distribution *rd = ri->from;
 	struct remote_repository *rr = rd->repository;
+	const char *hash, *size, *slash;
+	size_t hashlen, sizelen;
+	char *filename, *byhashname;
+	retvalue r;
+
+	*triedbyhash_p = false;
+	if (!byhash || !rd->byhash || checksums == NULL
+			|| !checksums_gethashpart(checksums, cs_sha256sum,
+				&hash, &hashlen, &size, &sizelen))
+		return aptmethod_enqueueindex(rr->download,
+				rd->suite_base_dir,
+				ri->filename_in_release, suffix,
+				destfile, downloadsuffix,
+				callback, ri, privdata2);
+
+	filename = mprintf("%s%s", ri->filename_in_release, suffix);
+	if (FAILEDTOALLOC(filename))
+		return RET_ERROR_OOM;
+	slash = strrchr(filename, '/');
+	if (slash == NULL)
+		byhashname = mprintf("by-hash/SHA256/%.*s",
+				(int)hashlen, hash);
+	else
+		byhashname = mprintf("%.*s/by-hash/SHA256/%.*s",
+				(int)(slash - filename), filename,
+				(int)hashlen, hash);
+	free(filename);
+	if (FAILEDTOALLOC(byhashname))
+		return RET_ERROR_OOM;
+	r = aptmethod_enqueueindex(rr->download, rd->suite_base_dir,
+			byhashname, "", destfile, downloadsuffix,
+			callback, ri, privdata2);
+	free(byhashname);
+	*triedbyhash_p = RET_IS_OK(r);
+	return r;
+}
+
+/* queue what ri->compression says (again, if byhash failed) */
+static retvalue enqueue_encoding(struct remote_distribution *rd, struct remote_index *ri, bool byhash) {
+
+	ri->queued = true;
+	/* check if downloading a .diff/Index (aka .pdiff) is requested */
+	if (ri->compression == c_COUNT) {
+		/* without checksum (forced diff) only by name */
+		return enqueue_indexfile(ri, ".diff/Index",
+				(ri->diff_ofs >= 0) ?
+				rd->remotefiles.checksums[ri->diff_ofs] : NULL,
+				byhash, ri->cachefilename, ".diffindex",
+				diff_callback, NULL, &ri->triedbyhash);
+	}
+	/* the same for forced compressions not listed in the Release file */
+	return enqueue_indexfile(ri, uncompression_suffix[ri->compression],
+			(ri->ofs[ri->compression] >= 0) ?
+			rd->remotefiles.checksums[ri->ofs[ri->compression]] :
+			NULL,
+			byhash, ri->cachefilename,
+			uncompression_suffix[ri->compression],
+			index_callback, NULL, &ri->triedbyhash);
+}
+
+/* a by-hash download failed, try it the classic way before giving up
+ * (the server might not have it yet or not at all) */
+static retvalue enqueue_encoding_byname(struct remote_distribution *rd, struct remote_index *ri) {
+	if (verbose > 0)
+		fprintf(stderr,
+"Could not get '%s' by hash, trying by name...\n",
+				ri->filename_in_release);
+	return enqueue_encoding(rd, ri, false);
+}
+
+static retvalue queue_next_encoding(struct remote_distribution *rd, struct remote_index *ri) {
 	retvalue r;
 
 	if (rd->ignorerelease)
@@ -1391,16 +1513,21 @@ static retvalue queue_next_encoding(struct remote_distribution *rd, struct remot
 
 	assert (ri->compression <= c_COUNT);
 
-	/* check if downloading a .diff/Index (aka .pdiff) is requested */
+	/* a partial file is only useful if the same file is requested */
+	if (ri->partial != NULL && (ri->compression == c_COUNT ||
+			strcmp(ri->partial->basefilename
+				+ strlen(ri->cachebasename),
+				uncompression_suffix[ri->compression]) != 0)) {
+		r = cachedlistfile_delete(ri->partial);
+		ri->partial = NULL;
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+
 	if (ri->compression == c_COUNT) {
 		assert (ri->olduncompressed != NULL);
 		assert (ri->oldchecksums != NULL);
-
-		ri->queued = true;
-		return aptmethod_enqueueindex(rr->download, rd->suite_base_dir,
-				ri->filename_in_release, ".diff/Index",
-				ri->cachefilename, ".diffindex",
-				diff_callback, ri, NULL);
+		return enqueue_encoding(rd, ri, true);
 	}
 
 	assert (ri->compression < c_COUNT);
@@ -1415,13 +1542,7 @@ static retvalue queue_next_encoding(struct remote_distribution *rd, struct remot
  * this assumes that the uncompressed checksums for one index is never
  * the compressed checksum for another... */
 
-	ri->queued = true;
-	return aptmethod_enqueueindex(rr->download, rd->suite_base_dir,
-			ri->filename_in_release,
-			uncompression_suffix[ri->compression],
-			ri->cachefilename,
-			uncompression_suffix[ri->compression],
-			index_callback, ri, NULL);
+	return enqueue_encoding(rd, ri, true);
 }
 
 
@@ -1776,6 +1897,8 @@ static retvalue index_callback(enum queue_action action, void *privdata, UNUSED(
 	struct checksums *readchecksums = NULL;
 	retvalue r;
 
+	if (action == qa_error && ri->triedbyhash)
+		return enqueue_encoding_byname(rd, ri);
 	if (action == qa_error)
 		return queue_next_encoding(rd, ri);
 	if (action != qa_got)
@@ -1799,6 +1922,19 @@ static retvalue index_callback(enum queue_action action, void *privdata, UNUSED(
 
 		r = check_checksums(methodname, uri, gotfilename,
 				wantedchecksums, gotchecksums, &readchecksums);
+		if (r == RET_ERROR_WRONG_MD5 && ri->partial != NULL
+				&& strcmp(gotfilename, wantedfilename) == 0) {
+			/* the old part did not belong to this file,
+			 * so try again from the start */
+			assert (readchecksums == NULL);
+			fprintf(stderr,
+"Continued download did not work out, downloading '%s' again...\n",
+					uri);
+			ri->partial = NULL;
+			(void)unlink(gotfilename);
+			return enqueue_encoding(rd, ri, ri->triedbyhash);
+		}
+		ri->partial = NULL;
 		if (RET_WAS_ERROR(r)) {
 			checksums_free(readchecksums);
 			return r;
@@ -1830,35 +1966,75 @@ static retvalue index_callback(enum queue_action action, void *privdata, UNUSED(
 
 static queue_callback diff_got_callback;
 
-static retvalue queue_next_diff(struct remote_index *ri) {
+static retvalue enqueue_patch(struct pendingpatch *pp, bool byhash) {
+	char *patchsuffix;
+	retvalue r;
+
+	patchsuffix = mprintf(".diff/%s.gz", pp->patch->name);
+	if (FAILEDTOALLOC(patchsuffix))
+		return RET_ERROR_OOM;
+	r = enqueue_indexfile(pp->ri, patchsuffix, pp->patch->download,
+			byhash, pp->filename, ".gz",
+			diff_got_callback, pp, &pp->triedbyhash);
+	free(patchsuffix);
+	return r;
+}
+
+/* Queue the download of all patches needed to get from the old file to
+ * the current one. They are merged into a single patch once all of them
+ * are there, so the file only needs to be rewritten once. */
+static retvalue queue_diffs(struct remote_index *ri) {
 	struct remote_distribution *rd = ri->from;
-	struct remote_repository *rr = rd->repository;
-	int i;
+	int i, first, last;
 	retvalue r;
 
-	for (i = 0 ; i < ri->diffindex->patchcount ; i++) {
+	assert (ri->pendingcount == 0);
+
+	for (first = 0 ; first < ri->diffindex->patchcount ; first++) {
+		const struct diffindex_patch *p =
+			&ri->diffindex->patches[first];
 		bool improves;
-		struct diffindex_patch *p = &ri->diffindex->patches[i];
-		char *patchsuffix, *c;
 
-		if (p->done || p->frompackages == NULL)
+		if (p->frompackages == NULL)
 			continue;
-
 		if (!checksums_check(ri->oldchecksums, p->frompackages,
 					&improves))
 			continue;
 		/* p->frompackages should only have sha1 and oldchecksums
 		 * should definitely list a sha1 hash */
 		assert (!improves);
+		break;
+	}
+	if (first >= ri->diffindex->patchcount) {
+		/* no patch matches, try next possibility... */
+		fprintf(stderr,
+"Error: available '%s' not listed in '%s.diffindex'.\n",
+				ri->cachefilename, ri->cachefilename);
+		return queue_next_encoding(rd, ri);
+	}
+	/* if not merged, each patch results in the file the next one
+	 * in the list applies to */
+	if (ri->diffindex->merged)
+		last = first;
+	else
+		last = ri->diffindex->patchcount - 1;
 
-		p->done = true;
-
-		free(ri->patchfilename);
-		ri->patchfilename = mprintf("%s.diff-%s", ri->cachefilename,
+	ri->pendingpatches = nzNEW(last - first + 1, struct pendingpatch);
+	if (FAILEDTOALLOC(ri->pendingpatches))
+		return RET_ERROR_OOM;
+	ri->pendingfailed = false;
+	for (i = first ; i <= last ; i++) {
+		const struct diffindex_patch *p = &ri->diffindex->patches[i];
+		struct pendingpatch *pp = &ri->pendingpatches[ri->pendingcount];
+		char *c;
+
+		pp->ri = ri;
+		pp->patch = p;
+		pp->filename = mprintf("%s.diff-%s", ri->cachefilename,
 				p->name);
-		if (FAILEDTOALLOC(ri->patchfilename))
+		if (FAILEDTOALLOC(pp->filename))
 			return RET_ERROR_OOM;
-		c = ri->patchfilename + strlen(ri->cachefilename);
+		c = pp->filename + strlen(ri->cachefilename);
 		while (*c != '\0') {
 			if ((*c < '0' || *c > '9')
 					&& (*c < 'A' || *c > 'Z')
@@ -1867,152 +2043,210 @@ static retvalue queue_next_diff(struct remote_index *ri) {
 				*c = '_';
 			c++;
 		}
-		ri->selectedpatch = p;
-		patchsuffix = mprintf(".diff/%s.gz", p->name);
-		if (FAILEDTOALLOC(patchsuffix))
-			return RET_ERROR_OOM;
-
-		/* found a matching patch, tell the downloader we want it */
-		r = aptmethod_enqueueindex(rr->download, rd->suite_base_dir,
-				ri->filename_in_release,
-				patchsuffix,
-				ri->patchfilename, ".gz",
-				diff_got_callback, ri, p);
-		free(patchsuffix);
-		return r;
+		ri->pendingcount++;
+		ri->pendingmissing++;
 	}
-	/* no patch matches, try next possibility... */
-	fprintf(stderr, "Error: available '%s' not listed in '%s.diffindex'.\n",
-			ri->cachefilename, ri->cachefilename);
-	return queue_next_encoding(rd, ri);
+	for (i = 0 ; i < ri->pendingcount ; i++) {
+		r = enqueue_patch(&ri->pendingpatches[i], true);
+		if (RET_WAS_ERROR(r))
+			return r;
+	}
+	return RET_OK;
 }
 
-static retvalue diff_uncompressed(void *privdata, const char *compressed, bool failed) {
-	struct remote_index *ri = privdata;
+static retvalue diffs_failed(struct remote_index *ri) {
+	int i;
+
+	ri->pendingfailed = true;
+	for (i = 0 ; i < ri->pendingcount ; i++)
+		(void)unlink(ri->pendingpatches[i].filename);
+	return queue_next_encoding(ri->from, ri);
+}
+
+/* all patches are there: merge them and apply them in one go */
+static retvalue apply_diffs(struct remote_index *ri) {
 	struct remote_distribution *rd = ri->from;
-	const struct diffindex_patch *p = ri->selectedpatch;
+	const struct checksums *expected;
+	struct checksums *newchecksums = NULL;
+	struct rred_patch **patches;
+	struct modification *m;
 	char *tempfilename;
-	struct rred_patch *rp;
 	FILE *f;
-	int i;
+	int i, count = ri->pendingcount;
 	retvalue r;
 	bool dummy;
 
-	if (ri->deletecompressedpatch)
-		(void)unlink(compressed);
-	if (failed)
-		return RET_ERROR;
+	patches = nzNEW(count, struct rred_patch *);
+	if (FAILEDTOALLOC(patches))
+		return RET_ERROR_OOM;
+	r = RET_OK;
+	for (i = 0 ; i < count ; i++) {
+		const struct pendingpatch *pp = &ri->pendingpatches[i];
 
-	r = checksums_test(ri->patchfilename, p->checksums, NULL);
-	if (r == RET_NOTHING) {
-		fprintf(stderr, "Mysteriously vanished file '%s'!\n",
-				ri->patchfilename);
-		r = RET_ERROR_MISSING;
+		r = patch_load(pp->filename,
+				checksums_getfilesize(pp->patch->checksums),
+				&patches[i]);
+		ASSERT_NOT_NOTHING(r);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	m = NULL;
+	if (RET_IS_OK(r)) {
+		m = patch_getmodifications(patches[0]);
+		for (i = 1 ; i < count ; i++) {
+			r = combine_patches(&m, m,
+					patch_getmodifications(patches[i]));
+			if (RET_WAS_ERROR(r)) {
+				m = NULL;
+				break;
+			}
+		}
 	}
-	if (r == RET_ERROR_WRONG_MD5)
-		fprintf(stderr, "Corrupted package diff '%s'!\n",
-				ri->patchfilename);
-	if (RET_WAS_ERROR(r))
+	tempfilename = NULL;
+	f = NULL;
+	if (RET_IS_OK(r)) {
+		tempfilename = calc_addsuffix(ri->cachefilename, "tmp");
+		if (FAILEDTOALLOC(tempfilename))
+			r = RET_ERROR_OOM;
+	}
+	if (RET_IS_OK(r)) {
+		(void)unlink(tempfilename);
+		f = fopen(tempfilename, "w");
+		if (f == NULL) {
+			int e = errno;
+			fprintf(stderr, "Error %d creating '%s': %s\n",
+					e, tempfilename, strerror(e));
+			r = RET_ERRNO(e);
+		}
+	}
+	if (RET_IS_OK(r)) {
+		r = patch_file(f, ri->cachefilename, m);
+		if (ferror(f) != 0) {
+			int e = errno;
+			fprintf(stderr, "Error %d writing to '%s': %s\n",
+					e, tempfilename, strerror(e));
+			RET_UPDATE(r, RET_ERRNO(e));
+		}
+		if (fclose(f) != 0) {
+			int e = errno;
+			fprintf(stderr, "Error %d writing to '%s': %s\n",
+					e, tempfilename, strerror(e));
+			RET_UPDATE(r, RET_ERRNO(e));
+		}
+	}
+	modification_freelist(m);
+	for (i = 0 ; i < count ; i++) {
+		if (patches[i] != NULL)
+			patch_free(patches[i]);
+		(void)unlink(ri->pendingpatches[i].filename);
+	}
+	free(patches);
+	pendingpatches_free(ri);
+	if (RET_WAS_ERROR(r)) {
+		if (tempfilename != NULL)
+			(void)unlink(tempfilename);
+		free(tempfilename);
 		return r;
+	}
 
-	r = patch_load(ri->patchfilename,
-			checksums_getfilesize(p->checksums), &rp);
-	ASSERT_NOT_NOTHING(r);
-	if (RET_WAS_ERROR(r))
+	r = checksums_read(tempfilename, &newchecksums);
+	if (r == RET_NOTHING) {
+		fprintf(stderr, "Mysteriously vanished file '%s'!\n",
+				tempfilename);
+		r = RET_ERROR;
+	}
+	if (RET_WAS_ERROR(r)) {
+		(void)unlink(tempfilename);
+		free(tempfilename);
 		return r;
-
-	tempfilename = calc_addsuffix(ri->cachefilename, "tmp");
-	if (FAILEDTOALLOC(tempfilename)) {
-		patch_free(rp);
-		return RET_ERROR_OOM;
 	}
-	(void)unlink(tempfilename);
-	i = rename(ri->cachefilename, tempfilename);
-	if (i != 0) {
-		int e = errno;
-		fprintf(stderr, "Error %d moving '%s' to '%s': %s\n",
-				e, ri->cachefilename, tempfilename,
-				strerror(e));
+	if (ri->ofs[c_none] >= 0)
+		expected = rd->remotefiles.checksums[ri->ofs[c_none]];
+	else
+		expected = ri->diffindex->destination;
+	if (!checksums_check(newchecksums, expected, &dummy)) {
+		fprintf(stderr,
+"Patching '%s' did not result in the expected file, trying other ways...\n",
+				ri->cachefilename);
+		checksums_free(newchecksums);
+		(void)unlink(tempfilename);
 		free(tempfilename);
-		patch_free(rp);
-		return RET_ERRNO(e);
+		return queue_next_encoding(rd, ri);
 	}
-	f = fopen(ri->cachefilename, "w");
-	if (f == NULL) {
+	if (rename(tempfilename, ri->cachefilename) != 0) {
 		int e = errno;
-		fprintf(stderr, "Error %d creating '%s': %s\n",
-				e, ri->cachefilename, strerror(e));
+		fprintf(stderr, "Error %d moving '%s' to '%s': %s\n",
+				e, tempfilename, ri->cachefilename,
+				strerror(e));
+		checksums_free(newchecksums);
 		(void)unlink(tempfilename);
-		ri->olduncompressed->deleted = true;
-		ri->olduncompressed = NULL;
 		free(tempfilename);
-		patch_free(rp);
 		return RET_ERRNO(e);
 	}
-	r = patch_file(f, tempfilename, patch_getconstmodifications(rp));
-	(void)unlink(tempfilename);
-	(void)unlink(ri->patchfilename);
-	free(ri->patchfilename);
-	ri->patchfilename = NULL;
 	free(tempfilename);
-	patch_free(rp);
-	if (RET_WAS_ERROR(r)) {
-		(void)fclose(f);
-		remove_old_uncompressed(ri);
-		// TODO: fall back to downloading at once?
-		return r;
-	}
-	i = ferror(f);
-	if (i != 0) {
-		int e = errno;
-		(void)fclose(f);
-		fprintf(stderr, "Error %d writing to '%s': %s\n",
-				e, ri->cachefilename, strerror(e));
-		remove_old_uncompressed(ri);
-		return RET_ERRNO(e);
-	}
-	i = fclose(f);
-	if (i != 0) {
-		int e = errno;
-		fprintf(stderr, "Error %d writing to '%s': %s\n",
-				e, ri->cachefilename, strerror(e));
-		remove_old_uncompressed(ri);
-		return RET_ERRNO(e);
-	}
 	checksums_free(ri->oldchecksums);
-	ri->oldchecksums = NULL;
-	r = checksums_read(ri->cachefilename, &ri->oldchecksums);
+	ri->oldchecksums = newchecksums;
+	ri->olduncompressed->deleted = true;
+	ri->olduncompressed = NULL;
+	/* we have a winner */
+	return indexfile_mark_got(rd, ri, ri->oldchecksums);
+}
+
+static retvalue diff_uncompressed(void *privdata, const char *compressed, bool failed) {
+	struct pendingpatch *pp = privdata;
+	struct remote_index *ri = pp->ri;
+	retvalue r;
+
+	if (pp->deletecompressed)
+		(void)unlink(compressed);
+	if (ri->pendingfailed) {
+		(void)unlink(pp->filename);
+		return RET_NOTHING;
+	}
+	if (failed)
+		return RET_ERROR;
+
+	r = checksums_test(pp->filename, pp->patch->checksums, NULL);
 	if (r == RET_NOTHING) {
-		fprintf(stderr, "Myteriously vanished file '%s'!\n",
-				ri->cachefilename);
-		r = RET_ERROR;
+		fprintf(stderr, "Mysteriously vanished file '%s'!\n",
+				pp->filename);
+		r = RET_ERROR_MISSING;
 	}
+	if (r == RET_ERROR_WRONG_MD5)
+		fprintf(stderr, "Corrupted package diff '%s'!\n",
+				pp->filename);
 	if (RET_WAS_ERROR(r))
 		return r;
-	if (checksums_check(ri->oldchecksums,
-				rd->remotefiles.checksums[ri->ofs[c_none]],
-				&dummy)) {
-		ri->olduncompressed->deleted = true;
-		ri->olduncompressed = NULL;
-		/* we have a winner */
-		return indexfile_mark_got(rd, ri, ri->oldchecksums);
-	}
-	/* let's see what patch we need next */
-	return queue_next_diff(ri);
+
+	assert (ri->pendingmissing > 0);
+	ri->pendingmissing--;
+	if (ri->pendingmissing > 0)
+		return RET_OK;
+	return apply_diffs(ri);
 }
 
-static retvalue diff_got_callback(enum queue_action action, void *privdata, UNUSED(void *privdata2), UNUSED(const char *uri), const char *gotfilename, const char *wantedfilename, UNUSED(/*@null@*/const struct checksums *gotchecksums), UNUSED(const char *methodname)) {
+static retvalue diff_got_callback(enum queue_action action, void *privdata, void *privdata2, UNUSED(const char *uri), const char *gotfilename, const char *wantedfilename, UNUSED(/*@null@*/const struct checksums *gotchecksums), UNUSED(const char *methodname)) {
 	struct remote_index *ri = privdata;
+	struct pendingpatch *pp = privdata2;
 	retvalue r;
 
+	if (ri->pendingfailed) {
+		/* already gave up on the patches */
+		if (action == qa_got && strcmp(gotfilename,
+					wantedfilename) == 0)
+			(void)unlink(gotfilename);
+		return RET_NOTHING;
+	}
+	if (action == qa_error && pp->triedbyhash)
+		return enqueue_patch(pp, false);
 	if (action == qa_error)
-		return queue_next_encoding(ri->from, ri);
+		return diffs_failed(ri);
 	if (action != qa_got)
 		return RET_ERROR;
 
-	ri->deletecompressedpatch = strcmp(gotfilename, wantedfilename) == 0;
-	r = uncompress_queue_file(gotfilename, ri->patchfilename,
-			c_gzip, diff_uncompressed, ri);
+	pp->deletecompressed = strcmp(gotfilename, wantedfilename) == 0;
+	r = uncompress_queue_file(gotfilename, pp->filename,
+			c_gzip, diff_uncompressed, pp);
 	if (RET_WAS_ERROR(r))
 		(void)unlink(gotfilename);
 	return r;
@@ -2025,6 +2259,8 @@ static retvalue diff_callback(enum queue_action action, void *privdata, UNUSED(v
 	int ofs;
 	retvalue r;
 
+	if (action == qa_error && ri->triedbyhash)
+		return enqueue_encoding_byname(rd, ri);
 	if (action == qa_error)
 		return queue_next_encoding(rd, ri);
 	if (action != qa_got)
@@ -2099,5 +2335,5 @@ static retvalue diff_callback(enum queue_action action, void *privdata, UNUSED(v
 			return queue_next_encoding(rd, ri);
 		}
 	}
-	return queue_next_diff(ri);
+	return queue_diffs(ri);
 }
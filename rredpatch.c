@@ -48,6 +48,8 @@ struct rred_patch {
 	/* content of the file mapped with mmap */
 	char *data;
 	off_t len;
+	/* data was malloced instead of mapped */
+	bool datamalloced;
 	struct modification *modifications;
 	bool alreadyinuse;
 };
@@ -104,7 +106,9 @@ static struct modification *modification_freehead(/*@only@*/struct modification
 }
 
 void patch_free(/*@only@*/struct rred_patch *p) {
-	if (p->data != NULL)
+	if (p->datamalloced)
+		free(p->data);
+	else if (p->data != NULL)
 		(void)munmap(p->data, p->len);
 	if (p->fd >= 0)
 		(void)close(p->fd);
@@ -126,13 +130,11 @@ retvalue patch_load(const char *filename, off_t length, struct rred_patch **patc
 
 }
 
+static retvalue patch_parse(const char *, /*@only@*/struct rred_patch *, /*@out@*/struct rred_patch **);
+
 retvalue patch_loadfd(const char *filename, int fd, off_t length, struct rred_patch **patch_p) {
 	int i;
 	struct rred_patch *patch;
-	const char *p, *e, *d, *l;
-	int number, number2, line;
-	char type;
-	struct modification *n;
 	struct stat statbuf;
 
 	patch = zNEW(struct rred_patch);
@@ -179,6 +181,31 @@ retvalue patch_loadfd(const char *filename, int fd, off_t length, struct rred_pa
 		patch_free(patch);
 		return RET_ERRNO(err);
 	}
+	return patch_parse(filename, patch, patch_p);
+}
+
+/* same as patch_loadfd, but with the patch already in memory */
+retvalue patch_loaddata(const char *filename, char *data, size_t len, struct rred_patch **patch_p) {
+	struct rred_patch *patch;
+
+	patch = zNEW(struct rred_patch);
+	if (FAILEDTOALLOC(patch)) {
+		free(data);
+		return RET_ERROR_OOM;
+	}
+	patch->fd = -1;
+	patch->datamalloced = true;
+	patch->data = data;
+	patch->len = len;
+	return patch_parse(filename, patch, patch_p);
+}
+
+static retvalue patch_parse(const char *filename, struct rred_patch *patch, struct rred_patch **patch_p) {
+	const char *p, *e, *d, *l;
+	int number, number2, line;
+	char type;
+	struct modification *n;
+
 	p = patch->data;
 	e = p + patch->len;
 	line = 1;
@@ -583,64 +610,123 @@ retvalue combine_patches(struct modification **result_p, /*@only@*/struct modifi
 	return RET_OK;
 }
 
-retvalue patch_file(FILE *o, const char *source, const struct modification *patch) {
-	FILE *i;
-	int currentline, ignore, c;
+/* the file to be patched, with the offsets where each line starts,
+ * so unchanged ranges can be copied with a single write */
+struct linedfile {
+	char *data;
+	size_t len;
+	int linecount;
+	/* offsets[linecount] == len */
+	size_t *offsets;
+};
 
-	i = fopen(source, "r");
-	if (i == NULL) {
-		int e = errno;
+static void linedfile_done(struct linedfile *f) {
+	free(f->offsets);
+	if (f->data != NULL)
+		(void)munmap(f->data, f->len);
+}
+
+static retvalue linedfile_map(const char *source, /*@out@*/struct linedfile *f) {
+	struct stat s;
+	const char *p, *e;
+	int fd, i, count;
+
+	f->data = NULL;
+	f->len = 0;
+	f->offsets = NULL;
+	f->linecount = 0;
+
+	fd = open(source, O_NOCTTY|O_RDONLY);
+	if (fd < 0) {
+		int err = errno;
 		fprintf(stderr, "Error %d opening %s: %s\n",
-				e, source, strerror(e));
-		return RET_ERRNO(e);
+				err, source, strerror(err));
+		return RET_ERRNO(err);
+	}
+	if (fstat(fd, &s) != 0) {
+		int err = errno;
+		fprintf(stderr, "Error %d reading %s: %s\n",
+				err, source, strerror(err));
+		(void)close(fd);
+		return RET_ERRNO(err);
+	}
+	if (s.st_size > 0) {
+		f->len = s.st_size;
+		f->data = mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (f->data == MAP_FAILED) {
+			int err = errno;
+			fprintf(stderr, "Error %d mapping %s into memory: %s\n",
+					err, source, strerror(err));
+			f->data = NULL;
+			(void)close(fd);
+			return RET_ERRNO(err);
+		}
+	}
+	(void)close(fd);
+
+	count = 0;
+	p = f->data;
+	e = f->data + f->len;
+	while (p < e && (p = memchr(p, '\n', e - p)) != NULL) {
+		p++;
+		count++;
 	}
+	/* a last line without newline still counts */
+	if (f->len > 0 && f->data[f->len - 1] != '\n')
+		count++;
+	f->offsets = nNEW(count + 1, size_t);
+	if (FAILEDTOALLOC(f->offsets)) {
+		linedfile_done(f);
+		return RET_ERROR_OOM;
+	}
+	p = f->data;
+	for (i = 0 ; i < count ; i++) {
+		f->offsets[i] = p - f->data;
+		p = memchr(p, '\n', e - p);
+		if (p == NULL)
+			p = e;
+		else
+			p++;
+	}
+	f->offsets[count] = f->len;
+	f->linecount = count;
+	return RET_OK;
+}
+
+retvalue patch_file(FILE *o, const char *source, const struct modification *patch) {
+	struct linedfile f;
+	int currentline;
+	retvalue r;
+
+	r = linedfile_map(source, &f);
+	if (RET_WAS_ERROR(r))
+		return r;
 	assert (patch == NULL || patch->oldlinestart > 0);
+	/* currentline is the first line (counting from 1) not yet
+	 * copied or skipped */
 	currentline = 1;
-	do {
-		while (patch != NULL && patch->oldlinestart == currentline) {
-			fwrite(patch->content, patch->len, 1, o);
-			ignore = patch->oldlinecount;
-			patch = patch->next;
-			while (ignore > 0) {
-				do {
-					c = getc(i);
-				} while (c != '\n' && c != EOF);
-				ignore--;
-				currentline++;
-			}
-		}
-		assert (patch == NULL || patch->oldlinestart >= currentline);
-		while ((c = getc(i)) != '\n') {
-			if (c == EOF) {
-				if (patch != NULL) {
-					fprintf(stderr,
+	for (; patch != NULL ; patch = patch->next) {
+		assert (patch->oldlinestart >= currentline);
+		if (patch->oldlinestart - 1 + patch->oldlinecount
+				> f.linecount) {
+			fprintf(stderr,
 "Error patching '%s', file shorter than expected by patches!\n",
-						source);
-					(void)fclose(i);
-					return RET_ERROR;
-				}
-				break;
-			}
-			putc(c, o);
+				source);
+			linedfile_done(&f);
+			return RET_ERROR;
 		}
-		if (c == EOF)
-			break;
-		putc(c, o);
-		currentline++;
-	} while (1);
-	if (ferror(i) != 0) {
-		int e = errno;
-		fprintf(stderr, "Error %d reading %s: %s\n",
-				e, source, strerror(e));
-		(void)fclose(i);
-		return RET_ERRNO(e);
-	}
-	if (fclose(i) != 0) {
-		int e = errno;
-		fprintf(stderr, "Error %d reading %s: %s\n",
-				e, source, strerror(e));
-		return RET_ERRNO(e);
+		if (patch->oldlinestart > currentline)
+			fwrite(f.data + f.offsets[currentline - 1],
+				f.offsets[patch->oldlinestart - 1]
+				- f.offsets[currentline - 1], 1, o);
+		if (patch->len > 0)
+			fwrite(patch->content, patch->len, 1, o);
+		currentline = patch->oldlinestart + patch->oldlinecount;
 	}
+	if (currentline <= f.linecount)
+		fwrite(f.data + f.offsets[currentline - 1],
+				f.len - f.offsets[currentline - 1], 1, o);
+	linedfile_done(&f);
 	return RET_OK;
 }
 
@@ -770,3 +856,65 @@ retvalue modification_addstuff(const char *source, struct modification **patch_p
 	return RET_OK;
 }
 
+
+/* add a modification after <last> (NULL to start a new list), used to
+ * build patches in memory. Modifications must be added sorted and not
+ * overlapping. content is not copied */
+struct modification *modification_append(struct modification *last, int oldlinestart, int oldlinecount, const char *content, size_t len, int newlinecount) {
+	struct modification *n;
+
+	assert (oldlinestart > 0);
+	assert (last == NULL ||
+			last->oldlinestart + last->oldlinecount <= oldlinestart);
+
+	n = NEW(struct modification);
+	if (FAILEDTOALLOC(n))
+		return NULL;
+	n->next = NULL;
+	n->previous = last;
+	if (last != NULL)
+		last->next = n;
+	n->oldlinestart = oldlinestart;
+	n->oldlinecount = oldlinecount;
+	n->newlinecount = newlinecount;
+	n->content = content;
+	n->len = len;
+	return n;
+}
+
+/* like modification_addstuff, but with the new file in memory
+ * (the added line points into the data, so nothing to free) */
+retvalue modification_addstuffdata(const char *data, size_t datalen, struct modification **patch_p) {
+	struct modification **pp, *n, *m = NULL;
+	const char *line, *e, *end = data + datalen;
+	long lineno = 0;
+
+	pp = patch_p;
+	/* check if this only adds things at the start and count how many */
+	while (*pp != NULL) {
+		m = *pp;
+		if (m->oldlinecount > 0 || m->oldlinestart > 1)
+			return RET_NOTHING;
+		lineno += m->newlinecount;
+		pp = &(*pp)->next;
+	}
+	/* get the next line and claim it was changed */
+	line = data;
+	while (lineno-- > 0 && line < end) {
+		e = memchr(line, '\n', end - line);
+		line = (e == NULL) ? end : e + 1;
+	}
+	e = (line < end) ? memchr(line, '\n', end - line) : NULL;
+	if (e == NULL) {
+		/* You should have made sure the new file is long enough */
+		fputs("Internal error: not enough lines to extend patch!\n",
+				stderr);
+		return RET_ERROR;
+	}
+
+	n = modification_append(m, 1, 1, line, e + 1 - line, 1);
+	if (FAILEDTOALLOC(n))
+		return RET_ERROR_OOM;
+	*pp = n;
+	return RET_OK;
+}
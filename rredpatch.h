@@ -6,6 +6,7 @@ struct modification;
 
 retvalue patch_load(const char *, off_t, /*@out@*/struct rred_patch **);
 retvalue patch_loadfd(const char *, int, off_t, /*@out@*/struct rred_patch **);
+retvalue patch_loaddata(const char *, /*@only@*/char *, size_t, /*@out@*/struct rred_patch **);
 void patch_free(/*@only@*/struct rred_patch *);
 /*@only@*//*@null@*/struct modification *patch_getmodifications(struct rred_patch *);
 /*@null@*/const struct modification *patch_getconstmodifications(struct rred_patch *);
@@ -15,5 +16,7 @@ retvalue combine_patches(/*@out@*/struct modification **, /*@only@*/struct modif
 void modification_printaspatch(void *, const struct modification *, void (const void *, size_t, void *));
 retvalue modification_addstuff(const char *source, struct modification **patch_p, /*@out@*/char **line_p);
 retvalue patch_file(FILE *, const char *, const struct modification *);
+/*@null@*/struct modification *modification_append(/*@null@*/struct modification *, int /*oldlinestart*/, int /*oldlinecount*/, const char *, size_t, int /*newlinecount*/);
+retvalue modification_addstuffdata(const char *, size_t, struct modification **);
 
 #endif
@@ -24,6 +24,7 @@
 #include <time.h>
 #include <string.h>
 #include <fcntl.h>
+#include <pthread.h>
 
 #include "signature_p.h"
 #include "mprintf.h"
@@ -36,6 +37,27 @@
 #ifdef HAVE_LIBGPGME
 gpgme_ctx_t context = NULL;
 
+/* processincoming reads signed files and exporting signs Release files
+ * from multiple jobs. As a gpgme context can only be used by one thread
+ * at a time, every job gets a context of its own (those are kept for
+ * later use), so this can happen at the same time. */
+static struct gpgcontext *idle_gpgcontexts = NULL;
+static bool askforpassphrase = false;
+
+/* what is known about the primary key of a signing key,
+ * so that the keyring only needs to be asked once for every key */
+static struct primarykey {
+	struct primarykey *next;
+	char *keyid;
+	char *primary_keyid;
+	bool revoked, expired;
+} *primarykeys = NULL;
+
+/* protects the above and the initialisation of context */
+static pthread_mutex_t gpg_lock = PTHREAD_MUTEX_INITIALIZER;
+/* only ask for one passphrase at a time */
+static pthread_mutex_t passphrase_lock = PTHREAD_MUTEX_INITIALIZER;
+
 retvalue gpgerror(gpg_error_t err) {
 	if (err != 0) {
 		fprintf(stderr, "gpgme gave error %s:%d:  %s\n",
@@ -60,6 +82,7 @@ static gpg_error_t signature_getpassphrase(UNUSED(void *hook), const char *uid_h
 			(prev_was_bad!=0)?" again":"");
 	if (msg == NULL)
 		return gpg_err_make(GPG_ERR_SOURCE_USER_1, GPG_ERR_ENOMEM);
+	pthread_mutex_lock(&passphrase_lock);
 	p = getpass(msg);
 	if (write(fd, p, strlen(p)) < 0) {
 		e = errno;
@@ -67,6 +90,7 @@ static gpg_error_t signature_getpassphrase(UNUSED(void *hook), const char *uid_h
 	if (write(fd, "\n", 1) < 0 && e == 0) {
 		e = errno;
 	}
+	pthread_mutex_unlock(&passphrase_lock);
 	if (e != 0) {
 		fprintf(stderr, "Error %d writing to fd %i: %s\n",
 				e, fd, strerror(e));
@@ -94,6 +118,7 @@ retvalue signature_init(bool allowpassphrase){
 	err = gpgme_set_protocol(context, GPGME_PROTOCOL_OpenPGP);
 	if (err != 0)
 		return gpgerror(err);
+	askforpassphrase = allowpassphrase;
 	if (allowpassphrase)
 		gpgme_set_passphrase_cb(context, signature_getpassphrase,
 				NULL);
@@ -104,6 +129,21 @@ retvalue signature_init(bool allowpassphrase){
 
 void signatures_done(void) {
 #ifdef HAVE_LIBGPGME
+	while (idle_gpgcontexts != NULL) {
+		struct gpgcontext *gc = idle_gpgcontexts;
+
+		idle_gpgcontexts = gc->next;
+		gpgme_release(gc->ctx);
+		free(gc);
+	}
+	while (primarykeys != NULL) {
+		struct primarykey *pk = primarykeys;
+
+		primarykeys = pk->next;
+		free(pk->keyid);
+		free(pk->primary_keyid);
+		free(pk);
+	}
 	if (context != NULL) {
 		gpgme_release(context);
 		context = NULL;
@@ -111,12 +151,61 @@ void signatures_done(void) {
 #endif /* HAVE_LIBGPGME */
 }
 
+#ifdef HAVE_LIBGPGME
+retvalue gpgcontext_get(/*@out@*/struct gpgcontext **gc_p) {
+	struct gpgcontext *gc;
+	gpg_error_t err;
+	retvalue r;
+
+	pthread_mutex_lock(&gpg_lock);
+	r = signature_init(false);
+	gc = idle_gpgcontexts;
+	if (gc != NULL)
+		idle_gpgcontexts = gc->next;
+	pthread_mutex_unlock(&gpg_lock);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (gc != NULL) {
+		*gc_p = gc;
+		return RET_OK;
+	}
+
+	gc = NEW(struct gpgcontext);
+	if (FAILEDTOALLOC(gc))
+		return RET_ERROR_OOM;
+	err = gpgme_new(&gc->ctx);
+	if (err != 0) {
+		free(gc);
+		return gpgerror(err);
+	}
+	err = gpgme_set_protocol(gc->ctx, GPGME_PROTOCOL_OpenPGP);
+	if (err != 0) {
+		gpgme_release(gc->ctx);
+		free(gc);
+		return gpgerror(err);
+	}
+	if (askforpassphrase)
+		gpgme_set_passphrase_cb(gc->ctx, signature_getpassphrase,
+				NULL);
+	gpgme_set_armor(gc->ctx, 1);
+	*gc_p = gc;
+	return RET_OK;
+}
+
+void gpgcontext_put(/*@only@*/struct gpgcontext *gc) {
+	pthread_mutex_lock(&gpg_lock);
+	gc->next = idle_gpgcontexts;
+	idle_gpgcontexts = gc;
+	pthread_mutex_unlock(&gpg_lock);
+}
+#endif /* HAVE_LIBGPGME */
+
 #ifdef HAVE_LIBGPGME
 /* retrieve a list of fingerprints of keys having signed (valid) or
  * which are mentioned in the signature (all). set broken if all signatures
  * was broken (hints to a broken file, as opposed to expired or whatever
  * else may make a signature invalid)). */
-static retvalue checksigs(const char *filename, struct signatures **signatures_p, bool *broken) {
+static retvalue checksigs(gpgme_ctx_t ctx, const char *filename, struct signatures **signatures_p, bool *broken) {
 	gpgme_verify_result_t result;
 	gpgme_signature_t s;
 	bool had_valid = false, had_broken = false;
@@ -124,7 +213,7 @@ static retvalue checksigs(const char *filename, struct signatures **signatures_p
 	struct signatures *signatures;
 	struct signature *sig;
 
-	result = gpgme_op_verify_result(context);
+	result = gpgme_op_verify_result(ctx);
 	if (result == NULL) {
 		fprintf(stderr,
 "Internal error communicating with libgpgme: no result record!\n\n");
@@ -249,17 +338,74 @@ static retvalue checksigs(const char *filename, struct signatures **signatures_p
 	return RET_OK;
 }
 
-static retvalue check_primary_keys(struct signatures *signatures) {
+static retvalue lookup_primarykey(gpgme_ctx_t ctx, const char *keyid, /*@out@*/const struct primarykey **pk_p) {
+	struct primarykey *pk;
+	gpg_error_t err;
+	gpgme_key_t gpgme_key = NULL;
+	gpgme_subkey_t subkey;
+
+	pthread_mutex_lock(&gpg_lock);
+	for (pk = primarykeys ; pk != NULL ; pk = pk->next) {
+		if (strcmp(pk->keyid, keyid) == 0)
+			break;
+	}
+	pthread_mutex_unlock(&gpg_lock);
+	if (pk != NULL) {
+		*pk_p = pk;
+		return RET_OK;
+	}
+
+	err = gpgme_get_key(ctx, keyid, &gpgme_key, 0);
+	if (err != 0) {
+		fprintf(stderr,
+"gpgme error %s:%d retrieving key '%s': %s\n",
+				gpg_strsource(err),
+				(int)gpg_err_code(err),
+				keyid, gpg_strerror(err));
+		if (gpg_err_code(err) == GPG_ERR_ENOMEM)
+			return RET_ERROR_OOM;
+		else
+			return RET_ERROR_GPGME;
+	}
+	assert (gpgme_key != NULL);
+	pk = zNEW(struct primarykey);
+	if (FAILEDTOALLOC(pk)) {
+		gpgme_key_unref(gpgme_key);
+		return RET_ERROR_OOM;
+	}
+	/* the first "sub"key is the primary key */
+	subkey = gpgme_key->subkeys;
+	pk->revoked = subkey->revoked;
+	pk->expired = subkey->expired;
+	pk->keyid = strdup(keyid);
+	pk->primary_keyid = strdup(subkey->keyid);
+	gpgme_key_unref(gpgme_key);
+	if (FAILEDTOALLOC(pk->keyid) || FAILEDTOALLOC(pk->primary_keyid)) {
+		free(pk->keyid);
+		free(pk->primary_keyid);
+		free(pk);
+		return RET_ERROR_OOM;
+	}
+	/* if another job looked for the same key at the same time,
+	 * it is simply listed twice */
+	pthread_mutex_lock(&gpg_lock);
+	pk->next = primarykeys;
+	primarykeys = pk;
+	pthread_mutex_unlock(&gpg_lock);
+	*pk_p = pk;
+	return RET_OK;
+}
+
+static retvalue check_primary_keys(gpgme_ctx_t ctx, struct signatures *signatures) {
 	/* Get the primary keys belonging to each signing key.
 	   This might also invalidate a signature previously believed
 	   valid if the primary key is expired */
 	int i;
 
 	for (i = 0 ; i < signatures->count ; i++) {
-		gpg_error_t err;
-		gpgme_key_t gpgme_key = NULL;
-		gpgme_subkey_t subkey;
+		const struct primarykey *pk;
 		struct signature *sig = &signatures->signatures[i];
+		retvalue r;
 
 		if (sig->state == sist_error || sig->state == sist_missing) {
 			sig->primary_keyid = strdup(sig->keyid);
@@ -268,37 +414,24 @@ static retvalue check_primary_keys(struct signatures *signatures) {
 			continue;
 		}
 
-		err = gpgme_get_key(context, sig->keyid, &gpgme_key, 0);
-		if (err != 0) {
-			fprintf(stderr,
-"gpgme error %s:%d retrieving key '%s': %s\n",
-					gpg_strsource(err),
-					(int)gpg_err_code(err),
-					sig->keyid, gpg_strerror(err));
-			if (gpg_err_code(err) == GPG_ERR_ENOMEM)
-				return RET_ERROR_OOM;
-			else
-				return RET_ERROR_GPGME;
-		}
-		assert (gpgme_key != NULL);
-		/* the first "sub"key is the primary key */
-		subkey = gpgme_key->subkeys;
-		if (subkey->revoked) {
+		r = lookup_primarykey(ctx, sig->keyid, &pk);
+		if (RET_WAS_ERROR(r))
+			return r;
+		if (pk->revoked) {
 			sig->revoced_key = true;
 			if (sig->state == sist_valid) {
 				sig->state = sist_mostly;
 				signatures->validcount--;
 			}
 		}
-		if (subkey->expired) {
+		if (pk->expired) {
 			sig->expired_key = true;
 			if (sig->state == sist_valid) {
 				sig->state = sist_mostly;
 				signatures->validcount--;
 			}
 		}
-		sig->primary_keyid = strdup(subkey->keyid);
-		gpgme_key_unref(gpgme_key);
+		sig->primary_keyid = strdup(pk->primary_keyid);
 		if (FAILEDTOALLOC(sig->primary_keyid))
 			return RET_ERROR_OOM;
 	}
@@ -320,7 +453,7 @@ void signatures_free(struct signatures *signatures) {
 }
 
 #ifdef HAVE_LIBGPGME
-static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const char *filenametoshow, char **chunkread, /*@null@*/ /*@out@*/struct signatures **signatures_p, bool *brokensignature) {
+static retvalue extract_signed_data(gpgme_ctx_t ctx, const char *buffer, size_t bufferlen, const char *filenametoshow, char **chunkread, /*@null@*/ /*@out@*/struct signatures **signatures_p, bool *brokensignature) {
 	char *chunk;
 	gpg_error_t err;
 	gpgme_data_t dh, dh_gpg;
@@ -330,10 +463,6 @@ static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const
 	struct signatures *signatures = NULL;
 	bool foundbroken = false;
 
-	r = signature_init(false);
-	if (RET_WAS_ERROR(r))
-		return r;
-
 	err = gpgme_data_new_from_mem(&dh_gpg, buffer, bufferlen, 0);
 	if (err != 0)
 		return gpgerror(err);
@@ -343,7 +472,7 @@ static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const
 		gpgme_data_release(dh_gpg);
 		return gpgerror(err);
 	}
-	err = gpgme_op_verify(context, dh_gpg, NULL, dh);
+	err = gpgme_op_verify(ctx, dh_gpg, NULL, dh);
 	if (gpg_err_code(err) == GPG_ERR_NO_DATA) {
 		if (verbose > 5)
 			fprintf(stderr,
@@ -358,7 +487,7 @@ static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const
 			return gpgerror(err);
 		}
 		if (signatures_p != NULL || brokensignature != NULL) {
-			r = checksigs(filenametoshow,
+			r = checksigs(ctx, filenametoshow,
 				(signatures_p!=NULL)?&signatures:NULL,
 				(brokensignature!=NULL)?&foundbroken:NULL);
 			if (RET_WAS_ERROR(r)) {
@@ -382,7 +511,7 @@ static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const
 			return RET_NOTHING;
 		}
 		if (signatures != NULL) {
-			r = check_primary_keys(signatures);
+			r = check_primary_keys(ctx, signatures);
 			if (RET_WAS_ERROR(r)) {
 				signatures_free(signatures);
 				return r;
@@ -434,6 +563,19 @@ static retvalue extract_signed_data(const char *buffer, size_t bufferlen, const
 	}
 	return r;
 }
+
+static retvalue verify_signed_data(const char *buffer, size_t bufferlen, const char *filenametoshow, char **chunkread, /*@null@*/ /*@out@*/struct signatures **signatures_p, bool *brokensignature) {
+	struct gpgcontext *gc;
+	retvalue r;
+
+	r = gpgcontext_get(&gc);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = extract_signed_data(gc->ctx, buffer, bufferlen, filenametoshow,
+			chunkread, signatures_p, brokensignature);
+	gpgcontext_put(gc);
+	return r;
+}
 #endif /* HAVE_LIBGPGME */
 
 /* Read a single chunk from a file, that may be signed. */
@@ -494,8 +636,8 @@ retvalue signature_readsignedchunk(const char *filename, const char *filenametos
 	}
 
 #ifdef HAVE_LIBGPGME
-	r = extract_signed_data(chunk, chunklen, filenametoshow, chunkread,
-			signatures_p, brokensignature);
+	r = verify_signed_data(chunk, chunklen, filenametoshow,
+			chunkread, signatures_p, brokensignature);
 	if (r != RET_NOTHING) {
 		free(chunk);
 		return r;
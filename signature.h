@@ -58,8 +58,10 @@ struct strlist;
 
 retvalue signature_startsignedfile(/*@out@*/struct signedfile **);
 void signedfile_write(struct signedfile *, const void *, size_t);
-/* generate signature in temporary file */
-retvalue signedfile_create(struct signedfile *, const char *, char **, char **, const struct strlist *, bool /*willcleanup*/);
+/* write the data to the (temporary) unsigned file */
+retvalue signedfile_create(struct signedfile *, const char *);
+/* generate signatures of it in temporary files (can be called in jobs) */
+retvalue signedfile_sign(struct signedfile *, const char *, char **, char **, const struct strlist *, bool /*willcleanup*/);
 void signedfile_free(/*@only@*/struct signedfile *);
 
 void signatures_done(void);
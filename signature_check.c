@@ -24,10 +24,13 @@
 #include <time.h>
 #include <string.h>
 #include <fcntl.h>
+#include <stdint.h>
 #include "signature_p.h"
 #include "ignore.h"
 #include "chunks.h"
 #include "readtextfile.h"
+#include "database.h"
+#include "sha256.h"
 
 
 #ifdef HAVE_LIBGPGME
@@ -126,6 +129,8 @@ static struct known_key {
 		bool expired;
 		/* false if invalid or cannot sign */
 		bool cansign;
+		/* when it expires, 0 if never */
+		time_t expires;
 	} subkeys[];
 } *known_keys = NULL;
 
@@ -238,6 +243,7 @@ static retvalue load_key(const char *name, bool allow_subkeys, bool allow_bad, c
 		s->revoked = subkey->revoked;
 		s->expired = subkey->expired;
 		s->cansign = subkey->can_sign && !subkey->invalid;
+		s->expires = subkey->expires;
 		s->name = strdup(subkey->keyid);
 		if (FAILEDTOALLOC(s->name)) {
 			gpgme_key_unref(gpgme_key);
@@ -608,11 +614,43 @@ static void print_signatures(FILE *f, gpgme_signature_t s, const char *releasegp
 	}
 }
 
-static inline retvalue verify_signature(const struct signature_requirement *requirements, const char *releasegpg, const char *releasename) {
+/* until when this result may be reused, 0 if there is no limit */
+static time_t verify_validuntil(const struct signature_requirement *requirements, gpgme_signature_t signatures) {
+	const struct signature_requirement *req;
+	gpgme_signature_t sig;
+	time_t until = 0;
+	size_t i;
+	int j;
+
+	for (req = requirements ; req != NULL ; req = req->next) {
+		for (i = 0 ; i < req->num_keys ; i++) {
+			const struct known_key *k = req->keys[i].key;
+
+			for (j = 0 ; j < k->count ; j++) {
+				time_t t = k->subkeys[j].expires;
+
+				if (t > 0 && (until == 0 || t < until))
+					until = t;
+			}
+		}
+	}
+	for (sig = signatures ; sig != NULL ; sig = sig->next) {
+		time_t t = sig->exp_timestamp;
+
+		if (t > 0 && (until == 0 || t < until))
+			until = t;
+	}
+	return until;
+}
+
+/* perfect_p is set to false, if some requirement was only fulfilled by
+ * ignoring some problem (so that it is warned about every time) */
+static inline retvalue verify_signature(const struct signature_requirement *requirements, const char *releasegpg, const char *releasename, /*@out@*/bool *perfect_p, /*@out@*/time_t *validuntil_p) {
 	gpgme_verify_result_t result;
 	int i;
 	const struct signature_requirement *req;
 
+	*perfect_p = true;
 	result = gpgme_op_verify_result(context);
 	if (result == NULL) {
 		fprintf(stderr,
@@ -639,6 +677,7 @@ static inline retvalue verify_signature(const struct signature_requirement *requ
 			if (key_good_enough(&req->keys[i], result->signatures,
 						releasegpg, releasename)) {
 				fulfilled = true;
+				*perfect_p = false;
 				break;
 			}
 		}
@@ -657,13 +696,169 @@ static inline retvalue verify_signature(const struct signature_requirement *requ
 	}
 	if (verbose > 20)
 		print_signatures(stdout, result->signatures, releasegpg);
+	*validuntil_p = verify_validuntil(requirements, result->signatures);
+	return RET_OK;
+}
+
+/* Successful checks are remembered in the database (if one is open).
+ * They are stored by the name of the signed file, so a newer check of
+ * a file replaces the older one, together with the SHA256 of the signed
+ * file (and data), the conditions and the state of the keys they name
+ * in the keyring, so newly revoked or expired keys cause a new check.
+ * A result is only reused until the first of those keys or signatures
+ * expires (and dropped after that). */
+
+#define CACHEHASHLEN (2 * SHA256_DIGEST_SIZE)
+
+static retvalue hash_file(struct SHA256_Context *c, const char *filename) {
+	unsigned char buffer[4096];
+	ssize_t got;
+	int fd, e;
+
+	fd = open(filename, O_RDONLY|O_NOCTTY);
+	if (fd < 0) {
+		e = errno;
+		fprintf(stderr, "Error opening '%s': %s\n",
+				filename, strerror(e));
+		return RET_ERRNO(e);
+	}
+	while ((got = read(fd, buffer, sizeof(buffer))) > 0)
+		SHA256Update(c, buffer, got);
+	e = errno;
+	(void)close(fd);
+	if (got < 0) {
+		fprintf(stderr, "Error reading '%s': %s\n",
+				filename, strerror(e));
+		return RET_ERRNO(e);
+	}
 	return RET_OK;
 }
 
+static retvalue calc_cachehash(const struct signature_requirement *requirements, const char *signedfile, /*@null@*/const char *data, size_t len, /*@out@*/char hash[CACHEHASHLEN + 1]) {
+	struct SHA256_Context c;
+	uint8_t digest[SHA256_DIGEST_SIZE];
+	const struct signature_requirement *req;
+	char buffer[100];
+	size_t i;
+	int j;
+	retvalue r;
+
+	SHA256Init(&c);
+	for (req = requirements ; req != NULL ; req = req->next) {
+		SHA256Update(&c, (const uint8_t*)req->condition,
+				strlen(req->condition) + 1);
+		for (i = 0 ; i < req->num_keys ; i++) {
+			const struct known_key *k = req->keys[i].key;
+
+			for (j = 0 ; j < k->count ; j++) {
+				const struct known_subkey *sk = &k->subkeys[j];
+
+				SHA256Update(&c, (const uint8_t*)sk->name,
+						sk->name_len);
+				snprintf(buffer, sizeof(buffer),
+						" %d%d%d %lld\n",
+						(int)sk->revoked,
+						(int)sk->expired,
+						(int)sk->cansign,
+						(long long)sk->expires);
+				SHA256Update(&c, (const uint8_t*)buffer,
+						strlen(buffer));
+			}
+		}
+	}
+	/* the data a detached signature is about: */
+	snprintf(buffer, sizeof(buffer), "%s%llu\n",
+			(data == NULL)?"inline":"detached",
+			(unsigned long long)len);
+	SHA256Update(&c, (const uint8_t*)buffer, strlen(buffer));
+	if (data != NULL)
+		SHA256Update(&c, (const uint8_t*)data, len);
+	r = hash_file(&c, signedfile);
+	if (RET_WAS_ERROR(r))
+		return r;
+	SHA256Final(&c, digest);
+	for (i = 0 ; i < SHA256_DIGEST_SIZE ; i++)
+		snprintf(hash + 2 * i, 3, "%02x", (unsigned int)digest[i]);
+	return RET_OK;
+}
+
+/* RET_OK if there is a still valid result, then *chunk_p is set to the
+ * signed data (if chunk_p is not NULL).
+ * RET_NOTHING if the signature has to be checked, *cache_p is
+ * then the cache to store the result in (or NULL if there is none). */
+static retvalue cache_lookup(const struct signature_requirement *requirements, const char *signedfile, /*@null@*/const char *data, size_t len, /*@out@*/struct table **cache_p, /*@out@*/char hash[CACHEHASHLEN + 1], /*@null@*/char **chunk_p) {
+	struct table *cache;
+	const char *value, *p;
+	size_t valuelen;
+	long long until;
+	retvalue r;
+
+	*cache_p = NULL;
+	r = database_opensignaturecache(&cache);
+	if (!RET_IS_OK(r))
+		/* without a cache just do the check */
+		return RET_NOTHING;
+	r = calc_cachehash(requirements, signedfile, data, len, hash);
+	if (RET_WAS_ERROR(r))
+		return r;
+	*cache_p = cache;
+	r = table_gettemprecord(cache, signedfile, &value, &valuelen);
+	if (!RET_IS_OK(r))
+		return RET_NOTHING;
+	/* the result of the check of another version of the file
+	 * (or with other keys) is replaced after checking this one */
+	if (valuelen <= CACHEHASHLEN || value[CACHEHASHLEN] != '\n' ||
+			memcmp(value, hash, CACHEHASHLEN) != 0)
+		return RET_NOTHING;
+	until = strtoll(value + CACHEHASHLEN + 1, (char**)&p, 10);
+	if (*p != '\n')
+		return RET_NOTHING;
+	p++;
+	if (until != 0 && until <= (long long)time(NULL)) {
+		/* no longer of any use, even if the check fails now */
+		(void)table_deleterecord(cache, signedfile, true);
+		return RET_NOTHING;
+	}
+	if (chunk_p != NULL) {
+		*chunk_p = strndup(p, valuelen - (p - value));
+		if (FAILEDTOALLOC(*chunk_p))
+			return RET_ERROR_OOM;
+	}
+	if (verbose > 10)
+		printf("Using cached result of the signature check of '%s'.\n",
+				signedfile);
+	return RET_OK;
+}
+
+static void cache_store(struct table *cache, const char *signedfile, const char hash[CACHEHASHLEN + 1], time_t validuntil, /*@null@*/const char *chunk) {
+	char *value;
+	size_t len;
+
+	if (chunk == NULL)
+		chunk = "";
+	len = strlen(chunk);
+	value = malloc(CACHEHASHLEN + len + 30);
+	if (FAILEDTOALLOC(value))
+		return;
+	snprintf(value, CACHEHASHLEN + 30, "%s\n%lld\n",
+			hash, (long long)validuntil);
+	len += strlen(value);
+	strcat(value, chunk);
+	/* if this fails, the check is only done again next time */
+	(void)table_adduniqsizedrecord(cache, signedfile, value, len + 1,
+			true, false);
+	free(value);
+}
+
 retvalue signature_check(const struct signature_requirement *requirements, const char *releasegpg, const char *releasename, const char *releasedata, size_t releaselen) {
 	gpg_error_t err;
 	int gpgfd;
 	gpgme_data_t dh, dh_gpg;
+	struct table *cache;
+	char cachehash[CACHEHASHLEN + 1];
+	bool perfect;
+	time_t validuntil;
+	retvalue r;
 
 	assert (requirements != NULL);
 
@@ -672,6 +867,11 @@ retvalue signature_check(const struct signature_requirement *requirements, const
 
 	assert (context != NULL);
 
+	r = cache_lookup(requirements, releasegpg, releasedata, releaselen,
+			&cache, cachehash, NULL);
+	if (r != RET_NOTHING)
+		return r;
+
 	/* Read the file and its signature into memory: */
 	gpgfd = open(releasegpg, O_RDONLY|O_NOCTTY);
 	if (gpgfd < 0) {
@@ -703,13 +903,28 @@ retvalue signature_check(const struct signature_requirement *requirements, const
 		return gpgerror(err);
 	}
 
-	return verify_signature(requirements, releasegpg, releasename);
+	r = verify_signature(requirements, releasegpg, releasename,
+			&perfect, &validuntil);
+	if (RET_IS_OK(r) && perfect && cache != NULL)
+		cache_store(cache, releasegpg, cachehash, validuntil, NULL);
+	return r;
 }
 
 retvalue signature_check_inline(const struct signature_requirement *requirements, const char *filename, char **chunk_p) {
 	gpg_error_t err;
 	gpgme_data_t dh, dh_gpg;
 	int fd;
+	struct table *cache = NULL;
+	char cachehash[CACHEHASHLEN + 1];
+
+	if (requirements != NULL) {
+		retvalue r;
+
+		r = cache_lookup(requirements, filename, NULL, 0,
+				&cache, cachehash, chunk_p);
+		if (r != RET_NOTHING)
+			return r;
+	}
 
 	fd = open(filename, O_RDONLY|O_NOCTTY);
 	if (fd < 0) {
@@ -770,6 +985,8 @@ retvalue signature_check_inline(const struct signature_requirement *requirements
 		char *plain_data, *chunk;
 		const char *n;
 		size_t plain_len, len;
+		bool perfect = false;
+		time_t validuntil = 0;
 		retvalue r;
 
 		if (err != 0) {
@@ -806,11 +1023,15 @@ retvalue signature_check_inline(const struct signature_requirement *requirements
 				filename);
 			r = RET_ERROR;
 		} else
-			r = verify_signature(requirements, filename, NULL);
+			r = verify_signature(requirements, filename, NULL,
+					&perfect, &validuntil);
 		if (RET_IS_OK(r)) {
 			*chunk_p = realloc(chunk, len+1);
 			if (FAILEDTOALLOC(*chunk_p))
 				*chunk_p = chunk;
+			if (perfect && cache != NULL)
+				cache_store(cache, filename, cachehash,
+						validuntil, *chunk_p);
 		} else
 			free(chunk);
 		return r;
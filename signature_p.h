@@ -14,5 +14,14 @@ extern gpgme_ctx_t context;
 
 #ifdef HAVE_LIBGPGME
 retvalue gpgerror(gpg_error_t err);
+
+/* a context of its own for the calling thread, to be given back
+ * with gpgcontext_put when done */
+struct gpgcontext {
+	struct gpgcontext *next;
+	gpgme_ctx_t ctx;
+};
+retvalue gpgcontext_get(/*@out@*/struct gpgcontext **);
+void gpgcontext_put(/*@only@*/struct gpgcontext *);
 #endif
 #endif
@@ -39,12 +39,12 @@
 #include "hooks.h"
 
 #ifdef HAVE_LIBGPGME
-static retvalue check_signature_created(bool clearsign, bool willcleanup, /*@null@*/const struct strlist *options, const char *filename, const char *signaturename) {
+static retvalue check_signature_created(gpgme_ctx_t ctx, bool clearsign, bool willcleanup, /*@null@*/const struct strlist *options, const char *filename, const char *signaturename) {
 	gpgme_sign_result_t signresult;
 	char *uidoptions;
 	int i;
 
-	signresult = gpgme_op_sign_result(context);
+	signresult = gpgme_op_sign_result(ctx);
 	if (signresult != NULL && signresult->signatures != NULL)
 		return RET_OK;
 	/* in an ideal world, this point is never reached.
@@ -141,7 +141,7 @@ static retvalue signature_to_file(gpgme_data_t dh_gpg, const char *signaturename
 	return RET_OK;
 }
 
-static retvalue create_signature(bool clearsign, gpgme_data_t dh, /*@null@*/const struct strlist *options, const char *filename, const char *signaturename, bool willcleanup) {
+static retvalue create_signature(gpgme_ctx_t ctx, bool clearsign, gpgme_data_t dh, /*@null@*/const struct strlist *options, const char *filename, const char *signaturename, bool willcleanup) {
 	gpg_error_t err;
 	gpgme_data_t dh_gpg;
 	retvalue r;
@@ -149,11 +149,13 @@ static retvalue create_signature(bool clearsign, gpgme_data_t dh, /*@null@*/cons
 	err = gpgme_data_new(&dh_gpg);
 	if (err != 0)
 		return gpgerror(err);
-	err = gpgme_op_sign(context, dh, dh_gpg,
+	err = gpgme_op_sign(ctx, dh, dh_gpg,
 			clearsign?GPGME_SIG_MODE_CLEAR:GPGME_SIG_MODE_DETACH);
-	if (err != 0)
+	if (err != 0) {
+		gpgme_data_release(dh_gpg);
 		return gpgerror(err);
-	r = check_signature_created(clearsign, willcleanup,
+	}
+	r = check_signature_created(ctx, clearsign, willcleanup,
 			options, filename, signaturename);
 	if (RET_WAS_ERROR(r)) {
 		gpgme_data_release(dh_gpg);
@@ -163,20 +165,13 @@ static retvalue create_signature(bool clearsign, gpgme_data_t dh, /*@null@*/cons
 	return signature_to_file(dh_gpg, signaturename);
 }
 
-static retvalue signature_sign(const struct strlist *options, const char *filename, void *data, size_t datalen, const char *signaturename, const char *clearsignfilename, bool willcleanup) {
+static retvalue sign_with_context(gpgme_ctx_t ctx, const struct strlist *options, const char *filename, void *data, size_t datalen, const char *signaturename, const char *clearsignfilename, bool willcleanup) {
 	retvalue r;
 	int i;
 	gpg_error_t err;
 	gpgme_data_t dh;
 
-	assert (options != NULL && options->count > 0);
-	assert (options->values[0][0] != '!');
-
-	r = signature_init(false);
-	if (RET_WAS_ERROR(r))
-		return r;
-
-	gpgme_signers_clear(context);
+	gpgme_signers_clear(ctx);
 	if (options->count == 1 &&
 			(strcasecmp(options->values[0], "yes") == 0 ||
 			  strcasecmp(options->values[0], "default") == 0)) {
@@ -186,22 +181,23 @@ static retvalue signature_sign(const struct strlist *options, const char *filena
 		const char *option = options->values[i];
 		gpgme_key_t key;
 
-		err = gpgme_op_keylist_start(context, option, 1);
+		err = gpgme_op_keylist_start(ctx, option, 1);
 		if (err != 0)
 			return gpgerror(err);
-		err = gpgme_op_keylist_next(context, &key);
+		err = gpgme_op_keylist_next(ctx, &key);
 		if (gpg_err_code(err) == GPG_ERR_EOF) {
 			fprintf(stderr,
 "Could not find any key matching '%s'!\n", option);
+			gpgme_op_keylist_end(ctx);
 			return RET_ERROR;
 		}
-		err = gpgme_signers_add(context, key);
+		err = gpgme_signers_add(ctx, key);
 		gpgme_key_unref(key);
 		if (err != 0) {
-			gpgme_op_keylist_end(context);
+			gpgme_op_keylist_end(ctx);
 			return gpgerror(err);
 		}
-		gpgme_op_keylist_end(context);
+		gpgme_op_keylist_end(ctx);
 	}
 
 	err = gpgme_data_new_from_mem(&dh, data, datalen, 0);
@@ -209,7 +205,7 @@ static retvalue signature_sign(const struct strlist *options, const char *filena
 		return gpgerror(err);
 	}
 
-	r = create_signature(false, dh, options,
+	r = create_signature(ctx, false, dh, options,
 			filename, signaturename, willcleanup);
 	if (RET_WAS_ERROR(r)) {
 		gpgme_data_release(dh);
@@ -224,13 +220,31 @@ static retvalue signature_sign(const struct strlist *options, const char *filena
 		gpgme_data_release(dh);
 		return RET_ERRNO(e);
 	}
-	r = create_signature(true, dh, options,
+	r = create_signature(ctx, true, dh, options,
 			filename, clearsignfilename, willcleanup);
 	gpgme_data_release(dh);
 	if (RET_WAS_ERROR(r))
 		return r;
 	return RET_OK;
 }
+
+static retvalue signature_sign(const struct strlist *options, const char *filename, void *data, size_t datalen, const char *signaturename, const char *clearsignfilename, bool willcleanup) {
+	struct gpgcontext *gc;
+	retvalue r;
+
+	assert (options != NULL && options->count > 0);
+	assert (options->values[0][0] != '!');
+
+	/* Release files of multiple distributions may be signed
+	 * at the same time, so each needs a context of its own */
+	r = gpgcontext_get(&gc);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = sign_with_context(gc->ctx, options, filename, data, datalen,
+			signaturename, clearsignfilename, willcleanup);
+	gpgcontext_put(gc);
+	return r;
+}
 #endif /* HAVE_LIBGPGME */
 
 static retvalue signature_with_extern(const struct strlist *options, const char *filename, const char *clearsignfilename, char **detachedfilename_p) {
@@ -404,7 +418,7 @@ void signedfile_write(struct signedfile *f, const void *data, size_t len) {
 	assert (f->bufferlen <= f->buffersize);
 }
 
-retvalue signedfile_create(struct signedfile *f, const char *newplainfilename, char **newsignedfilename_p, char **newdetachedsignature_p, const struct strlist *options, bool willcleanup) {
+retvalue signedfile_create(struct signedfile *f, const char *newplainfilename) {
 	size_t len, ofs;
 	int fd, ret;
 
@@ -452,7 +466,15 @@ retvalue signedfile_create(struct signedfile *f, const char *newplainfilename, c
 				strerror(e));
 		return RET_ERRNO(e);
 	}
-	/* now do the actual signing */
+	return RET_OK;
+}
+
+/* This may be called for multiple files at the same time,
+ * so it may only change things belonging to this file */
+retvalue signedfile_sign(struct signedfile *f, const char *newplainfilename, char **newsignedfilename_p, char **newdetachedsignature_p, const struct strlist *options, bool willcleanup) {
+	if (RET_WAS_ERROR(f->result))
+		return f->result;
+
 	if (options != NULL && options->count > 0) {
 		retvalue r;
 		const char *newsigned = *newsignedfilename_p;
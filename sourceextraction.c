@@ -37,6 +37,9 @@
 
 struct sourceextraction {
 	bool failed, completed;
+	/* there is a .debian.tar, so the debian/ directory of the
+	 * .orig.tar is not used (format 3.0 (quilt)) */
+	bool hasdebiantar;
 	int difffile, tarfile, debiantarfile;
 	enum compression diffcompression, tarcompression, debiancompression;
 	/*@null@*/ char **section_p, **priority_p;
@@ -82,6 +85,7 @@ void sourceextraction_setpart(struct sourceextraction *e, int i, const char *bas
 		e->diffcompression = c;
 		return;
 	} else if (endswith(basefilename, bl, ".debian.tar")) {
+		e->hasdebiantar = true;
 		e->debiantarfile = i;
 		e->debiancompression = c;
 		return;
@@ -99,6 +103,9 @@ void sourceextraction_setpart(struct sourceextraction *e, int i, const char *bas
 bool sourceextraction_needs(struct sourceextraction *e, int *ofs_p) {
 	if (e->failed || e->completed)
 		return false;
+	if (e->section_p == NULL && e->priority_p == NULL)
+		/* nothing to look for */
+		return false;
 	if (e->difffile >= 0) {
 		if (!uncompression_supported(e->diffcompression))
 			// TODO: errormessage
@@ -114,7 +121,10 @@ bool sourceextraction_needs(struct sourceextraction *e, int *ofs_p) {
 #else
 		return false;
 #endif
-	} else if (e->tarfile >= 0) {
+	} else if (e->tarfile >= 0 && !e->hasdebiantar) {
+		/* The .orig.tar can be huge, so it is only looked at
+		 * if there is nothing else. With a .debian.tar its
+		 * debian/control (if there is any) is not used anyway */
 #ifdef HAVE_LIBARCHIVE
 		if (!uncompression_supported(e->tarcompression))
 			return false;
@@ -512,6 +522,11 @@ static retvalue read_source_control_file(struct sourceextraction *e, struct arch
 	return RET_OK;
 }
 
+struct tarsource {
+	struct compressedfile *file;
+	char buffer[4096];
+};
+
 static int compressedfile_open(UNUSED(struct archive *a), UNUSED(void *v)) {
 	return ARCHIVE_OK;
 }
@@ -521,18 +536,26 @@ static int compressedfile_close(UNUSED(struct archive *a), UNUSED(void *v)) {
 }
 
 static ssize_t compressedfile_read(UNUSED(struct archive *a), void *d, const void **buffer_p) {
-	struct compressedfile *f = d;
-	// TODO malloc buffer instead
-	static char mybuffer[4096];
+	struct tarsource *t = d;
+
+	*buffer_p = t->buffer;
+	return uncompress_read(t->file, t->buffer, sizeof(t->buffer));
+}
+
+/* the contents of files in an uncompressed tar need not be read */
+static int64_t compressedfile_skip(UNUSED(struct archive *a), void *d, int64_t request) {
+	struct tarsource *t = d;
 
-	*buffer_p = mybuffer;
-	return uncompress_read(f, mybuffer, 4096);
+	if (request <= 0)
+		return 0;
+	return uncompress_skip(t->file, request);
 }
 
 static retvalue parse_tarfile(struct sourceextraction *e, const char *filename, enum compression c, /*@out@*/bool *found_p) {
 	struct archive *tar;
 	struct archive_entry *entry;
 	struct compressedfile *file;
+	struct tarsource source;
 	int a;
 	retvalue r, r2;
 
@@ -557,8 +580,10 @@ static retvalue parse_tarfile(struct sourceextraction *e, const char *filename,
 		return r;
 	}
 
-	a = archive_read_open(tar, file, compressedfile_open,
-			compressedfile_read, compressedfile_close);
+	source.file = file;
+	a = archive_read_open2(tar, &source, compressedfile_open,
+			compressedfile_read, compressedfile_skip,
+			compressedfile_close);
 	if (a != ARCHIVE_OK) {
 		int err = archive_errno(tar);
 		if (err != -EINVAL && err != 0)
@@ -613,8 +638,11 @@ static retvalue parse_tarfile(struct sourceextraction *e, const char *filename,
 			uncompress_abort(file);
 			return r;
 		}
-		if (interrupted())
+		if (interrupted()) {
+			archive_read_free(tar);
+			uncompress_abort(file);
 			return RET_ERROR_INTERRUPTED;
+		}
 	}
 	if (a != ARCHIVE_EOF) {
 		int err = archive_errno(tar);
@@ -690,7 +718,7 @@ retvalue sourceextraction_analyse(struct sourceextraction *e, const char *fullfi
 #endif
 
 	/* if it's not the diff nor the .debian.tar, look into the .tar file: */
-	assert (e->tarfile >= 0);
+	assert (e->tarfile >= 0 && !e->hasdebiantar);
 	e->tarfile = -1;
 
 #ifdef HAVE_LIBARCHIVE
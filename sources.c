@@ -119,18 +119,16 @@ static retvalue getBasenames(const struct strlist *filelines, /*@out@*/struct st
 	return r;
 }
 
-retvalue sources_getversion(const char *control, char **version) {
-	retvalue r;
+retvalue sources_getversion(const char *control, struct chunkvalue *version) {
+	static const char * const versionfield[1] = { "Version" };
 
-	r = chunk_getvalue(control, "Version", version);
-	if (RET_WAS_ERROR(r))
-		return r;
-	if (r == RET_NOTHING) {
+	chunk_getvalues(control, 1, versionfield, version);
+	if (version->value == NULL) {
 		fprintf(stderr, "Missing 'Version' field in chunk:'%s'\n",
 				control);
 		return RET_ERROR;
 	}
-	return r;
+	return RET_OK;
 }
 
 retvalue sources_getarchitecture(UNUSED(const char *chunk), architecture_t *architecture_p) {
@@ -147,12 +145,16 @@ retvalue sources_getinstalldata(const struct target *t, struct package *package,
 	enum checksumtype cs;
 	bool gothash = false;
 	const char *chunk = package->control;
+	struct chunkindex ci;
 
 	assert (package->architecture == architecture_source);
 
+	r = chunkindex_init(&ci, chunk);
+	if (RET_WAS_ERROR(r))
+		return r;
 	for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++) {
 		assert (source_checksum_names[cs] != NULL);
-		r = chunk_getextralinelist(chunk, source_checksum_names[cs],
+		r = chunkindex_getextralinelist(&ci, source_checksum_names[cs],
 				&filelines[cs]);
 		if (r == RET_NOTHING)
 			strlist_init(&filelines[cs]);
@@ -160,6 +162,7 @@ retvalue sources_getinstalldata(const struct target *t, struct package *package,
 			while (cs-- > cs_md5sum) {
 				strlist_done(&filelines[cs]);
 			}
+			chunkindex_done(&ci);
 			return r;
 		} else
 			gothash = true;
@@ -170,16 +173,20 @@ retvalue sources_getinstalldata(const struct target *t, struct package *package,
 				chunk);
 		for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++)
 			strlist_done(&filelines[cs]);
+		chunkindex_done(&ci);
 		return RET_ERROR;
 	}
 	r = checksumsarray_parse(&files, filelines, package->name);
 	for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++) {
 		strlist_done(&filelines[cs]);
 	}
-	if (RET_WAS_ERROR(r))
+	if (RET_WAS_ERROR(r)) {
+		chunkindex_done(&ci);
 		return r;
+	}
 
-	r = chunk_getvalue(chunk, "Directory", &origdirectory);
+	r = chunkindex_getvalue(&ci, "Directory", &origdirectory);
+	chunkindex_done(&ci);
 	if (r == RET_NOTHING) {
 /* Flat repositories can come without this, TODO: add warnings in other cases
 		fprintf(stderr, "Missing 'Directory' entry in '%s'!\n", chunk);
@@ -294,15 +301,22 @@ retvalue sources_getchecksums(const char *chunk, struct checksumsarray *out) {
 	retvalue r;
 	struct strlist filelines[cs_hashCOUNT];
 	enum checksumtype cs;
+	struct chunkindex ci;
+
+	r = chunkindex_init(&ci, chunk);
+	if (RET_WAS_ERROR(r))
+		return r;
 
 	/* Read the directory given there */
-	r = chunk_getvalue(chunk, "Directory", &origdirectory);
-	if (!RET_IS_OK(r))
+	r = chunkindex_getvalue(&ci, "Directory", &origdirectory);
+	if (!RET_IS_OK(r)) {
+		chunkindex_done(&ci);
 		return r;
+	}
 
 	for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++) {
 		assert (source_checksum_names[cs] != NULL);
-		r = chunk_getextralinelist(chunk, source_checksum_names[cs],
+		r = chunkindex_getextralinelist(&ci, source_checksum_names[cs],
 				&filelines[cs]);
 		if (r == RET_NOTHING) {
 			if (cs == cs_md5sum) {
@@ -318,9 +332,11 @@ retvalue sources_getchecksums(const char *chunk, struct checksumsarray *out) {
 				strlist_done(&filelines[cs]);
 			}
 			free(origdirectory);
+			chunkindex_done(&ci);
 			return r;
 		}
 	}
+	chunkindex_done(&ci);
 	r = checksumsarray_parse(&a, filelines, "source chunk");
 	for (cs = cs_md5sum ; cs < cs_hashCOUNT ; cs++) {
 		strlist_done(&filelines[cs]);
@@ -398,6 +414,15 @@ retvalue sources_retrack(const char *sourcename, const char *chunk, trackingdb t
 		return r;
 	}
 
+	/* when retracking the files are usually already known,
+	 * then there is no need to parse and rewrite the data */
+	r = tracking_usefilekeys(tracks, sourcename, sourceversion,
+			ft_SOURCE, &filekeys);
+	if (r != RET_NOTHING) {
+		free(sourceversion);
+		strlist_done(&filekeys);
+		return r;
+	}
 	r = tracking_getornew(tracks, sourcename, sourceversion, &pkg);
 	free(sourceversion);
 	if (RET_WAS_ERROR(r)) {
@@ -422,30 +447,17 @@ retvalue sources_retrack(const char *sourcename, const char *chunk, trackingdb t
 	return tracking_save(tracks, pkg);
 }
 
-retvalue sources_getsourceandversion(const char *chunk, const char *packagename, char **source, char **version) {
+retvalue sources_getsourceandversion(const char *chunk, const char *packagename, struct chunkvalue *source, struct chunkvalue *version) {
 	retvalue r;
-	char *sourceversion;
-	char *sourcename;
 
 	//TODO: eliminate duplicate code!
 	assert(packagename!=NULL);
 
-	r = chunk_getvalue(chunk, "Version", &sourceversion);
-	if (r == RET_NOTHING) {
-		fprintf(stderr, "Missing 'Version' field in chunk:'%s'\n",
-				chunk);
-		r = RET_ERROR;
-	}
-	if (RET_WAS_ERROR(r)) {
+	r = sources_getversion(chunk, version);
+	if (RET_WAS_ERROR(r))
 		return r;
-	}
-	sourcename = strdup(packagename);
-	if (FAILEDTOALLOC(sourcename)) {
-		free(sourceversion);
-		return RET_ERROR_OOM;
-	}
-	*source = sourcename;
-	*version = sourceversion;
+	source->value = packagename;
+	source->len = strlen(packagename);
 	return RET_OK;
 }
 
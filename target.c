@@ -43,6 +43,8 @@
 #include "descriptions.h"
 #include "package.h"
 #include "target.h"
+#include "contents.h"
+#include "filelist.h"
 
 static char *calc_identifier(const char *codename, component_t component, architecture_t architecture, packagetype_t packagetype) {
 	assert (strchr(codename, '|') == NULL);
@@ -667,6 +669,13 @@ retvalue target_addpackage(struct target *target, struct logger *logger, const c
 		target->wasmodified = true;
 		if (trackingdata == NULL)
 			target->staletracking = true;
+		/* if not yet known, read the list of files before
+		 * the next export needs it. (If this fails, the
+		 * export reads it itself.) */
+		if (target->packagetype != pt_dsc && filekeys->count > 0 &&
+				contents_wanted(target->distribution,
+					target->packagetype))
+			(void)filelist_queue(filekeys->values[0]);
 	}
 	free(newcontrol);
 	package_done(&old);
@@ -1121,6 +1130,29 @@ retvalue package_get(struct target *target, const char *name, const char *versio
 	return result;
 }
 
+/* copy a value into one of the buffers of the package, which
+ * iterators keep for the next package, so that a scan over all
+ * packages of a target does not need to allocate for each one */
+static retvalue package_keepvalue(char **buffer_p, size_t *size_p, const char *value, size_t len, /*@out@*/const char **value_p) {
+	char *buffer = *buffer_p;
+
+	if (buffer == NULL || *size_p <= len) {
+		size_t size = (len < 64) ? 64 : len + 1;
+
+		free(buffer);
+		*size_p = 0;
+		buffer = malloc(size);
+		*buffer_p = buffer;
+		if (FAILEDTOALLOC(buffer))
+			return RET_ERROR_OOM;
+		*size_p = size;
+	}
+	memcpy(buffer, value, len);
+	buffer[len] = '\0';
+	*value_p = buffer;
+	return RET_OK;
+}
+
 retvalue package_openiterator(struct target *t, bool readonly, bool duplicate, /*@out@*/struct package_cursor *tc) {
 	retvalue r, r2;
 	struct cursor *c;
@@ -1143,6 +1175,37 @@ retvalue package_openiterator(struct target *t, bool readonly, bool duplicate, /
 	}
 	tc->target = t;
 	tc->cursor = c;
+	tc->bysource = false;
+	memset(&tc->current, 0, sizeof(tc->current));
+	return RET_OK;
+}
+
+retvalue package_opensourceiterator(struct target *t, const char *source, bool readonly, /*@out@*/struct package_cursor *tc) {
+	retvalue r, r2;
+	struct cursor *c;
+
+	if (verbose >= 15)
+		fprintf(stderr, "trace: package_opensourceiterator(target={identifier: %s}, source=%s, readonly=%s) called.\n",
+		        t->identifier, source, readonly ? "true" : "false");
+
+	tc->close_database = t->packages == NULL;
+	r = target_initpackagesdb(t, readonly);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r))
+		return r;
+	r = table_newsourcecursor(t->packages, source, &c);
+	if (r == RET_NOTHING)
+		/* no index, so look at everything */
+		r = table_newglobalcursor(t->packages, true, &c);
+	assert (r != RET_NOTHING);
+	if (RET_WAS_ERROR(r)) {
+		r2 = target_closepackagesdb(t);
+		RET_UPDATE(r, r2);
+		return r;
+	}
+	tc->target = t;
+	tc->cursor = c;
+	tc->bysource = table_hassourceindex(t->packages);
 	memset(&tc->current, 0, sizeof(tc->current));
 	return RET_OK;
 }
@@ -1172,21 +1235,54 @@ retvalue package_openduplicateiterator(struct target *t, const char *name, long
 	tc->current.target = t;
 	tc->target = t;
 	tc->cursor = c;
+	tc->bysource = false;
 	return RET_OK;
 }
 
+/* forget the current package of an iterator, but keep the buffers
+ * for the values extracted, as the next package needs them, too */
+static void package_reset(struct package *pkg) {
+	free(pkg->pkgchunk);
+	pkg->pkgchunk = NULL;
+	pkg->name = NULL;
+	pkg->control = NULL;
+	pkg->controllen = 0;
+	pkg->version = NULL;
+	pkg->source = NULL;
+	pkg->sourceversion = NULL;
+	pkg->architecture = atom_unknown;
+}
+
 bool package_next(struct package_cursor *tc) {
 	bool success;
 
 	if (verbose >= 15)
 		fprintf(stderr, "trace: package_next(tc={current: {name: %s, version: %s}}) called.\n", tc->current.name, tc->current.version);
 
-	package_done(&tc->current);
-	success = cursor_nexttempdata(tc->target->packages, tc->cursor,
-			&tc->current.name, &tc->current.control,
-			&tc->current.controllen);
+	package_reset(&tc->current);
+	if (tc->bysource) {
+		const char *key, *separator;
+
+		success = cursor_nextsourcedata(tc->target->packages,
+				tc->cursor, &key, &tc->current.control,
+				&tc->current.controllen);
+		if (success) {
+			/* the key is name|version */
+			separator = strchr(key, '|');
+			if (separator == NULL)
+				separator = key + strlen(key);
+			success = RET_IS_OK(package_keepvalue(
+					&tc->current.pkgname,
+					&tc->current.pkgnamesize,
+					key, separator - key,
+					&tc->current.name));
+		}
+	} else
+		success = cursor_nexttempdata(tc->target->packages, tc->cursor,
+				&tc->current.name, &tc->current.control,
+				&tc->current.controllen);
 	if (!success)
-		memset(&tc->current, 0, sizeof(tc->current));
+		package_done(&tc->current);
 	else
 		tc->current.target = tc->target;
 	return success;
@@ -1207,16 +1303,18 @@ retvalue package_closeiterator(struct package_cursor *tc) {
 }
 
 retvalue package_getversion(struct package *package) {
+	struct chunkvalue version;
 	retvalue r;
 
 	if (package->version != NULL)
 		return RET_OK;
 
-	r = package->target->getversion(package->control, &package->pkgversion);
-	if (RET_IS_OK(r)) {
-		assert (package->pkgversion != NULL);
-		package->version = package->pkgversion;
-	}
+	r = package->target->getversion(package->control, &version);
+	if (RET_IS_OK(r))
+		r = package_keepvalue(&package->pkgversion,
+				&package->pkgversionsize,
+				version.value, version.len,
+				&package->version);
 	return r;
 }
 
@@ -1229,17 +1327,25 @@ retvalue package_getarchitecture(struct package *package) {
 }
 
 retvalue package_getsource(struct package *package) {
+	struct chunkvalue source, version;
 	retvalue r;
 
 	if (package->source != NULL)
 		return RET_OK;
 
 	r = package->target->getsourceandversion(package->control, package->name,
-			&package->pkgsource, &package->pkgsrcversion);
-	if (RET_IS_OK(r)) {
-		assert (package->pkgsource != NULL);
-		package->source = package->pkgsource;
-		package->sourceversion = package->pkgsrcversion;
-	}
+			&source, &version);
+	if (RET_IS_OK(r))
+		r = package_keepvalue(&package->pkgsource,
+				&package->pkgsourcesize,
+				source.value, source.len,
+				&package->source);
+	if (RET_IS_OK(r))
+		r = package_keepvalue(&package->pkgsrcversion,
+				&package->pkgsrcversionsize,
+				version.value, version.len,
+				&package->sourceversion);
+	if (!RET_IS_OK(r))
+		package->source = NULL;
 	return r;
 }
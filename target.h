@@ -25,8 +25,11 @@
 
 struct target;
 struct alloverrides;
+struct chunkvalue;
 
-typedef retvalue get_version(const char *, /*@out@*/char **);
+/* the version (and source) are returned pointing into the chunk
+ * (or the packagename), not copied */
+typedef retvalue get_version(const char *, /*@out@*/struct chunkvalue *);
 typedef retvalue get_architecture(const char *, /*@out@*/architecture_t *);
 struct package;
 typedef retvalue get_installdata(const struct target *, struct package *, /*@out@*/char **, /*@out@*/struct strlist *, /*@out@*/struct checksumsarray *);
@@ -35,7 +38,7 @@ typedef retvalue get_filekeys(const char *, /*@out@*/struct strlist *);
 typedef retvalue get_checksums(const char *, /*@out@*/struct checksumsarray *);
 typedef retvalue do_reoverride(const struct target *, const char * /*packagename*/, const char *, /*@out@*/char **);
 typedef retvalue do_retrack(const char * /*packagename*/, const char * /*controlchunk*/, trackingdb);
-typedef retvalue get_sourceandversion(const char *, const char * /*packagename*/, /*@out@*/char ** /*source_p*/, /*@out@*/char ** /*version_p*/);
+typedef retvalue get_sourceandversion(const char *, const char * /*packagename*/, /*@out@*/struct chunkvalue * /*source_p*/, /*@out@*/struct chunkvalue * /*version_p*/);
 typedef retvalue complete_checksums(const char *, const struct strlist *, struct checksums **, /*@out@*/char **);
 
 struct distribution;
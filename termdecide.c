@@ -32,16 +32,26 @@
 #include "terms.h"
 #include "termdecide.h"
 
-static inline bool check_field(enum term_comparison c, const char *value, const char *with) {
+/* compare a value that is not 0-terminated like strcmp would */
+static inline int compare_n(const char *value, size_t len, const char *with) {
+	int i = strncmp(value, with, len);
+
+	if (i != 0)
+		return i;
+	/* value has no '\0' in it, so with is at least as long */
+	return (with[len] == '\0') ? 0 : -1;
+}
+
+static inline bool check_field_n(enum term_comparison c, const char *value, size_t len, const char *with) {
 	if (c == tc_none) {
 		return true;
 	} else if (c == tc_globmatch) {
-		return globmatch(value, with);
+		return globmatch_n(value, len, with);
 	} else if (c == tc_notglobmatch) {
-		return !globmatch(value, with);
+		return !globmatch_n(value, len, with);
 	} else {
 		int i;
-		i = strcmp(value, with);
+		i = compare_n(value, len, with);
 		if (i < 0)
 			return c == tc_strictless
 				|| c == tc_lessorequal
@@ -57,33 +67,53 @@ static inline bool check_field(enum term_comparison c, const char *value, const
 	}
 }
 
+static inline bool check_field(enum term_comparison c, const char *value, const char *with) {
+	return check_field_n(c, value, strlen(value), with);
+}
+
+#define INLINEVALUES 8
+
 /* this has a target argument instead of using package->target
  * as the package might come from one distribution/architecture/...
  * and the decision being about adding it somewhere else */
 retvalue term_decidepackage(const term *condition, struct package *package, struct target *target) {
 	const struct term_atom *atom = condition;
+	/* all fields are looked up at once when the first is needed,
+	 * and compared where they are in the chunk: */
+	struct chunkvalue inlinevalues[INLINEVALUES], *values = NULL;
 
 	while (atom != NULL) {
-		bool correct; char *value;
+		bool correct;
 		enum term_comparison c = atom->comparison;
-		retvalue r;
 
 		if (atom->isspecial) {
 			correct = atom->special.type->compare(c,
 					&atom->special.comparewith,
 					package, target);
 		} else {
-			r = chunk_getvalue(package->control,
-					atom->generic.key, &value);
-			if (RET_WAS_ERROR(r))
-				return r;
-			if (r == RET_NOTHING) {
+			const struct chunkvalue *v;
+
+			if (values == NULL) {
+				if (condition->fieldcount <= INLINEVALUES)
+					values = inlinevalues;
+				else {
+					values = nNEW(condition->fieldcount,
+							struct chunkvalue);
+					if (FAILEDTOALLOC(values))
+						return RET_ERROR_OOM;
+				}
+				chunk_getvalues(package->control,
+						condition->fieldcount,
+						condition->fields, values);
+			}
+			assert (atom->generic.field < condition->fieldcount);
+			v = &values[atom->generic.field];
+			if (v->value == NULL) {
 				correct = (c == tc_notequal
 						|| c == tc_notglobmatch);
 			} else {
-				correct = check_field(c, value,
+				correct = check_field_n(c, v->value, v->len,
 						atom->generic.comparewith);
-				free(value);
 			}
 		}
 		if (atom->negated)
@@ -94,11 +124,15 @@ retvalue term_decidepackage(const term *condition, struct package *package, stru
 			atom = atom->nextiffalse;
 			if (atom == NULL) {
 				/* do not include */
+				if (values != inlinevalues)
+					free(values);
 				return RET_NOTHING;
 			}
 		}
 
 	}
+	if (values != inlinevalues)
+		free(values);
 	/* do include */
 	return RET_OK;
 }
@@ -300,3 +334,22 @@ retvalue term_compilefortargetdecision(term **term_p, const char *formula) {
 		T_GLOBMATCH|T_OR|T_BRACKETS|T_NEGATION|T_VERSION|T_NOTEQUAL,
 		targetdecisionspecial);
 }
+
+/* if the formula can only be true for packages of one source
+ * (i.e. it is of the form "$Source (== name), ..."), return that */
+const char *term_requiredsource(const term *t) {
+	const term *atom;
+
+	/* every atom in the chain of a pure conjunction has to be true */
+	for (atom = t ; atom != NULL ; atom = atom->nextiftrue) {
+		if (atom->nextiffalse != NULL)
+			return NULL;
+	}
+	for (atom = t ; atom != NULL ; atom = atom->nextiftrue) {
+		if (atom->isspecial && !atom->negated
+				&& atom->comparison == tc_equal
+				&& atom->special.type == &targetdecisionspecial[0])
+			return atom->special.comparewith.pointer;
+	}
+	return NULL;
+}
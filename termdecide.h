@@ -13,6 +13,7 @@
 
 retvalue term_compilefortargetdecision(/*@out@*/term **, const char *);
 retvalue term_decidepackage(const term *, struct package *, struct target *);
+/*@null@*/const char *term_requiredsource(const term *);
 
 
 
@@ -44,6 +44,7 @@ void term_free(term *t) {
 			free(t->generic.comparewith);
 		}
 		strlist_done(&t->architectures);
+		free(t->fields);
 		free(t);
 		t = next;
 	}
@@ -254,6 +255,34 @@ static void andterm(term *termtochange, /*@dependent@*/term *termtoand) {
 	}
 }
 
+/* give every different key an index, so evaluating can get them
+ * all in one go instead of looking for each field separately */
+static retvalue collectfields(struct term_atom *first) {
+	struct term_atom *a;
+	size_t i, count = 0;
+
+	for (a = first ; a != NULL ; a = a->next)
+		if (!a->isspecial)
+			count++;
+	if (count == 0)
+		return RET_OK;
+	first->fields = nzNEW(count, const char *);
+	if (FAILEDTOALLOC(first->fields))
+		return RET_ERROR_OOM;
+	for (a = first ; a != NULL ; a = a->next) {
+		if (a->isspecial)
+			continue;
+		for (i = 0 ; i < first->fieldcount ; i++) {
+			if (strcasecmp(first->fields[i], a->generic.key) == 0)
+				break;
+		}
+		if (i == first->fieldcount)
+			first->fields[first->fieldcount++] = a->generic.key;
+		a->generic.field = i;
+	}
+	return RET_OK;
+}
+
 retvalue term_compile(term **term_p, const char *origformula, int options, const struct term_special *specials) {
 	const char *formula = origformula;
 	/* for the global list */
@@ -381,6 +410,11 @@ retvalue term_compile(term **term_p, const char *origformula, int options, const
 		term_free(first);
 		return RET_ERROR;
 	}
+	r = collectfields(first);
+	if (RET_WAS_ERROR(r)) {
+		term_free(first);
+		return r;
+	}
 	*term_p = first;
 	return RET_OK;
 }
@@ -10,6 +10,10 @@ struct term_special;
 typedef struct term_atom {
 	/* global list to allow freeing them all */
 	struct term_atom *next;
+	/* only in the first atom: the different keys of all generic
+	 * atoms, so that all can be looked up at once */
+	size_t fieldcount;
+	/*@null@*//*@dependent@*/const char **fields;
 	/* the next atom to look at if this is true, resp. false,
 	 * nextiftrue  == NULL means total result is true,
 	 * nextiffalse == NULL means total result is false. */
@@ -26,6 +30,8 @@ typedef struct term_atom {
 			char *key;
 			/* version/value requirement */
 			char *comparewith;
+			/* index of key in the first atom's fields */
+			size_t field;
 		} generic;
 		struct {
 			const struct term_special *type;
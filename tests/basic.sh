@@ -422,4 +422,162 @@ test_ddeb() {
 	assertEquals "hello | 2.9-1 | buster | $ARCH, source" "$($REPREPRO -b $REPO ls hello)"
 }
 
+
+# the record of sl 3.03-1 in tracking.db as printed by db_dump -p
+tracking_record() {
+	db_dump -p $REPO/db/tracking.db | grep '^ 3\.03-1\\00' | sed -e 's/^ //'
+}
+
+replace_tracking_record() {
+	db_dump -p $REPO/db/tracking.db > $REPO/tracking.dump
+	RECORD=" $1" awk 'index($0, " 3.03-1\\00") == 1 { print ENVIRON["RECORD"]; next } { print }' $REPO/tracking.dump > $REPO/tracking.load
+	rm $REPO/db/tracking.db $REPO/tracking.dump
+	call db_load -f $REPO/tracking.load $REPO/db/tracking.db
+	rm $REPO/tracking.load
+}
+
+test_tracking_binary_format() {
+	(cd $PKGS && PACKAGE=sl SECTION=main DISTRI=buster EPOCH="" VERSION=3.03 REVISION=-1 ../genpackage.sh)
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedsc buster $PKGS/sl_3.03-1.dsc
+	# older versions cannot read the binary records
+	assertEquals "5.5.0" "$(sed -n 2p $REPO/db/version)"
+	assertEquals '3.03-1\00\01s\00\00\00\01\00pool/main/s/sl/sl_3.03-1.dsc\00s\00\00\00\01\16.orig.tar.gz\00s\00\00\00\01\16-1.debian.tar.xz\00\00' "$(tracking_record)"
+	assertEquals "\
+Distribution: buster
+Source: sl
+Version: 3.03-1
+Files:
+ pool/main/s/sl/sl_3.03-1.dsc s 1
+ pool/main/s/sl/sl_3.03.orig.tar.gz s 1
+ pool/main/s/sl/sl_3.03-1.debian.tar.xz s 1" "$($REPREPRO -b $REPO dumptracks)"
+}
+
+test_tracking_old_format() {
+	local oldrecord='3.03-1\00spool/main/s/sl/sl_3.03-1.dsc\00spool/main/s/sl/sl_3.03.orig.tar.gz\00spool/main/s/sl/sl_3.03-1.debian.tar.xz\00\001\001\001\00\00'
+	local newrecord='3.03-1\00\01s\00\00\00\01\00pool/main/s/sl/sl_3.03-1.dsc\00s\00\00\00\01\16.orig.tar.gz\00s\00\00\00\01\16-1.debian.tar.xz\00\00'
+	(cd $PKGS && PACKAGE=sl SECTION=main DISTRI=buster EPOCH="" VERSION=3.03 REVISION=-1 ../genpackage.sh)
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedsc buster $PKGS/sl_3.03-1.dsc
+	replace_tracking_record "$oldrecord"
+	assertEquals "$oldrecord" "$(tracking_record)"
+	assertEquals "\
+Distribution: buster
+Source: sl
+Version: 3.03-1
+Files:
+ pool/main/s/sl/sl_3.03-1.dsc s 1
+ pool/main/s/sl/sl_3.03.orig.tar.gz s 1
+ pool/main/s/sl/sl_3.03-1.debian.tar.xz s 1" "$($REPREPRO -b $REPO dumptracks)"
+	call $REPREPRO $VERBOSE_ARGS -b $REPO tidytracks buster
+	assertEquals "$newrecord" "$(tracking_record)"
+	replace_tracking_record "$oldrecord"
+	call $REPREPRO $VERBOSE_ARGS -b $REPO retrack buster
+	assertEquals "$newrecord" "$(tracking_record)"
+	assertEquals "\
+Distribution: buster
+Source: sl
+Version: 3.03-1
+Files:
+ pool/main/s/sl/sl_3.03-1.dsc s 1
+ pool/main/s/sl/sl_3.03.orig.tar.gz s 1
+ pool/main/s/sl/sl_3.03-1.debian.tar.xz s 1" "$($REPREPRO -b $REPO dumptracks)"
+}
+
+test_tracking_in_place() {
+	# the same as written, but without shared prefixes, so it is only
+	# kept that way as long as the record is not generated again:
+	local record='3.03-1\00\01s\00\00\00\01\00pool/main/s/sl/sl_3.03-1.dsc\00s\00\00\00\01\00pool/main/s/sl/sl_3.03.orig.tar.gz\00s\00\00\00\01\00pool/main/s/sl/sl_3.03-1.debian.tar.xz\00\00'
+	(cd $PKGS && PACKAGE=sl SECTION=main DISTRI=buster EPOCH="" VERSION=3.03 REVISION=-1 ../genpackage.sh)
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedsc buster $PKGS/sl_3.03-1.dsc
+	replace_tracking_record "$record"
+	# already tidy, so not touched:
+	call $REPREPRO $VERBOSE_ARGS -b $REPO tidytracks buster
+	assertEquals "$record" "$(tracking_record)"
+	# refcounts are reset and counted again in place:
+	call $REPREPRO $VERBOSE_ARGS -b $REPO retrack buster
+	assertEquals "$record" "$(tracking_record)"
+	assertEquals "\
+Distribution: buster
+Source: sl
+Version: 3.03-1
+Files:
+ pool/main/s/sl/sl_3.03-1.dsc s 1
+ pool/main/s/sl/sl_3.03.orig.tar.gz s 1
+ pool/main/s/sl/sl_3.03-1.debian.tar.xz s 1" "$($REPREPRO -b $REPO dumptracks)"
+}
+
+test_processfilelists() {
+	clear_distro
+	add_distro buster
+	add_distro bullseye "Contents: allcomponents"
+	(cd $PKGS && PACKAGE=hello SECTION=main DISTRI=buster VERSION=2.9 REVISION=-1 ../genpackage.sh)
+	# buster has no Contents files, so the list of files is not read here
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedeb buster $PKGS/hello_2.9-1_${ARCH}.deb
+	call $REPREPRO $VERBOSE_ARGS -b $REPO --export=silent-never copy bullseye buster hello
+	call $REPREPRO $VERBOSE_ARGS -b $REPO processfilelists
+	# exporting must now be possible with only the cached list of files
+	rm $REPO/pool/main/h/hello/hello_2.9-1_${ARCH}.deb
+	call $REPREPRO $VERBOSE_ARGS -b $REPO export bullseye
+	assertEquals "\
+x	    main/hello
+a/1	    main/hello
+dir/another	    main/hello
+dir/file	    main/hello
+dir/subdir/file	    main/hello" "$(gunzip -c $REPO/dists/bullseye/Contents-$ARCH.gz)"
+}
+
+pdiff_patches() {
+	sed -e '1,/^SHA256-Patches:/d' -e '/^[^ ]/,$d' -e 's/^ [^ ]* [^ ]* //' $REPO/dists/buster/main/binary-$ARCH/Packages.diff/Index
+}
+
+pdiff_current() {
+	sed -n -e 's/^SHA256-Current: \([^ ]*\) .*/\1/p' $REPO/dists/buster/main/binary-$ARCH/Packages.diff/Index
+}
+
+# $1: how to read the exported Packages file
+check_pdiff_history() {
+	local diffdir=$REPO/dists/buster/main/binary-$ARCH/Packages.diff
+	local p
+	(cd $PKGS && PACKAGE=hello SECTION=main DISTRI=buster VERSION=1.0 REVISION=-1 ../genpackage.sh)
+	(cd $PKGS && PACKAGE=hello SECTION=main DISTRI=buster VERSION=1.0 REVISION=-2 ../genpackage.sh)
+	(cd $PKGS && PACKAGE=hello SECTION=main DISTRI=buster VERSION=1.0 REVISION=-3 ../genpackage.sh)
+	(cd $PKGS && PACKAGE=sl SECTION=non-free DISTRI=buster VERSION=3.03 REVISION=-1 ../genpackage.sh)
+	# nothing to make patches from yet
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedeb buster $PKGS/hello_1.0-1_${ARCH}.deb
+	assertTrue "Packages.diff was created without an old file" "test ! -e $diffdir"
+	# each change adds a patch (plus the empty one working around apt bugs)
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedeb buster $PKGS/hello_1.0-2_${ARCH}.deb
+	assertEquals "2" "$(pdiff_patches | wc -l)"
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C main includedeb buster $PKGS/hello_1.0-3_${ARCH}.deb
+	assertEquals "3" "$(pdiff_patches | wc -l)"
+	assertEquals "$($1 | sha256sum | cut -d' ' -f1)" "$(pdiff_current)"
+	for p in $(pdiff_patches) ; do
+		assertTrue "patch $p is missing" "test -f $diffdir/$p.gz"
+	done
+	cp $diffdir/Index $REPO/Index.old
+	# regenerating the unchanged file keeps the patches
+	call $REPREPRO $VERBOSE_ARGS -b $REPO export buster
+	assertEquals "$(cat $REPO/Index.old)" "$(cat $diffdir/Index)"
+	# and so does not touching it at all
+	call $REPREPRO $VERBOSE_ARGS -b $REPO -C non-free includedeb buster $PKGS/sl_3.03-1_${ARCH}.deb
+	assertEquals "$(cat $REPO/Index.old)" "$(cat $diffdir/Index)"
+	for p in $(pdiff_patches) ; do
+		assertTrue "patch $p was removed" "test -f $diffdir/$p.gz"
+	done
+}
+
+test_pdiff_export() {
+	clear_distro
+	add_distro buster "DebIndices: Packages Release . .gz .diff"
+	check_pdiff_history "cat $REPO/dists/buster/main/binary-$ARCH/Packages"
+}
+
+test_pdiff_export_compressed_only() {
+	clear_distro
+	add_distro buster "DebIndices: Packages Release .gz .diff"
+	# do not keep the uncompressed file of the first export
+	rm -r $REPO/dists
+	check_pdiff_history "gunzip -c $REPO/dists/buster/main/binary-$ARCH/Packages.gz"
+	assertTrue "uncompressed Packages file was exported" "test ! -e $REPO/dists/buster/main/binary-$ARCH/Packages"
+}
+
 . shunit2
@@ -18,6 +18,7 @@
 
 #include <assert.h>
 #include <sys/types.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -39,6 +40,29 @@
 #define PARANOIA
 #endif
 
+/* The data of every tracked source version is stored after the version
+ * (and its terminating '\0') in one of two formats:
+ *
+ * The old text format has for every file the filetype character and the
+ * filekey with a terminating '\0', another '\0' and then for every file
+ * the refcount as octal number with a terminating '\0'.
+ *
+ * The binary format starts with TRACKINGFORMAT_BINARY. Then there is for
+ * every file the filetype character, the refcount as four byte big endian
+ * number, the number of leading characters shared with the filekey of the
+ * file before as one byte and the rest of the filekey with a terminating
+ * '\0'. As the refcounts have a fixed size, they can be changed (or just
+ * looked at) without parsing the whole record.
+ *
+ * Records in the old format are still read, but everything written uses
+ * the binary format (so tidytracks or retrack convert everything). */
+#define TRACKINGFORMAT_BINARY '\001'
+/* the first version able to read the binary format (this must be newer
+ * than any version released before, as those refuse a database only if
+ * it needs a newer version than themselves) */
+#define TRACKINGFORMAT_BINARY_VERSION "5.5.0"
+#define MAXSHAREDPREFIX 255
+
 struct s_tracking {
 	char *codename;
 	struct table *table;
@@ -275,6 +299,147 @@ static retvalue tracking_new(const char *sourcename, const char *version, /*@out
 	return RET_OK;
 }
 
+static inline bool isbinaryrecord(const char *data, size_t datalen) {
+	return datalen > 0 && data[0] == TRACKINGFORMAT_BINARY;
+}
+
+static inline int getrefcount(const char *p) {
+	const unsigned char *u = (const unsigned char *)p;
+
+	return (int)(((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) |
+			((uint32_t)u[2] << 8) | (uint32_t)u[3]);
+}
+
+static inline void setrefcount(char *p, int count) {
+	uint32_t c = (count < 0)?0:count;
+
+	p[0] = (c >> 24) & 0xFF;
+	p[1] = (c >> 16) & 0xFF;
+	p[2] = (c >> 8) & 0xFF;
+	p[3] = c & 0xFF;
+}
+
+/* walk the files of a record in the binary format */
+struct recordwalk {
+	const char *name, *version;
+	const char *data;
+	size_t len, ofs;
+	/* the current file: */
+	enum filetype filetype;
+	/* where its refcount is relative to data */
+	size_t refcountofs;
+	char *filekey;
+	size_t filekeylen, filekeysize;
+};
+
+static void recordwalk_init(/*@out@*/struct recordwalk *w, const char *name, const char *version, const char *data, size_t datalen) {
+	assert (isbinaryrecord(data, datalen));
+	w->name = name;
+	w->version = version;
+	w->data = data;
+	w->len = datalen;
+	w->ofs = 1;
+	w->filekey = NULL;
+	w->filekeylen = 0;
+	w->filekeysize = 0;
+}
+
+static void recordwalk_done(struct recordwalk *w) {
+	free(w->filekey);
+	w->filekey = NULL;
+}
+
+static retvalue recordwalk_corrupt(const struct recordwalk *w) {
+	fprintf(stderr,
+"Internal Error: Corrupt tracking data for %s %s\n",
+			w->name, w->version);
+	return RET_ERROR;
+}
+
+/* RET_OK if there is a next file, RET_NOTHING at the end */
+static retvalue recordwalk_next(struct recordwalk *w) {
+	const char *p, *end;
+	size_t shared, restlen;
+
+	if (w->ofs >= w->len)
+		return RET_NOTHING;
+	if (w->len - w->ofs < 7)
+		return recordwalk_corrupt(w);
+	p = w->data + w->ofs;
+	shared = (unsigned char)p[5];
+	if (shared > w->filekeylen)
+		return recordwalk_corrupt(w);
+	end = memchr(p + 6, '\0', w->len - w->ofs - 6);
+	if (end == NULL)
+		return recordwalk_corrupt(w);
+	restlen = end - (p + 6);
+	if (shared + restlen + 1 > w->filekeysize) {
+		size_t newsize = shared + restlen + 64;
+		char *n = realloc(w->filekey, newsize);
+
+		if (FAILEDTOALLOC(n))
+			return RET_ERROR_OOM;
+		w->filekey = n;
+		w->filekeysize = newsize;
+	}
+	memcpy(w->filekey + shared, p + 6, restlen + 1);
+	w->filekeylen = shared + restlen;
+	w->filetype = p[0];
+	w->refcountofs = w->ofs + 1;
+	w->ofs += 6 + restlen + 1;
+	return RET_OK;
+}
+
+static inline retvalue parse_binarydata(struct trackedpackage *p, const char *data, size_t datalen) {
+	struct recordwalk w;
+	retvalue r;
+
+	recordwalk_init(&w, p->sourcename, p->sourceversion, data, datalen);
+	while (RET_IS_OK(r = recordwalk_next(&w))) {
+		char *filekey;
+
+		if (((p->filekeys.count)&31) == 0) {
+			enum filetype *n = realloc(p->filetypes,
+				(p->filekeys.count+32)*sizeof(enum filetype));
+			int *nr;
+
+			if (FAILEDTOALLOC(n)) {
+				r = RET_ERROR_OOM;
+				break;
+			}
+			p->filetypes = n;
+			nr = realloc(p->refcounts,
+				(p->filekeys.count+32)*sizeof(int));
+			if (FAILEDTOALLOC(nr)) {
+				r = RET_ERROR_OOM;
+				break;
+			}
+			p->refcounts = nr;
+		}
+		p->filetypes[p->filekeys.count] = w.filetype;
+		p->refcounts[p->filekeys.count] =
+			getrefcount(data + w.refcountofs);
+		filekey = strndup(w.filekey, w.filekeylen);
+		if (FAILEDTOALLOC(filekey)) {
+			r = RET_ERROR_OOM;
+			break;
+		}
+		r = strlist_add(&p->filekeys, filekey);
+		if (RET_WAS_ERROR(r))
+			break;
+	}
+	recordwalk_done(&w);
+	if (RET_WAS_ERROR(r))
+		return r;
+	if (p->refcounts == NULL) {
+		/* no files at all */
+		p->refcounts = nzNEW(1, int);
+		if (FAILEDTOALLOC(p->refcounts))
+			return RET_ERROR_OOM;
+	}
+	return RET_OK;
+}
+
 static inline retvalue parse_data(const char *name, const char *version, const char *data, size_t datalen, /*@out@*/struct trackedpackage **pkg) {
 	struct trackedpackage *p;
 	int i;
@@ -290,6 +455,19 @@ static inline retvalue parse_data(const char *name, const char *version, const c
 		trackedpackage_free(p);
 		return RET_ERROR_OOM;
 	}
+	if (isbinaryrecord(data, datalen)) {
+		retvalue r;
+
+		r = parse_binarydata(p, data, datalen);
+		if (RET_WAS_ERROR(r)) {
+			trackedpackage_free(p);
+			return r;
+		}
+		p->flags.isnew = false;
+		p->flags.deleted = false;
+		*pkg = p;
+		return RET_OK;
+	}
 	while (datalen > 0 && *data != '\0') {
 		char *filekey;
 		const char *separator;
@@ -378,57 +556,63 @@ retvalue tracking_getornew(trackingdb tracks, const char *name, const char *vers
 	return r;
 }
 
+static inline size_t sharedprefix(const char *a, const char *b) {
+	size_t l = 0;
+
+	while (l < MAXSHAREDPREFIX && a[l] != '\0' && a[l] == b[l])
+		l++;
+	return l;
+}
+
 static retvalue gen_data(struct trackedpackage *pkg, /*@out@*/char **newdata_p, /*@out@*/size_t *newdatalen_p) {
+	static bool versionrequired = false;
 	size_t versionsize = strlen(pkg->sourceversion)+1;
 	int i;
 	char *d, *data;
 	size_t datalen;
+	const char *previous;
 
 	datalen = versionsize + 1;
+	previous = "";
 	for (i = 0 ; i < pkg->filekeys.count ; i++) {
+		const char *filekey = pkg->filekeys.values[i];
 		size_t l;
-		l = strlen(pkg->filekeys.values[i]);
-		if (l > 0)
-			datalen += l+9;
+
+		l = strlen(filekey);
+		if (l == 0)
+			continue;
+		datalen += 6 + (l - sharedprefix(previous, filekey)) + 1;
+		previous = filekey;
 	}
 	data = malloc(datalen + 1);
 	if (FAILEDTOALLOC(data))
 		return RET_ERROR_OOM;
 	memcpy(data, pkg->sourceversion, versionsize);
 	d = data + versionsize;
+	*(d++) = TRACKINGFORMAT_BINARY;
+	previous = "";
 	for (i = 0 ; i < pkg->filekeys.count ; i++) {
-		size_t l;
-		l = strlen(pkg->filekeys.values[i]);
-		if (l > 0) {
-			*d = pkg->filetypes[i];
-			d++;
-			memcpy(d, pkg->filekeys.values[i], l + 1);
-			d+=l+1;
-		}
-	}
-	*d ='\0'; d++;
-	for (i = 0 ; i < pkg->filekeys.count ; i++) {
-		int j;
-#define MAXREFCOUNTOCTETS 7
-		char countstring[MAXREFCOUNTOCTETS];
-		size_t count = pkg->refcounts[i];
-
-		countstring[MAXREFCOUNTOCTETS-1] = '\0';
-		for (j = MAXREFCOUNTOCTETS-2 ; j >= 0 ; j--) {
-			countstring[j] = '0' + (count & 7);
-			count >>= 3;
-			if (count == 0)
-				break;
-		}
-#undef MAXREFCOUNTOCTETS
-		assert (count == 0);
+		const char *filekey = pkg->filekeys.values[i];
+		size_t l, shared;
 
-		memcpy(d, countstring+j, 7 - j);
-		d+=7-j;
-		datalen -= j;
+		l = strlen(filekey);
+		if (l == 0)
+			continue;
+		shared = sharedprefix(previous, filekey);
+		*(d++) = pkg->filetypes[i];
+		setrefcount(d, pkg->refcounts[i]);
+		d += 4;
+		*(d++) = (unsigned char)shared;
+		memcpy(d, filekey + shared, l - shared + 1);
+		d += l - shared + 1;
+		previous = filekey;
 	}
 	*d ='\0';
 	assert ((size_t)(d-data) == datalen);
+	if (!versionrequired) {
+		database_requireversion(TRACKINGFORMAT_BINARY_VERSION);
+		versionrequired = true;
+	}
 	*newdata_p = data;
 	*newdatalen_p = datalen;
 	return RET_OK;
@@ -507,6 +691,88 @@ retvalue tracking_save(trackingdb t, struct trackedpackage *pkg) {
 	return r;
 }
 
+/* Increment the refcounts of already known files by changing the stored
+ * record in place, without parsing it and generating it anew.
+ * Returns RET_NOTHING (and changes nothing) if not all files are
+ * listed with this type or the record is in the old format. */
+static retvalue usefilekeys(trackingdb t, const char *sourcename, const char *version, enum filetype filetype, int count, const char * const *filekeys) {
+	struct cursor *cursor;
+	struct recordwalk w;
+	const char *data;
+	size_t datalen, versionlen, found;
+	char *newdata;
+	bool *done;
+	retvalue r, r2;
+	int i;
+
+	if (count == 0)
+		return RET_NOTHING;
+	r = table_newpairedcursor(t->table, sourcename, version, &cursor,
+			&data, &datalen);
+	if (!RET_IS_OK(r))
+		return r;
+	if (!isbinaryrecord(data, datalen)) {
+		r = cursor_close(t->table, cursor);
+		if (RET_WAS_ERROR(r))
+			return r;
+		return RET_NOTHING;
+	}
+	versionlen = strlen(version) + 1;
+	newdata = malloc(versionlen + datalen + 1);
+	done = nzNEW(count, bool);
+	if (FAILEDTOALLOC(newdata) || FAILEDTOALLOC(done)) {
+		free(newdata);
+		free(done);
+		(void)cursor_close(t->table, cursor);
+		return RET_ERROR_OOM;
+	}
+	memcpy(newdata, version, versionlen);
+	memcpy(newdata + versionlen, data, datalen + 1);
+
+	found = 0;
+	recordwalk_init(&w, sourcename, version, data, datalen);
+	while (found < (size_t)count &&
+			RET_IS_OK(r = recordwalk_next(&w))) {
+		char *refcount;
+
+		for (i = 0 ; i < count ; i++) {
+			if (!done[i] && strcmp(filekeys[i], w.filekey) == 0)
+				break;
+		}
+		if (i >= count)
+			continue;
+		if (w.filetype != filetype)
+			/* needs trackedpackage_addfilekey to repair it */
+			break;
+		refcount = newdata + versionlen + w.refcountofs;
+		setrefcount(refcount, getrefcount(refcount) + 1);
+		done[i] = true;
+		found++;
+	}
+	recordwalk_done(&w);
+	free(done);
+	if (!RET_WAS_ERROR(r)) {
+		if (found == (size_t)count)
+			r = cursor_replace(t->table, cursor,
+					newdata, versionlen + datalen);
+		else
+			r = RET_NOTHING;
+	}
+	free(newdata);
+	r2 = cursor_close(t->table, cursor);
+	RET_ENDUPDATE(r, r2);
+	return r;
+}
+
+retvalue tracking_usefilekey(trackingdb t, const char *sourcename, const char *version, enum filetype filetype, const char *filekey) {
+	return usefilekeys(t, sourcename, version, filetype, 1, &filekey);
+}
+
+retvalue tracking_usefilekeys(trackingdb t, const char *sourcename, const char *version, enum filetype filetype, const struct strlist *filekeys) {
+	return usefilekeys(t, sourcename, version, filetype, filekeys->count,
+			(const char * const *)filekeys->values);
+}
+
 retvalue tracking_listdistributions(struct strlist *distributions) {
 	return database_listsubtables("tracking.db", distributions);
 }
@@ -538,18 +804,35 @@ static retvalue tracking_recreatereferences(trackingdb t) {
 
 	while (cursor_nextpair(t->table, cursor,
 				&key, &value, &data, &datalen)) {
+		id = calc_trackreferee(t->codename, key, value);
+		if (FAILEDTOALLOC(id)) {
+			(void)cursor_close(t->table, cursor);
+			return RET_ERROR_OOM;
+		}
+		if (isbinaryrecord(data, datalen)) {
+			struct recordwalk w;
+
+			/* no need to parse everything to get the filekeys */
+			recordwalk_init(&w, key, value, data, datalen);
+			while (RET_IS_OK(r = recordwalk_next(&w))) {
+				r = references_increment(w.filekey, id);
+				RET_UPDATE(result, r);
+			}
+			recordwalk_done(&w);
+			if (RET_WAS_ERROR(r)) {
+				free(id);
+				(void)cursor_close(t->table, cursor);
+				return r;
+			}
+			free(id);
+			continue;
+		}
 		r = parse_data(key, value, data, datalen, &pkg);
 		if (RET_WAS_ERROR(r)) {
+			free(id);
 			(void)cursor_close(t->table, cursor);
 			return r;
 		}
-		id = calc_trackreferee(t->codename, pkg->sourcename,
-				                    pkg->sourceversion);
-		if (FAILEDTOALLOC(id)) {
-			trackedpackage_free(pkg);
-			(void)cursor_close(t->table, cursor);
-			return RET_ERROR_OOM;
-		}
 		for (i = 0 ; i < pkg->filekeys.count ; i++) {
 			const char *filekey = pkg->filekeys.values[i];
 			r = references_increment(filekey, id);
@@ -963,25 +1246,30 @@ static inline retvalue trackedpackage_removeall(trackingdb tracks, struct tracke
 	return result;
 }
 
-static inline bool tracking_needed(trackingdb tracks, struct trackedpackage *pkg, int ofs) {
-	if (pkg->refcounts[ofs] > 0)
+static inline bool trackedfile_needed(trackingdb tracks, enum filetype filetype, int refcount) {
+	if (refcount > 0)
 		return true;
 	// TODO: add checks so that only .changes, .buildinfo and .log files
 	// belonging to still existing binaries are kept in minimal mode
-	if (pkg->filetypes[ofs] == ft_LOG && tracks->options.includelogs)
+	if (filetype == ft_LOG && tracks->options.includelogs)
 		return true;
-	if (pkg->filetypes[ofs] == ft_BUILDINFO && tracks->options.includebuildinfos)
+	if (filetype == ft_BUILDINFO && tracks->options.includebuildinfos)
 		return true;
-	if (pkg->filetypes[ofs] == ft_CHANGES && tracks->options.includechanges)
+	if (filetype == ft_CHANGES && tracks->options.includechanges)
 		return true;
-	if (pkg->filetypes[ofs] == ft_XTRA_DATA)
+	if (filetype == ft_XTRA_DATA)
 		return true;
-	if (pkg->filetypes[ofs] == ft_SOURCE && tracks->options.keepsources)
+	if (filetype == ft_SOURCE && tracks->options.keepsources)
 		return true;
 	return false;
 
 }
 
+static inline bool tracking_needed(trackingdb tracks, struct trackedpackage *pkg, int ofs) {
+	return trackedfile_needed(tracks, pkg->filetypes[ofs],
+			pkg->refcounts[ofs]);
+}
+
 static inline retvalue trackedpackage_removeunneeded(trackingdb tracks, struct trackedpackage *pkg) {
 	retvalue result = RET_OK, r;
 	char *id = NULL;
@@ -1073,6 +1361,37 @@ retvalue trackingdata_finish(trackingdb tracks, struct trackingdata *d) {
 
 }
 
+/* look if trackedpackage_tidy would change anything by only looking
+ * at the filetypes and refcounts (old records are always changed,
+ * as that writes them in the new format) */
+static bool record_istidy(trackingdb t, const char *name, const char *version, const char *data, size_t datalen) {
+	struct recordwalk w;
+	bool anyused = false, allneeded = true;
+	retvalue r;
+
+	if (!isbinaryrecord(data, datalen))
+		return false;
+	if (t->type == dt_KEEP)
+		return true;
+	recordwalk_init(&w, name, version, data, datalen);
+	while (RET_IS_OK(r = recordwalk_next(&w))) {
+		int refcount = getrefcount(data + w.refcountofs);
+
+		if (refcount > 0)
+			anyused = true;
+		if (!trackedfile_needed(t, w.filetype, refcount))
+			allneeded = false;
+	}
+	recordwalk_done(&w);
+	if (RET_WAS_ERROR(r))
+		/* let parse_data complain */
+		return false;
+	if (!anyused)
+		/* would be removed */
+		return false;
+	return t->type != dt_MINIMAL || allneeded;
+}
+
 retvalue tracking_tidyall(trackingdb t) {
 	struct cursor *cursor;
 	retvalue result, r;
@@ -1088,6 +1407,9 @@ retvalue tracking_tidyall(trackingdb t) {
 
 	while (cursor_nextpair(t->table, cursor,
 				&key, &value, &data, &datalen)) {
+		if (record_istidy(t, key, value, data, datalen))
+			/* nothing to do, so do not parse and rewrite it */
+			continue;
 		r = parse_data(key, value, data, datalen, &pkg);
 		if (RET_WAS_ERROR(r)) {
 			result = r;
@@ -1104,6 +1426,39 @@ retvalue tracking_tidyall(trackingdb t) {
 	return result;
 }
 
+/* set all refcounts of a record in the binary format to zero,
+ * without parsing it */
+static retvalue reset_binaryrecord(trackingdb t, struct cursor *cursor, const char *name, const char *version, const char *data, size_t datalen) {
+	struct recordwalk w;
+	size_t versionlen = data - version;
+	char *newdata = NULL;
+	retvalue r;
+
+	/* the version and the data are stored together */
+	assert (version + strlen(version) + 1 == data);
+
+	recordwalk_init(&w, name, version, data, datalen);
+	while (RET_IS_OK(r = recordwalk_next(&w))) {
+		if (getrefcount(data + w.refcountofs) == 0)
+			continue;
+		if (newdata == NULL) {
+			newdata = malloc(versionlen + datalen + 1);
+			if (FAILEDTOALLOC(newdata)) {
+				r = RET_ERROR_OOM;
+				break;
+			}
+			memcpy(newdata, version, versionlen + datalen + 1);
+		}
+		setrefcount(newdata + versionlen + w.refcountofs, 0);
+	}
+	recordwalk_done(&w);
+	if (!RET_WAS_ERROR(r) && newdata != NULL)
+		r = cursor_replace(t->table, cursor,
+				newdata, versionlen + datalen);
+	free(newdata);
+	return r;
+}
+
 retvalue tracking_reset(trackingdb t) {
 	struct cursor *cursor;
 	retvalue result, r;
@@ -1121,8 +1476,13 @@ retvalue tracking_reset(trackingdb t) {
 
 	while (cursor_nextpair(t->table, cursor,
 				&key, &value, &data, &datalen)) {
-		// this would perhaps be more stable if it just replaced
-		// everything within the string just received...
+		if (isbinaryrecord(data, datalen)) {
+			result = reset_binaryrecord(t, cursor, key,
+					value, data, datalen);
+			if (RET_WAS_ERROR(result))
+				break;
+			continue;
+		}
 		result = parse_data(key, value, data, datalen, &pkg);
 		if (RET_WAS_ERROR(result))
 			break;
@@ -33,6 +33,10 @@ void trackedpackage_free(struct trackedpackage *);
 retvalue tracking_get(trackingdb, const char * /*sourcename*/, const char * /*version*/, /*@out@*/struct trackedpackage **);
 retvalue tracking_getornew(trackingdb, const char * /*name*/, const char * /*version*/, /*@out@*/struct trackedpackage **);
 retvalue tracking_save(trackingdb, /*@only@*/struct trackedpackage *);
+/* mark already known files as used once more, RET_NOTHING if this
+ * needs tracking_getornew and trackedpackage_addfilekey */
+retvalue tracking_usefilekey(trackingdb, const char * /*sourcename*/, const char * /*version*/, enum filetype, const char * /*filekey*/);
+retvalue tracking_usefilekeys(trackingdb, const char * /*sourcename*/, const char * /*version*/, enum filetype, const struct strlist * /*filekeys*/);
 retvalue tracking_remove(trackingdb, const char * /*sourcename*/, const char * /*version*/);
 retvalue tracking_printall(trackingdb);
 
@@ -347,6 +347,17 @@ static void search_binary(/*@null@*/const char *setting, const char *default_pro
 	*program_p = program;
 }
 
+/* how many threads the builtin xz decompression may use, shared by
+ * all files decompressed at the same time (which they are when called
+ * from parallel jobs), so that not each of them starts that many: */
+static unsigned int xzthreads = 1;
+static unsigned int xzthreads_unused = 1;
+
+void uncompression_setthreads(unsigned int count) {
+	xzthreads = count;
+	xzthreads_unused = count;
+}
+
 /* check for existence of external programs */
 void uncompressions_check(const char *gunzip, const char *bunzip2, const char *unlzma, const char *unxz, const char *lunzip, const char *unzstd) {
 	search_binary(gunzip,  "gunzip",  &extern_uncompressors[c_gzip]);
@@ -531,6 +542,9 @@ struct compressedfile {
 	pid_t pid;
 	int fd, infd, pipeinfd;
 	off_t len;
+	/* only with uncompress_fdopen: */
+	uncompress_observer *observer;
+	void *observerdata;
 	union {
 		/* used with an external decompressor if the input fd cannot
 		 * be used as that programs stdin directly: */
@@ -560,10 +574,17 @@ struct compressedfile {
 			} error;
 			/* compression stream ended */
 			bool hadeos;
+			/* threads taken from xzthreads_unused */
+			unsigned int xzthreads;
 		} uncompress;
 	};
 };
 
+static inline void observe(struct compressedfile *f, const void *data, ssize_t len) {
+	if (f->observer != NULL && len > 0)
+		f->observer(f->observerdata, data, len);
+}
+
 /* This function is called to refill the internal buffer in uncompress.buffer
  * with data initially or one everything of the previous run was consumed.
  * It will set uncompress.available to a value >0, unless there is a EOF
@@ -607,6 +628,7 @@ static retvalue uncompression_read_internal_buffer(struct compressedfile *f) {
 		return RET_ERRNO(errno);
 	}
 	assert ((size_t)r <= len);
+	observe(f, f->uncompress.buffer, r);
 	if (f->len >= 0) {
 		assert (r <= f->len);
 		f->len -= r;
@@ -686,6 +708,7 @@ static inline retvalue start_lzma(struct compressedfile *f, int *errno_p, const
 	f->uncompress.lzma.next_in = f->uncompress.buffer;
 	f->uncompress.lzma.avail_in = f->uncompress.available;
 
+	f->uncompress.xzthreads = 0;
 	ret = lzma_alone_decoder(&f->uncompress.lzma, UINT64_MAX);
 	if (ret != LZMA_OK) {
 		if (ret == LZMA_MEM_ERROR) {
@@ -700,6 +723,28 @@ static inline retvalue start_lzma(struct compressedfile *f, int *errno_p, const
 	return RET_OK;
 }
 
+#if LZMA_VERSION >= 50040002
+/* take all unused threads if there are at least two, otherwise none */
+static unsigned int xzthreads_take(void) {
+	unsigned int unused;
+
+	unused = __atomic_load_n(&xzthreads_unused, __ATOMIC_RELAXED);
+	do {
+		if (unused <= 1)
+			return 0;
+	} while (!__atomic_compare_exchange_n(&xzthreads_unused, &unused, 0,
+			false, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+	return unused;
+}
+#endif
+
+static void xzthreads_return(struct compressedfile *f) {
+	if (f->uncompress.xzthreads > 0)
+		(void)__atomic_fetch_add(&xzthreads_unused,
+				f->uncompress.xzthreads, __ATOMIC_RELAXED);
+	f->uncompress.xzthreads = 0;
+}
+
 static inline retvalue start_xz(struct compressedfile *f, int *errno_p, const char **msg_p) {
 	int ret;
 	/* as the API requests: */
@@ -712,8 +757,29 @@ static inline retvalue start_xz(struct compressedfile *f, int *errno_p, const ch
 	f->uncompress.lzma.next_in = f->uncompress.buffer;
 	f->uncompress.lzma.avail_in = f->uncompress.available;
 
-	ret = lzma_stream_decoder(&f->uncompress.lzma, UINT64_MAX, LZMA_CONCATENATED);
+#if LZMA_VERSION >= 50040002
+	/* files compressed with multiple blocks (xz -T) can be
+	 * decompressed with multiple threads (the memory for that
+	 * is split like the threads) */
+	f->uncompress.xzthreads = xzthreads_take();
+	if (f->uncompress.xzthreads > 1) {
+		lzma_mt mt;
+
+		memset(&mt, 0, sizeof(mt));
+		mt.flags = LZMA_CONCATENATED;
+		mt.threads = f->uncompress.xzthreads;
+		mt.memlimit_threading = lzma_physmem() / 4 / xzthreads
+			* f->uncompress.xzthreads;
+		mt.memlimit_stop = UINT64_MAX;
+		ret = lzma_stream_decoder_mt(&f->uncompress.lzma, &mt);
+	} else
+#else
+	f->uncompress.xzthreads = 0;
+#endif
+		ret = lzma_stream_decoder(&f->uncompress.lzma, UINT64_MAX,
+				LZMA_CONCATENATED);
 	if (ret != LZMA_OK) {
+		xzthreads_return(f);
 		if (ret == LZMA_MEM_ERROR) {
 			*errno_p = ENOMEM;
 			*msg_p = "Out of Memory";
@@ -846,7 +912,7 @@ retvalue uncompress_open(/*@out@*/struct compressedfile **file_p, const char *fi
 
 static int intermediate_size = 0;
 
-retvalue uncompress_fdopen(struct compressedfile **file_p, int fd, off_t len, enum compression compression, int *errno_p, const char **msg_p) {
+retvalue uncompress_fdopen(struct compressedfile **file_p, int fd, off_t len, enum compression compression, uncompress_observer *observer, void *observerdata, int *errno_p, const char **msg_p) {
 	struct compressedfile *f;
 	retvalue r;
 
@@ -864,6 +930,8 @@ retvalue uncompress_fdopen(struct compressedfile **file_p, int fd, off_t len, en
 	f->len = len;
 	f->external = false;
 	f->closefd = false;
+	f->observer = observer;
+	f->observerdata = observerdata;
 
 	if (compression == c_none) {
 		f->fd = fd;
@@ -984,6 +1052,7 @@ static inline int pipebackforth(struct compressedfile *file, void *buffer, int s
 					file->error = errno;
 					return -1;
 				}
+				observe(file, im->buffer + im->ofs, im->ready);
 				if (im->ready == 0) {
 					(void)close(file->pipeinfd);
 					file->pipeinfd = -1;
@@ -1403,6 +1472,8 @@ int uncompress_read(struct compressedfile *file, void *buffer, int size) {
 			s = read(file->fd, buffer, size);
 			if (s < 0)
 				file->error = errno;
+			else
+				observe(file, buffer, s);
 			file->len -= s;
 			return s;
 		case c_gzip:
@@ -1422,6 +1493,22 @@ int uncompress_read(struct compressedfile *file, void *buffer, int size) {
 	}
 }
 
+off_t uncompress_skip(struct compressedfile *file, off_t size) {
+	if (file->external || file->compression != c_none ||
+			file->observer != NULL || file->error != 0)
+		return 0;
+	if (file->len >= 0 && size > file->len)
+		size = file->len;
+	if (size <= 0)
+		return 0;
+	/* if this is not possible, the caller has to read instead */
+	if (lseek(file->fd, size, SEEK_CUR) == (off_t)-1)
+		return 0;
+	if (file->len >= 0)
+		file->len -= size;
+	return size;
+}
+
 static retvalue uncompress_commonclose(struct compressedfile *file, int *errno_p, const char **msg_p) {
 	retvalue result;
 	int ret;
@@ -1545,6 +1632,7 @@ static retvalue uncompress_commonclose(struct compressedfile *file, int *errno_p
 		case c_lzma:
 		case c_xz:
 			lzma_end(&file->uncompress.lzma);
+			xzthreads_return(file);
 			if (RET_WAS_ERROR(result))
 				return result;
 			return RET_OK;
@@ -1685,6 +1773,7 @@ void uncompress_abort(struct compressedfile *file) {
 			case c_xz:
 			case c_lzma:
 				lzma_end(&file->uncompress.lzma);
+				xzthreads_return(file);
 				memset(&file->uncompress.lzma, 0,
 						sizeof(file->uncompress.lzma));
 				break;
@@ -53,17 +53,26 @@ struct compressedfile;
 
 retvalue uncompress_open(/*@out@*/struct compressedfile **, const char *, enum compression);
 int uncompress_read(struct compressedfile *, void *buffer, int);
+/* skip over data without reading it, if that is possible (uncompressed
+ * and nothing observing it), returns how much was skipped */
+off_t uncompress_skip(struct compressedfile *, off_t);
 retvalue uncompress_error(/*@const@*/struct compressedfile *);
 void uncompress_abort(/*@only@*/struct compressedfile *);
 retvalue uncompress_close(/*@only@*/struct compressedfile *);
 retvalue uncompress_fdclose(/*@only@*/struct compressedfile *, int *, const char **);
 
-retvalue uncompress_fdopen(/*@out@*/struct compressedfile **, int, off_t, enum compression, int *, const char **);
+/* called with everything read from the file descriptor given to
+ * uncompress_fdopen (i.e. the still compressed data) */
+typedef void uncompress_observer(void *, const void *, size_t);
+
+retvalue uncompress_fdopen(/*@out@*/struct compressedfile **, int, off_t, enum compression, /*@null@*/uncompress_observer *, /*@null@*/void *, int *, const char **);
 
 /**** general initialisation ****/
 
 /* check for existence of external programs */
 void uncompressions_check(const char *gunzip, const char *bunzip2, const char *unlzma, const  char *unxz, const char *lunzip, const char *unzstd);
+/* how many threads the builtin xz decompression may use */
+void uncompression_setthreads(unsigned int);
 
 #endif
 
@@ -39,6 +39,7 @@
  * Step  7: queue downloading of lists (Packages.gz, Sources.gz, ...)
  * Step  8: call possible list hooks allowing them to modify the lists
  * Step  9: search for missing packages i.e. needing to be added or upgraded
+ *          (with --jobs for multiple targets in parallel)
  * Step 10: enqueue downloading of missing packages
  * Step 11: install the missing packages
  * Step 12: remember processed index files as processed
@@ -83,6 +84,7 @@
 #include "remoterepository.h"
 #include "uncompression.h"
 #include "package.h"
+#include "jobs.h"
 
 /* The data structures of this one: ("u_" is short for "update_")
 
@@ -867,7 +869,7 @@ static retvalue instance_pattern(struct update_pattern *pattern, const struct di
 				listscomponents->name, pattern->name,
 				distribution->codename, p->name);
 	}
-	if (p != NULL && !atomlist_in(&distribution->components, p->flat)) {
+	if (p != NULL && !atomset_in(&distribution->componentset, p->flat)) {
 		fprintf(stderr,
 "Error: distribution '%s' uses flat update pattern '%s'\n"
 "with target component '%s' which it does not contain!\n",
@@ -1036,7 +1038,7 @@ static retvalue addorigintotarget(struct update_origin *origin, struct target *t
 	}
 
 	if (a_into == NULL) {
-		assert (atomlist_in(&distribution->architectures,
+		assert (atomset_in(&distribution->architectureset,
 					target->architecture));
 
 		if (c_into == NULL) {
@@ -1782,10 +1784,8 @@ static upgrade_decision ud_decide_by_pattern(void *privdata, struct target *targ
 }
 
 
-static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_target *u) {
-	struct update_index_connector *uindex;
-	retvalue result, r;
-
+/* the part of searchformissing that needs the database */
+static retvalue searchformissing_prepare(/*@null@*/FILE *out, struct update_target *u) {
 	if (u->nothingnew) {
 		if (u->indices == NULL && verbose >= 4 && out != NULL)
 			fprintf(out,
@@ -1800,9 +1800,17 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 	if (verbose > 2 && out != NULL)
 		fprintf(out, "  processing updates for '%s'\n",
 				u->target->identifier);
-	r = upgradelist_initialize(&u->upgradelist, u->target);
-	if (RET_WAS_ERROR(r))
-		return r;
+	return upgradelist_initialize(&u->upgradelist, u->target);
+}
+
+/* the part of searchformissing only looking at the (already downloaded)
+ * index files and the upgradelist of this target, so it can be run in
+ * parallel for different targets */
+static retvalue searchformissing_read(/*@null@*/FILE *out, struct update_target *u) {
+	struct update_index_connector *uindex;
+	retvalue result, r;
+
+	assert (u->upgradelist != NULL);
 
 	result = RET_NOTHING;
 
@@ -1856,10 +1864,77 @@ static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_targe
 	return result;
 }
 
+static inline retvalue searchformissing(/*@null@*/FILE *out, struct update_target *u) {
+	retvalue r;
+
+	r = searchformissing_prepare(out, u);
+	if (!RET_IS_OK(r))
+		return r;
+	return searchformissing_read(out, u);
+}
+
+struct readindices_jobs {
+	/*@null@*/FILE *out;
+	struct update_target **targets;
+};
+
+static retvalue readindices_job(void *privdata, size_t i) {
+	struct readindices_jobs *jobs = privdata;
+	struct update_target *u = jobs->targets[i];
+	retvalue r;
+
+	r = searchformissing_read(jobs->out, u);
+	if (RET_WAS_ERROR(r))
+		u->incomplete = true;
+	return r;
+}
+
+/* Read all upgradelists from the database first, then let the
+ * threads parse the index files and decide what to upgrade.
+ * (Installing is done later with everything back in one thread). */
+static retvalue updates_readindices_parallel(/*@null@*/FILE *out, struct update_distribution *d) {
+	struct readindices_jobs jobs;
+	retvalue result, r;
+	struct update_target *u;
+	size_t count;
+
+	count = 0;
+	for (u=d->targets ; u != NULL ; u=u->next)
+		count++;
+	jobs.out = out;
+	jobs.targets = nNEW(count, struct update_target *);
+	if (FAILEDTOALLOC(jobs.targets))
+		return RET_ERROR_OOM;
+
+	result = RET_NOTHING;
+	count = 0;
+	for (u=d->targets ; u != NULL ; u=u->next) {
+		r = searchformissing_prepare(out, u);
+		if (RET_WAS_ERROR(r))
+			u->incomplete = true;
+		RET_UPDATE(result, r);
+		if (RET_WAS_ERROR(r))
+			break;
+		if (RET_IS_OK(r))
+			jobs.targets[count++] = u;
+	}
+	if (!RET_WAS_ERROR(result)) {
+		/* RET_OK only means the upgradelists could be read */
+		result = RET_NOTHING;
+		r = jobs_run(count, readindices_job, &jobs);
+		RET_UPDATE(result, r);
+	}
+	free(jobs.targets);
+	return result;
+}
+
 static retvalue updates_readindices(/*@null@*/FILE *out, struct update_distribution *d) {
 	retvalue result, r;
 	struct update_target *u;
 
+	if (global.jobs > 1)
+		return updates_readindices_parallel(out, d);
+
 	result = RET_NOTHING;
 	for (u=d->targets ; u != NULL ; u=u->next) {
 		r = searchformissing(out, u);
@@ -2533,7 +2608,7 @@ static void marktargetsneeded(struct cachedlistfile *files, const struct distrib
 	}
 	/* .dsc */
 	if ((a_into != NULL && strlist_in(a_into, "source")) ||
-			(a_into == NULL && atomlist_in(&d->architectures,
+			(a_into == NULL && atomset_in(&d->architectureset,
 						       architecture_source))) {
 		if (c_from != NULL)
 			for (i = 0 ; i < c_from->count ; i++)